@@ -0,0 +1,195 @@
+/*
+    SPI cost of the library operations
+
+    The library runs against the TSS463_Emulator, so no TSS463C is needed. For every operation it prints the number of SPI frames (chip select periods),
+    the SPI bytes, the modelled time on the real SPI bus (TSS463_SPI_CLOCK and the interframe spacing of TSS463_XTAL_FREQUENCY)
+    and the measured time of the call on this board, as CSV and as JSON. Compare the output before and after a change of the library.
+*/
+#include <Arduino.h>
+#include <SPI.h>
+#include <tss463_van.h>
+#include <tss463_emulator.h>
+
+#define ITERATIONS 20
+
+TSS463_Emulator emulator;
+TSS463_VAN van(&emulator, VAN_125KBPS);
+
+uint8_t packet[14] = { 0x8C, 0x00, 0x02, 0xB9, 0x00, 0x82, 0x8D, 0x4E, 0x59, 0x00, 0xFE, 0x01, 0x00, 0x00 };
+uint8_t buffer[32];
+
+typedef VanMessage<0x4FC, VAN_MODE_TRANSMIT, 14, 1> DashboardMessage;
+typedef VanMessage<0x664, VAN_MODE_RECEIVE, 13, 1> StatusMessage;
+const ChannelPlanEntry planEntries[] = {
+    { 0, &DashboardMessage::Descriptor, packet, REARM_AFTER_ACK },
+    { 1, &StatusMessage::Descriptor, NULL, REARM_AFTER_ACK },
+};
+const ChannelPlan plan = { planEntries, 2 };
+
+typedef struct
+{
+    const char* Name;
+    // called before every iteration, not measured
+    void (*Prepare)(uint8_t iteration);
+    void (*Run)(uint8_t iteration);
+}BenchmarkOperation;
+
+typedef struct
+{
+    uint32_t Frames;
+    uint32_t Bytes;
+    uint32_t ModelledUs;
+    uint32_t MeasuredUs;
+}BenchmarkResult;
+
+void ReceiveFrame(uint8_t iteration)
+{
+    VanBusFrame frame;
+    frame.Identifier = 0x664;
+    frame.Command.Value = 0;
+    frame.Command.data.ID = 0x4;
+    frame.Command.data.EXT = 1;
+    frame.Length = 13;
+    for (uint8_t i = 0; i < frame.Length; i++)
+    {
+        frame.Data[i] = iteration + i;
+    }
+    emulator.frame_received(frame);
+}
+
+void Begin(uint8_t iteration) { van.begin(); }
+void SetTransmit(uint8_t iteration) { van.set_channel_for_transmit_message(0, 0x4FC, packet, 14, 1); }
+void SetReceive(uint8_t iteration) { van.set_channel_for_receive_message(1, 0x664, 13, 1); }
+void UpdatePayload(uint8_t iteration) { packet[0] = iteration; van.update_channel_payload(0, packet, 14); }
+void SetValue(uint8_t iteration) { van.set_value_in_channel(0, 1, iteration); }
+void Reactivate(uint8_t iteration) { van.reactivate_channel(0); }
+void MessageAvailable(uint8_t iteration) { van.message_available(1); }
+void PollAllChannels(uint8_t iteration) { van.poll_all_channels(); }
+void ReadMessage(uint8_t iteration) { uint8_t length; van.read_message(1, &length, buffer); van.reactivate_channel(1); }
+void ResetChannels(uint8_t iteration) { van.reset_channels(); }
+void Configure(uint8_t iteration) { van.configure(plan); }
+
+const BenchmarkOperation operations[] = {
+    { "begin", NULL, Begin },
+    { "set_channel_for_transmit_message", NULL, SetTransmit },
+    { "set_channel_for_receive_message", NULL, SetReceive },
+    { "update_channel_payload", NULL, UpdatePayload },
+    { "set_value_in_channel", NULL, SetValue },
+    { "reactivate_channel", NULL, Reactivate },
+    { "message_available", NULL, MessageAvailable },
+    { "poll_all_channels", NULL, PollAllChannels },
+    { "read_message+reactivate_channel", ReceiveFrame, ReadMessage },
+    { "reset_channels", NULL, ResetChannels },
+    { "configure", NULL, Configure },
+};
+const uint8_t OPERATION_COUNT = sizeof(operations) / sizeof(operations[0]);
+BenchmarkResult results[OPERATION_COUNT];
+
+/*
+    Time of the frames on the SPI bus at TSS463_SPI_CLOCK with the interframe spacing of TSS463_XTAL_FREQUENCY (see tss463_spi_time_ns)
+*/
+uint32_t ModelledTimeUs(uint32_t frames, uint32_t bytes)
+{
+    return (uint32_t)((tss463_spi_time_ns(frames, bytes) + 999) / 1000);
+}
+
+void RunBenchmark(uint8_t index)
+{
+    const BenchmarkOperation* operation = &operations[index];
+    uint32_t measured = 0;
+
+    emulator.clear_counters();
+    for (uint8_t i = 0; i < ITERATIONS; i++)
+    {
+        if (operation->Prepare != NULL)
+        {
+            uint32_t frames = emulator.spi_frames();
+            uint32_t bytes = emulator.spi_bytes();
+            operation->Prepare(i);
+            // the preparation must not count
+            if (emulator.spi_frames() != frames || emulator.spi_bytes() != bytes)
+            {
+                Serial.println("Preparation used SPI");
+            }
+        }
+
+        uint32_t start = micros();
+        operation->Run(i);
+        measured += micros() - start;
+    }
+
+    results[index].Frames = emulator.spi_frames();
+    results[index].Bytes = emulator.spi_bytes();
+    results[index].ModelledUs = ModelledTimeUs(results[index].Frames, results[index].Bytes) / ITERATIONS;
+    results[index].MeasuredUs = measured / ITERATIONS;
+}
+
+void PrintCsv()
+{
+    Serial.println("operation,frames_per_call,spi_bytes_per_call,modelled_us,measured_us");
+    for (uint8_t i = 0; i < OPERATION_COUNT; i++)
+    {
+        Serial.print(operations[i].Name);
+        Serial.print(",");
+        Serial.print((float)results[i].Frames / ITERATIONS, 2);
+        Serial.print(",");
+        Serial.print((float)results[i].Bytes / ITERATIONS, 2);
+        Serial.print(",");
+        Serial.print(results[i].ModelledUs);
+        Serial.print(",");
+        Serial.println(results[i].MeasuredUs);
+    }
+}
+
+void PrintJson()
+{
+    Serial.print("{\"spi_clock\":");
+    Serial.print(TSS463_SPI_CLOCK);
+    Serial.print(",\"xtal\":");
+    Serial.print(TSS463_XTAL_FREQUENCY);
+    Serial.print(",\"shadow_registers\":");
+    Serial.print(TSS463_SHADOW_REGISTERS);
+    Serial.print(",\"shadow_mailbox\":");
+    Serial.print(TSS463_SHADOW_MAILBOX);
+    Serial.print(",\"iterations\":");
+    Serial.print(ITERATIONS);
+    Serial.print(",\"operations\":[");
+    for (uint8_t i = 0; i < OPERATION_COUNT; i++)
+    {
+        if (i > 0)
+        {
+            Serial.print(",");
+        }
+        Serial.print("{\"name\":\"");
+        Serial.print(operations[i].Name);
+        Serial.print("\",\"frames_per_call\":");
+        Serial.print((float)results[i].Frames / ITERATIONS, 2);
+        Serial.print(",\"spi_bytes_per_call\":");
+        Serial.print((float)results[i].Bytes / ITERATIONS, 2);
+        Serial.print(",\"modelled_us\":");
+        Serial.print(results[i].ModelledUs);
+        Serial.print(",\"measured_us\":");
+        Serial.print(results[i].MeasuredUs);
+        Serial.print("}");
+    }
+    Serial.println("]}");
+}
+
+void setup()
+{
+    Serial.begin(230400);
+    Serial.println("TSS463 benchmark");
+
+    for (uint8_t i = 0; i < OPERATION_COUNT; i++)
+    {
+        RunBenchmark(i);
+    }
+
+    PrintCsv();
+    Serial.println();
+    PrintJson();
+}
+
+void loop()
+{
+}
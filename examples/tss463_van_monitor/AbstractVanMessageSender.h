@@ -9,7 +9,7 @@
     #include "WProgram.h"
 #endif
 
-#include <tss463_channel_registers_struct.h>
+#include <tss463_van.h>
 
 /// <summary> An abstract class around the library in case if you want to write custom logic </summary>
 class AbstractVanMessageSender {
@@ -69,15 +69,27 @@ class AbstractVanMessageSender {
     /// <returns> True if channel was reactivated otherwise False </returns>
     virtual bool reactivate_channel(uint8_t channelId) = 0;
 
+    /// <summary> Sets what happens with a channel after its message was read </summary>
+    /// <param name="channelId"> Channel identifier (0-14) </param>
+    /// <param name="policy"> REARM_AFTER_ACK (reactivate_channel has to be called), REARM_IMMEDIATE or REARM_ONE_SHOT </param>
+    /// <returns> True if the policy was set otherwise False </returns>
+    virtual bool set_rearm_policy(uint8_t channelId, REARM_POLICY policy) = 0;
+
     /// <summary> Checks if a message is available in a channel </summary>
     /// <param name="channelId"> Channel identifier (0-14) </param>
     virtual MessageLengthAndStatusRegister message_available(uint8_t channelId) = 0;
 
+    /// <summary> Checks all the channels for available messages with a single SPI frame </summary>
+    /// <param name="statuses"> Optional array of 14 elements, the status register of each channel will be written to this variable </param>
+    /// <returns> Bitmap of the channels with a received or transmitted message (bit 0 is channel 0) </returns>
+    virtual uint16_t poll_all_channels(MessageLengthAndStatusRegister statuses[] = NULL) = 0;
+
     /// <summary> Reads a message from a channel </summary>
     /// <param name="channelId"> Channel identifier (0-14) </param>
     /// <param name="length"> Message length will be written to this variable </param>
     /// <param name="buffer"> Message data will be written to this variable </param>
-    virtual void read_message(uint8_t channelId, uint8_t* length, uint8_t buffer[]) = 0;
+    /// <returns> The message status byte with the received command bits (RRAK, RRNW, RRTR) </returns>
+    virtual MessageStatusRegister read_message(uint8_t channelId, uint8_t* length, uint8_t buffer[]) = 0;
 
     /// <summary> Returns the channel which transferred or received a message last time </summary>
     virtual uint8_t get_last_channel() = 0;
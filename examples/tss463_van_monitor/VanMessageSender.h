@@ -84,9 +84,14 @@ class VanMessageSender : public AbstractVanMessageSender {
         return VAN->message_available(channelId);
     }
 
-    void read_message(uint8_t channelId, uint8_t* length, uint8_t buffer[]) override
+    uint16_t poll_all_channels(MessageLengthAndStatusRegister statuses[] = NULL) override
     {
-        VAN->read_message(channelId, length, buffer);
+        return VAN->poll_all_channels(statuses);
+    }
+
+    MessageStatusRegister read_message(uint8_t channelId, uint8_t* length, uint8_t buffer[]) override
+    {
+        return VAN->read_message(channelId, length, buffer);
     }
 
     uint8_t get_last_channel() override
@@ -104,6 +109,11 @@ class VanMessageSender : public AbstractVanMessageSender {
         return VAN->reactivate_channel(channelId);
     }
 
+    bool set_rearm_policy(uint8_t channelId, REARM_POLICY policy) override
+    {
+        return VAN->set_rearm_policy(channelId, policy);
+    }
+
     void reset_channels() override
     {
         VAN->reset_channels();
@@ -1,9 +1,14 @@
 #include <SPI.h>
 #include "VanMessageSender.h"
+#include "tss463_capture.h"
 
 const int VAN_PIN = 7;
 const VAN_NETWORK NETWORK = VAN_COMFORT;
 
+// write binary capture records instead of hex text, convert them with extras/capture/van_capture_decode.cpp
+const bool BINARY_CAPTURE = false;
+TSS463_CaptureWriter capture(Serial);
+
 AbstractVanMessageSender *VANInterface;
 
 uint8_t vanMessageLength;
@@ -17,6 +22,7 @@ char incomingByte;
 void setup()
 {
     Serial.begin(230400);
+    // the decoder skips this line
     Serial.println("Arduino VAN bus monitor using TSS463C");
 
     // initialize SPI
@@ -65,6 +71,8 @@ void van_setup_channel(int channel)
         default:
             break;
     }
+    // the library reactivates the channel right after read_message
+    VANInterface->set_rearm_policy(channel, REARM_IMMEDIATE);
 }
 
 void ShowPopupMessage(int messageId)
@@ -142,18 +150,25 @@ void loop() {
                 break;
         }
     }
+    uint16_t channelsWithMessage = VANInterface->poll_all_channels();
     for (uint8_t channel = 0; channel < 4; channel++)
     {
-        MessageLengthAndStatusRegister messageAvailable = VANInterface->message_available(channel);
-        if (messageAvailable.data.CHRx || messageAvailable.data.CHTx /*|| messageAvailable.data.CHER*/)
+        if (channelsWithMessage & (1 << channel))
         {
-            VANInterface->read_message(channel, &vanMessageLength, vanMessage);
+            MessageStatusRegister status = VANInterface->read_message(channel, &vanMessageLength, vanMessage);
 
             if (vanMessage[0] == 0x00)
             {
                 continue;
             }
 
+            if (BINARY_CAPTURE)
+            {
+                // the identifier bytes come first
+                capture.write(micros(), tss463_identifier(vanMessage), status, channel, &vanMessage[2], vanMessageLength > 2 ? vanMessageLength - 2 : 0);
+                continue;
+            }
+
             Serial.print("Channel: ");
             Serial.print(channel, DEC);
             Serial.print(": ");
@@ -167,8 +182,6 @@ void loop() {
                 Serial.print(tmp);
             }
             Serial.println();
-
-            VANInterface->reactivate_channel(channel);
         }
     }
 }
@@ -0,0 +1,129 @@
+/*
+    Converts a binary capture of TSS463_CaptureWriter to CSV or to a pcap file (host program, no Arduino needed)
+
+    Build and run from this folder:
+      g++ -std=c++11 -O2 -I../../src van_capture_decode.cpp -o van_capture_decode
+      ./van_capture_decode capture.bin [csv or pcap] > output
+
+    The capture can be the raw dump of the serial port (for example: stty -F /dev/ttyUSB0 230400 raw; cat /dev/ttyUSB0 > capture.bin),
+    the text printed before the first record and the damaged records are skipped. The CSV has one line per frame with the time
+    in microseconds given by the writer (micros() of the board). The pcap file uses the link type USER0 (147), every packet is the
+    frame as on the bus without the start of frame and the CRC: ID_TAG, ID_TAG / CMD and the data.
+    The number of records, damaged records and skipped bytes is printed on stderr.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "tss463_capture.h"
+
+#define PCAP_LINKTYPE_USER0 147
+
+typedef struct
+{
+    uint32_t Magic;
+    uint16_t VersionMajor;
+    uint16_t VersionMinor;
+    int32_t ThisZone;
+    uint32_t SigFigs;
+    uint32_t SnapLength;
+    uint32_t LinkType;
+}PcapHeader;
+
+typedef struct
+{
+    uint32_t Seconds;
+    uint32_t Microseconds;
+    uint32_t CapturedLength;
+    uint32_t Length;
+}PcapRecordHeader;
+
+static void write_csv(const VanFrame& frame, uint64_t time)
+{
+    printf("%llu,0x%03X,%u,%u,%u,%u,%u,%u,", (unsigned long long)time, frame.Identifier, frame.Status.data.RRAK, frame.Status.data.RRNW,
+        frame.Status.data.RRTR, frame.Channel, frame.Status.data.RM_L, frame.Length);
+    for (uint8_t i = 0; i < frame.Length; i++)
+    {
+        printf("%02X", frame.Data[i]);
+    }
+    printf("\n");
+}
+
+static void write_pcap(const VanFrame& frame, uint64_t time)
+{
+    uint8_t packet[2 + TSS463_FRAME_DATA_SIZE];
+    packet[0] = (uint8_t)(frame.Identifier >> 4);
+    packet[1] = (uint8_t)((frame.Identifier & 0x0F) << 4) | (1 << 3) | (frame.Status.data.RRAK << 2) | (frame.Status.data.RRNW << 1) | frame.Status.data.RRTR;
+    memcpy(&packet[2], frame.Data, frame.Length);
+
+    PcapRecordHeader header;
+    header.Seconds = (uint32_t)(time / 1000000);
+    header.Microseconds = (uint32_t)(time % 1000000);
+    header.CapturedLength = 2 + frame.Length;
+    header.Length = header.CapturedLength;
+    fwrite(&header, sizeof(header), 1, stdout);
+    fwrite(packet, header.CapturedLength, 1, stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture.bin [csv or pcap] > output\n", argv[0]);
+        return 1;
+    }
+
+    FILE* input = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (input == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    bool isPcap = argc > 2 && strcmp(argv[2], "pcap") == 0;
+
+    if (isPcap)
+    {
+        PcapHeader header = { 0xA1B2C3D4, 2, 4, 0, 0, 2 + TSS463_CAPTURE_MAX_DATA, PCAP_LINKTYPE_USER0 };
+        fwrite(&header, sizeof(header), 1, stdout);
+    }
+    else
+    {
+        printf("time_us,identifier,rak,rnw,rtr,channel,received_length,length,data\n");
+    }
+
+    TSS463_CaptureReader reader;
+    VanFrame frame;
+    uint8_t chunk[512];
+    size_t chunkLength;
+    // the timestamps of the reader wrap around like micros() after 71 minutes
+    uint64_t time = 0;
+    uint32_t lastTimestamp = 0;
+
+    while ((chunkLength = fread(chunk, 1, sizeof(chunk), input)) > 0)
+    {
+        size_t position = 0;
+        while (position < chunkLength)
+        {
+            position += reader.feed(&chunk[position], chunkLength - position);
+            while (reader.next(frame))
+            {
+                time += (uint32_t)(frame.Timestamp - lastTimestamp);
+                lastTimestamp = frame.Timestamp;
+                if (isPcap)
+                {
+                    write_pcap(frame, time);
+                }
+                else
+                {
+                    write_csv(frame, time);
+                }
+            }
+        }
+    }
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    fprintf(stderr, "%lu records, %lu damaged records, %lu skipped bytes\n", (unsigned long)reader.records(), (unsigned long)reader.crc_errors(),
+        (unsigned long)reader.skipped_bytes());
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+    Replays a capture of TSS463_CaptureWriter with the driver and TSS463_Replay on the bus simulator (host program, no Arduino needed)
+
+    Build and run from this folder:
+      g++ -std=c++11 -O2 -I../../src van_replay.cpp ../../src/tss463_van.cpp ../../src/tss463_replay.cpp ../../src/tss463_emulator.cpp ../../src/tss463_bus_simulator.cpp -o van_replay
+      ./van_replay [capture.bin or -] [speed in percent] [poll period in us]
+
+    Without a capture (or with -) the frames of the dashboard example are replayed: 0x4FC, 0x824, 0x8A4 and 0x524 every 50 ms and the
+    reply to the 0x8FC mileage query for 10 seconds.
+    Node 0 runs the driver on an emulated TSS463C and replays the frames on all 14 channels, poll is called every poll period of
+    simulated time. Node 1 is the rest of the car: it acknowledges every frame and requests the replies of the capture every 50 ms.
+    The counters of the replay and the percentiles of the drift from the recorded timeline are printed as CSV.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "tss463_replay.h"
+#include "tss463_capture.h"
+#include "tss463_bus_simulator.h"
+
+#define DEMO_DURATION_US 10000000UL
+#define REQUEST_PERIOD_US 50000UL
+#define MAX_REPLY_IDENTIFIERS 8
+
+static TSS463_BusSimulator* bus;
+
+static uint32_t bus_clock()
+{
+    return (uint32_t)bus->now_us();
+}
+
+static bool add_frame(VanFrame** frames, uint32_t* count, const VanFrame& frame)
+{
+    if (*count % 1024 == 0)
+    {
+        VanFrame* grown = (VanFrame*)realloc(*frames, (*count + 1024) * sizeof(VanFrame));
+        if (grown == NULL)
+        {
+            return false;
+        }
+        *frames = grown;
+    }
+    (*frames)[(*count)++] = frame;
+    return true;
+}
+
+static uint32_t load_capture(const char* path, VanFrame** frames)
+{
+    FILE* input = fopen(path, "rb");
+    if (input == NULL)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 0;
+    }
+
+    TSS463_CaptureReader reader;
+    VanFrame frame;
+    uint8_t chunk[512];
+    size_t chunkLength;
+    uint32_t count = 0;
+    while ((chunkLength = fread(chunk, 1, sizeof(chunk), input)) > 0)
+    {
+        size_t position = 0;
+        while (position < chunkLength)
+        {
+            position += reader.feed(&chunk[position], chunkLength - position);
+            while (reader.next(frame) && add_frame(frames, &count, frame))
+            {
+            }
+        }
+    }
+    fclose(input);
+    return count;
+}
+
+static uint32_t demo_recording(VanFrame** frames)
+{
+    static const uint16_t identifiers[] = { 0x4FC, 0x824, 0x8A4, 0x524 };
+    static const uint8_t lengths[] = { 11, 7, 7, 16 };
+    uint32_t count = 0;
+
+    for (uint32_t time = 0; time < DEMO_DURATION_US; time += 50000)
+    {
+        VanFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            frame.Timestamp = time + i * 1000;
+            frame.Identifier = identifiers[i];
+            frame.Length = lengths[i];
+            frame.Status.data.RRAK = identifiers[i] == 0x4FC;
+            frame.Data[0] = (uint8_t)(time / 50000);
+            add_frame(frames, &count, frame);
+        }
+
+        // the reply of the instrument cluster, armed before the request of the BSI
+        frame.Timestamp = time + 5000;
+        frame.Identifier = 0x8FC;
+        frame.Length = 7;
+        frame.Status.data.RRAK = 0;
+        frame.Status.data.RRNW = 1;
+        add_frame(frames, &count, frame);
+    }
+    return count;
+}
+
+int main(int argc, char* argv[])
+{
+    VanFrame* frames = NULL;
+    uint32_t count = (argc > 1 && strcmp(argv[1], "-") != 0) ? load_capture(argv[1], &frames) : demo_recording(&frames);
+    uint16_t speed = argc > 2 ? atoi(argv[2]) : 100;
+    uint32_t pollPeriodUs = argc > 3 ? atoi(argv[3]) : 200;
+    if (count == 0 || count > 0xFFFF)
+    {
+        fprintf(stderr, "%lu frames, 1 - 65535 frames can be replayed\n", (unsigned long)count);
+        return 1;
+    }
+
+    static TSS463_Emulator replayer;
+    static TSS463_Emulator car;
+    TSS463_BusSimulator simulator(VAN_125KBPS);
+    bus = &simulator;
+
+    TSS463_VAN van(&replayer, VAN_125KBPS);
+    if (van.begin() != BEGIN_OK)
+    {
+        fprintf(stderr, "the emulated TSS463C did not start\n");
+        return 1;
+    }
+    van.set_clock(bus_clock);
+    simulator.add_node(&replayer);
+    simulator.add_node(&car);
+
+    // the rest of the car: one reply request channel per replied identifier, the last channel acknowledges every frame
+    uint16_t replies[MAX_REPLY_IDENTIFIERS];
+    uint8_t replyCount = 0;
+    for (uint32_t i = 0; i < count && replyCount < MAX_REPLY_IDENTIFIERS; i++)
+    {
+        if (!frames[i].Status.data.RRNW || frames[i].Status.data.RRTR)
+        {
+            continue;
+        }
+        uint8_t r = 0;
+        while (r < replyCount && replies[r] != frames[i].Identifier)
+        {
+            r++;
+        }
+        if (r < replyCount)
+        {
+            continue;
+        }
+        // the buffer of the channel receives the reply
+        if (!simulator.setup_transmit(1, replyCount, frames[i].Identifier, NULL, frames[i].Length, true))
+        {
+            fprintf(stderr, "the replies of 0x%03X are not requested, the mailbox is full\n", frames[i].Identifier);
+            break;
+        }
+        replies[replyCount] = frames[i].Identifier;
+        car.poke(CHANNEL_ADDR(replyCount) + 1, car.peek(CHANNEL_ADDR(replyCount) + 1) | 0x03); // RNW = 1, RTR = 1
+        simulator.add_periodic(1, replyCount, REQUEST_PERIOD_US, 5000 + replyCount * 1000);
+        replyCount++;
+    }
+    simulator.setup_receive(1, CHANNELS - 1, 0x000, 0x000, 0, true);
+    simulator.auto_rearm(1, CHANNELS - 1);
+
+    TSS463_Replay replay(&van, bus_clock);
+    TSS463_LatencyHistogramTable<40, 250> drift;
+    replay.begin((1 << CHANNELS) - 1);
+    replay.set_speed(speed);
+    replay.set_drift_histogram(&drift);
+    replay.start(frames, (uint16_t)count);
+
+    uint32_t maxLagUs = 0;
+    uint8_t maxInFlight = 0;
+    while (replay.is_running())
+    {
+        replay.poll();
+        if (replay.lag_us() > maxLagUs)
+        {
+            maxLagUs = replay.lag_us();
+        }
+        if (replay.in_flight() > maxInFlight)
+        {
+            maxInFlight = replay.in_flight();
+        }
+        simulator.run(pollPeriodUs);
+    }
+
+    const ReplayStats* stats = replay.stats();
+    printf("frames,sent,errors,expired,superseded,skipped,max_in_flight,max_lag_us,duration_ms,bus_load_percent,spi_frames\n");
+    printf("%lu,%lu,%lu,%lu,%lu,%lu,%u,%lu,%lu,%.1f,%lu\n", (unsigned long)count, (unsigned long)stats->Sent, (unsigned long)stats->Errors,
+        (unsigned long)stats->Expired, (unsigned long)stats->Superseded, (unsigned long)stats->Skipped, maxInFlight, (unsigned long)maxLagUs, (unsigned long)(simulator.now_us() / 1000),
+        simulator.bus_load(), (unsigned long)van.spi_stats().FramesWritten + van.spi_stats().FramesRead);
+    printf("\ndrift_p50_us,drift_p90_us,drift_p99_us,drift_max_us\n");
+    printf("%lu,%lu,%lu,%lu\n", (unsigned long)drift.percentile_us(50), (unsigned long)drift.percentile_us(90), (unsigned long)drift.percentile_us(99),
+        (unsigned long)drift.max_us());
+
+    free(frames);
+    return 0;
+}
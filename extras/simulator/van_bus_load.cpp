@@ -0,0 +1,139 @@
+/*
+    VAN comfort bus load estimation with the bus simulator of the library (host program, no Arduino needed)
+
+    Build and run from this folder:
+      g++ -std=c++11 -O2 -I../../src -DTSS463_SIM_MAX_SOURCES=96 van_bus_load.cpp ../../src/tss463_emulator.cpp ../../src/tss463_bus_simulator.cpp -o van_bus_load
+      ./van_bus_load [speed: 62 or 125] [period of the extra frames in ms] [length of the extra frames]
+
+    The frames of the dashboard example (0x4FC, 0x824, 0x8A4, 0x524 every 50 ms and the 0x8FC mileage query answered in-frame by the
+    instrument cluster) are always on the bus. Extra periodic frames are added one by one until frames are lost, each step is simulated
+    for 10 seconds and printed as a CSV line.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "tss463_bus_simulator.h"
+
+#define SIMULATED_TIME_US 10000000UL
+#define EXTRA_NODES 6
+#define MAX_EXTRA_FRAMES (EXTRA_NODES * CHANNELS)
+
+typedef struct
+{
+    uint16_t Identifier;
+    uint8_t Length;
+    bool Ack;
+}DashboardFrame;
+
+static const DashboardFrame dashboardFrames[] = {
+    { 0x4FC, 11, true },
+    { 0x824, 7, false },
+    { 0x8A4, 7, false },
+    { 0x524, 16, false },
+};
+
+typedef struct
+{
+    float BusLoad;
+    uint32_t Lost;
+    uint32_t WorstP99;
+    uint32_t WorstMax;
+    uint16_t WorstIdentifier;
+}StepResult;
+
+static StepResult simulate(VAN_SPEED speed, uint8_t extraFrames, uint32_t extraPeriodUs, uint8_t extraLength, bool printSources)
+{
+    static TSS463_Emulator emulators[2 + EXTRA_NODES];
+    TSS463_BusSimulator bus(speed);
+
+    for (uint8_t i = 0; i < 2 + EXTRA_NODES; i++)
+    {
+        emulators[i].reset();
+        bus.add_node(&emulators[i]);
+    }
+
+    // node 0: BSI, node 1: instrument cluster
+    uint8_t channel = 0;
+    for (uint8_t i = 0; i < sizeof(dashboardFrames) / sizeof(dashboardFrames[0]); i++, channel++)
+    {
+        bus.setup_transmit(0, channel, dashboardFrames[i].Identifier, NULL, dashboardFrames[i].Length, dashboardFrames[i].Ack);
+        bus.add_periodic(0, channel, 50000, i * 1000);
+    }
+
+    // mileage query: reply request of the BSI, immediate reply of the instrument cluster
+    uint8_t base = CHANNEL_ADDR(channel);
+    bus.setup_transmit(0, channel, 0x8FC, NULL, 7, true);
+    emulators[0].poke(base + 1, emulators[0].peek(base + 1) | 0x03); // RNW = 1, RTR = 1
+    bus.add_periodic(0, channel, 50000, 5000);
+
+    bus.setup_transmit(1, 0, 0x8FC, NULL, 7, false);
+    emulators[1].poke(CHANNEL_ADDR(0) + 1, emulators[1].peek(CHANNEL_ADDR(0) + 1) | 0x02); // RNW = 1, RTR = 0
+    emulators[1].poke(CHANNEL_ADDR(0) + 3, emulators[1].peek(CHANNEL_ADDR(0) + 3) & ~0x02); // CHTx = 0
+    bus.auto_rearm(1, 0);
+    bus.setup_receive(1, 1, 0x4FC, 0x0FFF, 11, true);
+    bus.auto_rearm(1, 1);
+
+    for (uint8_t i = 0; i < extraFrames; i++)
+    {
+        uint8_t node = 2 + i % EXTRA_NODES;
+        uint8_t nodeChannel = i / EXTRA_NODES;
+        bus.setup_transmit(node, nodeChannel, 0x100 + i * 0x08, NULL, extraLength, false);
+        bus.add_periodic(node, nodeChannel, extraPeriodUs, (i * 1373UL) % extraPeriodUs);
+    }
+
+    bus.run(SIMULATED_TIME_US);
+
+    StepResult result = { bus.bus_load(), 0, 0, 0, 0 };
+    for (uint8_t i = 0; i < bus.source_count(); i++)
+    {
+        const VanSourceStats* stats = bus.source_stats(i);
+        uint32_t p99 = bus.latency_percentile_us(i, 99);
+        result.Lost += stats->Lost;
+        if (p99 > result.WorstP99)
+        {
+            result.WorstP99 = p99;
+            result.WorstIdentifier = stats->Identifier;
+        }
+        if (bus.latency_max_us(i) > result.WorstMax)
+        {
+            result.WorstMax = bus.latency_max_us(i);
+        }
+
+        if (printSources)
+        {
+            printf("0x%03X,%lu,%lu,%lu,%lu,%lu,%lu\n", stats->Identifier, (unsigned long)stats->Released, (unsigned long)stats->Sent, (unsigned long)stats->Lost,
+                (unsigned long)bus.latency_percentile_us(i, 50), (unsigned long)p99, (unsigned long)bus.latency_max_us(i));
+        }
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    VAN_SPEED speed = (argc > 1 && atoi(argv[1]) == 62) ? VAN_62K5BPS : VAN_125KBPS;
+    uint32_t extraPeriodUs = (argc > 2 ? atoi(argv[2]) : 100) * 1000UL;
+    uint8_t extraLength = argc > 3 ? atoi(argv[3]) : 8;
+
+    printf("extra_frames,bus_load_percent,lost,worst_p99_us,worst_max_us,worst_identifier\n");
+
+    uint8_t extraFrames;
+    for (extraFrames = 0; extraFrames <= MAX_EXTRA_FRAMES; extraFrames++)
+    {
+        StepResult result = simulate(speed, extraFrames, extraPeriodUs, extraLength, false);
+        printf("%u,%.1f,%lu,%lu,%lu,0x%03X\n", extraFrames, result.BusLoad, (unsigned long)result.Lost, (unsigned long)result.WorstP99,
+            (unsigned long)result.WorstMax, result.WorstIdentifier);
+        if (result.Lost > 0)
+        {
+            break;
+        }
+    }
+
+    if (extraFrames > MAX_EXTRA_FRAMES)
+    {
+        extraFrames = MAX_EXTRA_FRAMES;
+    }
+
+    printf("\nidentifier,released,sent,lost,p50_us,p99_us,max_us\n");
+    simulate(speed, extraFrames, extraPeriodUs, extraLength, true);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+    begin with a TSS463C which does not answer or whose line does not become active: the deadlines of TSS463_BEGIN_TIMEOUT_US and
+    TSS463_ACTIVATION_TIMEOUT_US are kept on a fake clock which moves 1 us per SPI byte
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_begin.cpp ../../src/tss463_*.cpp -o test_begin && ./test_begin
+*/
+#include "tss463_test.h"
+
+// microseconds of the fake clock per SPI byte
+#define BYTE_US 1
+
+/*
+    TSS463_SpiProbe which does not answer the address and control bytes (0xAA, 0x55) until SilentUntil,
+    and reports the idle mode in the Line Status Register until InactiveUntil
+*/
+class TSS463_FaultyChip : public TSS463_SpiProbe
+{
+private:
+    uint8_t _index = 0;
+    uint8_t _address = 0;
+    uint32_t _selectTime = 0;
+
+public:
+    uint32_t SilentUntil = 0;
+    uint32_t InactiveUntil = 0;
+    // start of the first frame reading the Line Status Register since clear_faults
+    uint32_t FirstLineRead = 0;
+    bool LineRead = false;
+
+    void select()
+    {
+        _index = 0;
+        _selectTime = now;
+        TSS463_SpiProbe::select();
+    }
+
+    uint8_t transfer(uint8_t data)
+    {
+        now += BYTE_US;
+        uint8_t value = TSS463_SpiProbe::transfer(data);
+        if (_index == 0)
+        {
+            _address = data;
+        }
+        bool silent = (int32_t)(now - SilentUntil) < 0;
+        if (silent && _index < 2)
+        {
+            value = 0xFF;
+        }
+        if (_index == 2 && _address == LINESTATUS && !silent)
+        {
+            if (!LineRead)
+            {
+                LineRead = true;
+                FirstLineRead = _selectTime;
+            }
+            if ((int32_t)(now - InactiveUntil) < 0)
+            {
+                LineStatusRegister status;
+                status.Value = value;
+                status.data.IDG = 1;
+                value = status.Value;
+            }
+        }
+        _index++;
+        return value;
+    }
+
+    void clear_faults()
+    {
+        SilentUntil = now;
+        InactiveUntil = now;
+        LineRead = false;
+        clear();
+    }
+};
+
+static TSS463_FaultyChip chip;
+static TSS463_VAN van(&chip, VAN_125KBPS);
+
+static void test_no_answer()
+{
+    chip.clear_faults();
+    chip.SilentUntil = now + 2 * TSS463_BEGIN_TIMEOUT_US;
+    uint32_t start = now;
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_NO_ANSWER);
+
+    // given up at the first failed initialization sequence past the deadline (2 bytes)
+    uint32_t elapsed = now - start;
+    TSS463_CHECK(elapsed >= TSS463_BEGIN_TIMEOUT_US);
+    TSS463_CHECK(elapsed <= TSS463_BEGIN_TIMEOUT_US + 2 * BYTE_US);
+    // nothing but initialization sequences, the line was not activated
+    TSS463_CHECK_EQUAL(chip.Bytes, 2 * chip.Transactions);
+    TSS463_CHECK(!chip.LineRead);
+    TSS463_CHECK_EQUAL(chip.Faults, 0);
+}
+
+static void test_late_answer()
+{
+    // the TSS463C answers before the deadline: begin does not wait for it
+    chip.clear_faults();
+    chip.SilentUntil = now + TSS463_BEGIN_TIMEOUT_US / 2;
+    uint32_t start = now;
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK((uint32_t)(now - start) < TSS463_BEGIN_TIMEOUT_US);
+    TSS463_CHECK(chip.is_active());
+}
+
+static void test_line_inactive()
+{
+    chip.clear_faults();
+    chip.InactiveUntil = now + 2 * TSS463_BEGIN_TIMEOUT_US;
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_LINE_INACTIVE);
+
+    // given up at the first read of the Line Status Register past the deadline (3 bytes)
+    TSS463_CHECK(chip.LineRead);
+    uint32_t elapsed = now - chip.FirstLineRead;
+    TSS463_CHECK(elapsed >= TSS463_ACTIVATION_TIMEOUT_US);
+    TSS463_CHECK(elapsed <= TSS463_ACTIVATION_TIMEOUT_US + 3 * BYTE_US);
+    TSS463_CHECK_EQUAL(van.spi_stats().HandshakeErrors, 0);
+
+    // the line becomes active within the deadline
+    chip.clear_faults();
+    chip.InactiveUntil = now + TSS463_ACTIVATION_TIMEOUT_US / 2;
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK((uint32_t)(now - chip.FirstLineRead) < TSS463_ACTIVATION_TIMEOUT_US);
+}
+
+int main()
+{
+    van.set_clock(fake_clock);
+    test_no_answer();
+    test_late_answer();
+    test_line_inactive();
+    return tss463_test_result("test_begin");
+}
@@ -0,0 +1,174 @@
+/*
+    Capture records: what tss463_capture_encode writes TSS463_CaptureReader gives back, fed at once or byte by byte. A damaged
+    record is rejected by the CRC, the reader finds the next record after junk or text, and waits for the rest of a cut record
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_capture.cpp ../../src/tss463_*.cpp -o test_capture && ./test_capture
+*/
+#include "tss463_test.h"
+#include "tss463_capture.h"
+
+#define RECORDS 5
+
+static const uint32_t DELTAS[RECORDS] = { 0, 127, 128, 300000, 0xFFFFFFFF };
+static const uint16_t IDENTIFIERS[RECORDS] = { 0x8A4, 0x4D4, 0x000, 0xFFF, 0x564 };
+static const uint8_t LENGTHS[RECORDS] = { 7, 0, 1, 30, 16 };
+
+static uint8_t stream[RECORDS * TSS463_CAPTURE_MAX_RECORD];
+static uint16_t recordStart[RECORDS + 1];
+
+static void encode_records()
+{
+    uint16_t position = 0;
+    for (uint8_t r = 0; r < RECORDS; r++)
+    {
+        uint8_t data[TSS463_CAPTURE_MAX_DATA];
+        for (uint8_t i = 0; i < LENGTHS[r]; i++)
+        {
+            data[i] = r * 0x20 + i;
+        }
+        MessageStatusRegister status;
+        status.Value = 0x80 | r;
+        recordStart[r] = position;
+        position += tss463_capture_encode(&stream[position], DELTAS[r], IDENTIFIERS[r], status, r, data, LENGTHS[r]);
+        // the CRC over the record and its CRC leaves no residue
+        TSS463_CHECK_EQUAL(tss463_crc16(0xFFFF, &stream[recordStart[r] + 1], position - recordStart[r] - 1), 0);
+    }
+    recordStart[RECORDS] = position;
+}
+
+static void check_record(const VanFrame& frame, uint8_t r, uint32_t time)
+{
+    TSS463_CHECK_EQUAL(frame.Timestamp, time);
+    TSS463_CHECK_EQUAL(frame.Identifier, IDENTIFIERS[r]);
+    TSS463_CHECK_EQUAL(frame.Status.Value, 0x80 | r);
+    TSS463_CHECK_EQUAL(frame.Channel, r);
+    TSS463_CHECK_EQUAL(frame.Length, LENGTHS[r]);
+    for (uint8_t i = 0; i < frame.Length; i++)
+    {
+        TSS463_CHECK_EQUAL(frame.Data[i], r * 0x20 + i);
+    }
+}
+
+// feeds the bytes in pieces of the given size and takes the records as they come, returns how many were taken
+static uint8_t read_stream(TSS463_CaptureReader& reader, const uint8_t data[], size_t length, size_t piece, VanFrame frames[], uint8_t maxFrames)
+{
+    uint8_t count = 0;
+    size_t position = 0;
+    while (position < length)
+    {
+        size_t size = length - position < piece ? length - position : piece;
+        position += reader.feed(&data[position], size);
+        while (count < maxFrames && reader.next(frames[count]))
+        {
+            count++;
+        }
+    }
+    while (count < maxFrames && reader.next(frames[count]))
+    {
+        count++;
+    }
+    return count;
+}
+
+static void test_round_trip()
+{
+    static const size_t PIECES[3] = { sizeof(stream), 1, 5 };
+    for (uint8_t p = 0; p < 3; p++)
+    {
+        TSS463_CaptureReader reader;
+        VanFrame frames[RECORDS + 1];
+        TSS463_CHECK_EQUAL(read_stream(reader, stream, recordStart[RECORDS], PIECES[p], frames, RECORDS + 1), RECORDS);
+
+        uint32_t time = 0;
+        for (uint8_t r = 0; r < RECORDS; r++)
+        {
+            time += DELTAS[r];
+            check_record(frames[r], r, time);
+        }
+        TSS463_CHECK_EQUAL(reader.records(), RECORDS);
+        TSS463_CHECK_EQUAL(reader.crc_errors(), 0);
+        TSS463_CHECK_EQUAL(reader.skipped_bytes(), 0);
+    }
+}
+
+// a flipped bit in the data of the first record: it is skipped, the second record is read
+static void test_crc_rejected()
+{
+    uint8_t damaged[sizeof(stream)];
+    memcpy(damaged, stream, recordStart[2]);
+    damaged[recordStart[1] - 4] ^= 0x10;
+
+    TSS463_CaptureReader reader;
+    VanFrame frames[2];
+    TSS463_CHECK_EQUAL(read_stream(reader, damaged, recordStart[2], 1, frames, 2), 1);
+    // the delta of the lost record is lost with it
+    check_record(frames[0], 1, DELTAS[1]);
+    TSS463_CHECK(reader.crc_errors() >= 1);
+    TSS463_CHECK_EQUAL(reader.records(), 1);
+}
+
+// text printed between the records and junk which looks like the start of a record (a sync byte and a valid size), the records
+// which follow the junk end the wait for the size it announced
+static void test_resync()
+{
+    static const char TEXT[] = "VAN monitor started\r\n";
+    static const uint8_t JUNK[] = { 0x00, TSS463_CAPTURE_SYNC, 12, 0x55, TSS463_CAPTURE_SYNC, 0xFF, 0x12 };
+    uint8_t mixed[sizeof(TEXT) + sizeof(JUNK) + sizeof(stream)];
+    size_t length = 0;
+    memcpy(&mixed[length], TEXT, sizeof(TEXT) - 1);
+    length += sizeof(TEXT) - 1;
+    memcpy(&mixed[length], &stream[recordStart[0]], recordStart[1] - recordStart[0]);
+    length += recordStart[1] - recordStart[0];
+    memcpy(&mixed[length], JUNK, sizeof(JUNK));
+    length += sizeof(JUNK);
+    memcpy(&mixed[length], &stream[recordStart[1]], recordStart[RECORDS] - recordStart[1]);
+    length += recordStart[RECORDS] - recordStart[1];
+
+    TSS463_CaptureReader reader;
+    VanFrame frames[RECORDS + 1];
+    TSS463_CHECK_EQUAL(read_stream(reader, mixed, length, 3, frames, RECORDS + 1), RECORDS);
+    uint32_t time = 0;
+    for (uint8_t r = 0; r < RECORDS; r++)
+    {
+        time += DELTAS[r];
+        check_record(frames[r], r, time);
+    }
+    TSS463_CHECK_EQUAL(reader.skipped_bytes(), sizeof(TEXT) - 1 + sizeof(JUNK));
+}
+
+static void test_truncated()
+{
+    TSS463_CaptureReader reader;
+    VanFrame frame;
+
+    // a record cut in two: nothing until the rest comes
+    uint16_t half = recordStart[3] + (recordStart[4] - recordStart[3]) / 2;
+    reader.feed(&stream[recordStart[3]], half - recordStart[3]);
+    TSS463_CHECK(!reader.next(frame));
+    reader.feed(&stream[half], recordStart[4] - half);
+    TSS463_CHECK(reader.next(frame));
+    check_record(frame, 3, DELTAS[3]);
+
+    // the end of a record is lost: the next whole record is found after it
+    reader.clear();
+    uint8_t cut[sizeof(stream)];
+    size_t length = half - recordStart[3];
+    memcpy(cut, &stream[recordStart[3]], length);
+    memcpy(&cut[length], &stream[recordStart[4]], recordStart[5] - recordStart[4]);
+    length += recordStart[5] - recordStart[4];
+    VanFrame frames[2];
+    TSS463_CHECK_EQUAL(read_stream(reader, cut, length, 1, frames, 2), 1);
+    check_record(frames[0], 4, DELTAS[4]);
+    TSS463_CHECK_EQUAL(reader.records(), 1);
+}
+
+int main()
+{
+    encode_records();
+    test_round_trip();
+    test_crc_rejected();
+    test_resync();
+    test_truncated();
+    return tss463_test_result("test_capture");
+}
@@ -0,0 +1,168 @@
+/*
+    Channel plans: configure writes a valid plan as one SPI frame over 0x10 - 0xFF, an invalid plan is rejected without writing a byte
+    and begin(plan) falls back to no channels with BEGIN_INVALID_PLAN
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_configure.cpp ../../src/tss463_*.cpp -o test_configure && ./test_configure
+*/
+#include "tss463_test.h"
+
+#define IT_PIN 2
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static const uint8_t DATA[7] = { 0x0F, 0x07, 0x00, 0x00, 0x00, 0x00, 0x60 };
+
+typedef VanMessage<0x8A4, VAN_MODE_TRANSMIT, 7> Transmit;
+typedef VanMessage<0x4D4, VAN_MODE_RECEIVE, 10, 1> Receive;
+typedef VanMessage<0x000, VAN_MODE_REPLY_REQUEST_DETECTION, TSS463_MAX_DATA_LENGTH> Spy;
+typedef VanMessage<0x824, VAN_MODE_RECEIVE, 7, 1, 0xFFF> ReceiveFirst;
+typedef VanMessage<0x8A4, VAN_MODE_RECEIVE, 7, 1, 0xFFF> ReceiveSecond;
+typedef VanMessage<0x564, VAN_MODE_RECEIVE, TSS463_MAX_DATA_LENGTH> Long;
+
+static const ChannelPlanEntry VALID[] = {
+    { 0, &Transmit::Descriptor, DATA, REARM_AFTER_ACK },
+    { 2, &Receive::Descriptor, NULL, REARM_IMMEDIATE },
+    { 5, &Spy::Descriptor, NULL, REARM_AFTER_ACK },
+};
+static const ChannelPlan VALID_PLAN = { VALID, 3 };
+
+static const ChannelPlanEntry DUPLICATE[] = {
+    { 0, &Transmit::Descriptor, DATA, REARM_AFTER_ACK },
+    { 2, &Receive::Descriptor, NULL, REARM_AFTER_ACK },
+    { 2, &Spy::Descriptor, NULL, REARM_AFTER_ACK },
+};
+// 5 buffers of 31 bytes do not fit in the 128 bytes of the Message DATA RAM
+static const ChannelPlanEntry OVERFLOW[] = {
+    { 0, &Long::Descriptor, NULL, REARM_AFTER_ACK },
+    { 1, &Long::Descriptor, NULL, REARM_AFTER_ACK },
+    { 2, &Long::Descriptor, NULL, REARM_AFTER_ACK },
+    { 3, &Long::Descriptor, NULL, REARM_AFTER_ACK },
+    { 4, &Long::Descriptor, NULL, REARM_AFTER_ACK },
+};
+static const ChannelPlanEntry NO_DATA[] = {
+    { 2, &Receive::Descriptor, NULL, REARM_AFTER_ACK },
+    { 0, &Transmit::Descriptor, NULL, REARM_AFTER_ACK },
+};
+static const ChannelPlanEntry NO_CHANNEL[] = {
+    { CHANNELS, &Receive::Descriptor, NULL, REARM_AFTER_ACK },
+};
+
+static uint8_t message_pointer(uint8_t channelId)
+{
+    return probe.peek(CHANNEL_ADDR(channelId) + 2) & 0x7F;
+}
+
+static void check_valid_plan()
+{
+    TSS463_CHECK(van.is_channel_occupied(0));
+    TSS463_CHECK(!van.is_channel_occupied(1));
+    TSS463_CHECK(van.is_channel_occupied(2));
+    TSS463_CHECK(van.is_channel_occupied(5));
+
+    // the buffers one after the other in the order of the plan
+    TSS463_CHECK_EQUAL(message_pointer(0), 0);
+    TSS463_CHECK_EQUAL(message_pointer(2), 8);
+    TSS463_CHECK_EQUAL(message_pointer(5), 8 + 11);
+    for (uint8_t i = 0; i < sizeof(DATA); i++)
+    {
+        TSS463_CHECK_EQUAL(probe.peek(GETMAIL(1 + i)), DATA[i]);
+    }
+    // a channel out of the plan is disabled
+    TSS463_CHECK_EQUAL(probe.peek(CHANNEL_ADDR(1) + 3), 0x0F);
+}
+
+static void test_valid_plan()
+{
+    probe.clear();
+    TSS463_CHECK(van.configure(VALID_PLAN));
+
+    TSS463_CHECK_EQUAL(probe.LogCount, 1);
+    TSS463_CHECK_EQUAL(probe.Log[0].Address, CHANNEL_ADDR(0));
+    TSS463_CHECK_EQUAL(probe.Log[0].Control, WRITE);
+    TSS463_CHECK_EQUAL(probe.Log[0].Bytes, 2 + 0x100 - CHANNEL_ADDR(0));
+    check_valid_plan();
+
+    // the receiving channel takes the frames of its identifier
+    TSS463_CHECK(probe.receive(0x4D4, 0x30, 10));
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+}
+
+static void check_rejected(const ChannelPlanEntry entries[], uint8_t count)
+{
+    ChannelPlan plan = { entries, count };
+    TSS463_CHECK(van.configure(VALID_PLAN));
+
+    probe.clear();
+    TSS463_CHECK(!van.configure(plan));
+    TSS463_CHECK_EQUAL(probe.Transactions, 0);
+    TSS463_CHECK_EQUAL(probe.Bytes, 0);
+    // the channels of the last valid plan are kept
+    check_valid_plan();
+}
+
+static void test_rejected_plans()
+{
+    check_rejected(DUPLICATE, 3);
+    check_rejected(OVERFLOW, 5);
+    check_rejected(NO_DATA, 2);
+    check_rejected(NO_CHANNEL, 1);
+}
+
+static void test_begin_plan()
+{
+    ChannelPlan invalid = { DUPLICATE, 3 };
+    TSS463_CHECK_EQUAL(van.begin(invalid), BEGIN_INVALID_PLAN);
+    // every channel is disabled, the line is active
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        TSS463_CHECK(!van.is_channel_occupied(channelId));
+        TSS463_CHECK_EQUAL(probe.peek(CHANNEL_ADDR(channelId) + 3), 0x0F);
+    }
+    TSS463_CHECK(!probe.receive(0x4D4, 0x30, 10));
+
+    TSS463_CHECK_EQUAL(van.begin(VALID_PLAN), BEGIN_OK);
+    check_valid_plan();
+    TSS463_CHECK(probe.receive(0x4D4, 0x30, 10));
+}
+
+static void test_pending_channels_cleared()
+{
+    static const ChannelPlanEntry entries[] = {
+        { 0, &ReceiveFirst::Descriptor, NULL, REARM_IMMEDIATE },
+        { 1, &ReceiveSecond::Descriptor, NULL, REARM_IMMEDIATE },
+    };
+    ChannelPlan plan = { entries, 2 };
+    uint8_t buffer[32];
+    uint8_t length;
+
+    // the interrupt flags of the earlier tests are reset
+    TSS463_CHECK_EQUAL(van.begin(plan), BEGIN_OK);
+    van.attach_interrupt(IT_PIN);
+    van.set_clock(fake_clock);
+    probe.Van = &van;
+
+    // both channels receive before the interrupt is serviced, one is read (a frame of 7 bytes takes 134 timeslots of 8 us)
+    TSS463_CHECK(probe.receive(0x824, 0x10, 7));
+    now += 134 * 8;
+    TSS463_CHECK(probe.receive(0x8A4, 0x20, 7));
+    now += 134 * 8;
+    TSS463_CHECK(van.service_interrupt(&length, buffer) != TSS463_NO_CHANNEL);
+    TSS463_CHECK(van.interrupt_pending());
+
+    // the other one is set up again by the plan, its message is gone
+    TSS463_CHECK(van.configure(plan));
+    TSS463_CHECK(!van.interrupt_pending());
+    TSS463_CHECK_EQUAL(van.service_interrupt(&length, buffer), TSS463_NO_CHANNEL);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    test_valid_plan();
+    test_rejected_plans();
+    test_begin_plan();
+    test_pending_channels_cleared();
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    return tss463_test_result("test_configure");
+}
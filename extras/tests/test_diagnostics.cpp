@@ -0,0 +1,119 @@
+/*
+    Bus diagnostics: the messages are counted from the interrupt flags, so the same message repeated on one channel is counted
+    each time, and a sample taken between a reception and its service does not hide it from the interrupt path
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_diagnostics.cpp ../../src/tss463_*.cpp -o test_diagnostics && ./test_diagnostics
+*/
+#include "tss463_test.h"
+#include "tss463_diagnostics.h"
+
+#define IT_PIN 2
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static TSS463_Diagnostics diagnostics(&van, fake_clock);
+static TSS463_FrameRingBuffer<4> ring;
+
+// the bus transmits the ready channel, the first attempts fail
+static void transmit(uint8_t failedAttempts)
+{
+    VanBusFrame frame;
+    while (probe.next_frame(&frame))
+    {
+        probe.frame_sent(failedAttempts > 0 ? 1 << 4 : 0, NULL);
+        if (failedAttempts > 0)
+        {
+            failedAttempts--;
+        }
+    }
+}
+
+static void test_repeated_message()
+{
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    VanFrame frame = {};
+    // two retries (MR[3:0] of the Transmission Control Register)
+    probe.poke(TRANSMITCONTROL, (2 << 4) | (probe.peek(TRANSMITCONTROL) & 0x0F));
+    diagnostics.sample();
+    diagnostics.clear();
+
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        // a transmission and a reception
+        TSS463_CHECK(van.set_channel_for_transmit_message(0, 0x8C4, data, sizeof(data), 1));
+        // sent after two retries, then the retry count exceeded (TE)
+        transmit(i == 8 ? 2 : i == 9 ? 3 : 0);
+        diagnostics.sample();
+
+        TSS463_CHECK(probe.receive(0x8A4, i));
+        diagnostics.sample();
+        TSS463_CHECK_EQUAL(van.receive(), 1);
+        TSS463_CHECK(ring.pop(frame));
+        now += 1000;
+    }
+
+    const BusDiagnosticsCounters* counters = diagnostics.counters();
+    TSS463_CHECK_EQUAL(counters->Samples, 20);
+    TSS463_CHECK_EQUAL(counters->Transmissions, 10);
+    TSS463_CHECK_EQUAL(counters->Receptions, 10);
+    TSS463_CHECK_EQUAL(counters->Retries, 2 + 2);
+    TSS463_CHECK_EQUAL(counters->Errors, 1);
+
+    // nothing happened since: nothing more is counted, and the registers 0x04 - 0x09 are read in one frame without a reset
+    probe.clear();
+    diagnostics.sample();
+    TSS463_CHECK_EQUAL(counters->Transmissions, 10);
+    TSS463_CHECK_EQUAL(counters->Receptions, 10);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 1);
+    TSS463_CHECK_EQUAL(probe.Log[0].Address, LINESTATUS);
+    TSS463_CHECK_EQUAL(probe.Log[0].Bytes, 2 + 6);
+
+    // the same message again and again on one channel: the Last Message Status Register does not change
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        TSS463_CHECK(probe.receive(0x8A4, i));
+        probe.clear();
+        diagnostics.sample();
+        // the reception flags are reset by a second frame
+        TSS463_CHECK_EQUAL(probe.spi_frames(), 2);
+        TSS463_CHECK_EQUAL(van.receive(), 1);
+        TSS463_CHECK(ring.pop(frame));
+    }
+    TSS463_CHECK_EQUAL(counters->Receptions, 20);
+}
+
+static void test_sample_before_service()
+{
+    VanFrame frame = {};
+    van.attach_interrupt(IT_PIN);
+
+    // the sample resets the flags (and releases the INT pin) before the interrupt is serviced
+    TSS463_CHECK(probe.receive(0x8A4, 0x40));
+    diagnostics.sample();
+    TSS463_CHECK(!probe.interrupt_line());
+    TSS463_CHECK(van.interrupt_pending());
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x40);
+
+    // the interrupt service resets the flags before the sample: the reception is counted all the same
+    uint32_t receptions = diagnostics.counters()->Receptions;
+    TSS463_CHECK(probe.receive(0x8A4, 0x50));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    diagnostics.sample();
+    TSS463_CHECK_EQUAL(diagnostics.counters()->Receptions, receptions + 1);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x8A4, 4, 1, 0xFFF));
+    van.set_rearm_policy(1, REARM_IMMEDIATE);
+    van.set_frame_ring(&ring);
+    probe.Van = &van;
+
+    test_repeated_message();
+    test_sample_before_service();
+    return tss463_test_result("test_diagnostics");
+}
@@ -0,0 +1,184 @@
+/*
+    Frame ring: a producer thread and a consumer thread exchange frames without loss, duplicate or reordering,
+    and receive leaves the message in its channel when the ring is full
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_frame_ring.cpp ../../src/tss463_*.cpp -o test_frame_ring && ./test_frame_ring
+*/
+#include <thread>
+#include "tss463_test.h"
+
+#define RING_FRAMES 200000
+#define VAN_FRAMES 5000
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+
+// a frame carries the low byte of its sequence number and the next ones (TSS463_SpiProbe::receive), the rings hold far fewer than 256 frames
+static bool is_frame(const VanFrame& frame, uint8_t sequence)
+{
+    if (frame.Length != 4)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < frame.Length; i++)
+    {
+        if (frame.Data[i] != (uint8_t)(sequence + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the consumer pops until it got the given number of frames, they must come in order
+static void consume(TSS463_FrameRing* ring, uint32_t frames, uint32_t* errors)
+{
+    VanFrame frame;
+    uint32_t expected = 0;
+    while (expected < frames)
+    {
+        if (!ring->pop(frame))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (!is_frame(frame, expected))
+        {
+            (*errors)++;
+        }
+        expected++;
+    }
+}
+
+static void test_threads_ring_only()
+{
+    static TSS463_FrameRingBuffer<16> ring;
+    uint32_t errors = 0;
+
+    std::thread consumer(consume, &ring, RING_FRAMES, &errors);
+    std::thread producer([]()
+    {
+        VanFrame frame;
+        frame.Length = 4;
+        for (uint32_t i = 0; i < RING_FRAMES; i++)
+        {
+            for (uint8_t b = 0; b < 4; b++)
+            {
+                frame.Data[b] = i + b;
+            }
+            while (!ring.push(frame))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    TSS463_CHECK_EQUAL(errors, 0);
+    TSS463_CHECK_EQUAL(ring.count(), 0);
+    TSS463_CHECK_EQUAL(ring.blocked(), 0);
+    printf("push/pop: %u frames, %u pushes into the full ring\n", RING_FRAMES, ring.overflows());
+}
+
+// receive is the producer: the emulator and the library are only used by the producer thread
+static void test_threads_receive()
+{
+    static TSS463_FrameRingBuffer<8> ring;
+    uint32_t errors = 0;
+    uint32_t lost = 0;
+
+    van.set_frame_ring(&ring);
+    std::thread consumer(consume, &ring, VAN_FRAMES, &errors);
+    std::thread producer([&lost]()
+    {
+        for (uint32_t i = 0; i < VAN_FRAMES; i++)
+        {
+            if (!probe.receive(0x8A4, i))
+            {
+                lost++;
+            }
+            // retried until the consumer made room, the message waits in its channel
+            while (van.receive() == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    TSS463_CHECK_EQUAL(lost, 0);
+    TSS463_CHECK_EQUAL(errors, 0);
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    // receive reserves its slot, it never pushes
+    TSS463_CHECK_EQUAL(ring.overflows(), 0);
+    printf("receive/pop: %u frames, %u channels blocked by the full ring\n", VAN_FRAMES, ring.blocked());
+}
+
+static void test_ring_full()
+{
+    static TSS463_FrameRingBuffer<4> ring;
+    VanFrame frame;
+    van.set_frame_ring(&ring);
+
+    for (uint32_t i = 0; i < ring.capacity(); i++)
+    {
+        TSS463_CHECK(probe.receive(0x8A4, 100 + i));
+        TSS463_CHECK_EQUAL(van.receive(), 1);
+    }
+
+    // the ring is full: the message stays in the channel, which is not reactivated
+    TSS463_CHECK(probe.receive(0x8A4, 200));
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    // counted once however many times receive finds the ring full
+    TSS463_CHECK_EQUAL(ring.blocked(), 1);
+    TSS463_CHECK(van.message_available(0).data.CHRx);
+    TSS463_CHECK(!probe.receive(0x8A4, 201));
+
+    // room again: the same message is stored and the channel is reactivated
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK(is_frame(frame, 100));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(probe.receive(0x8A4, 202));
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    // full again after the message was stored: a new count
+    TSS463_CHECK_EQUAL(ring.blocked(), 2);
+
+    uint8_t expected[] = { 101, 102, 200 };
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        TSS463_CHECK(ring.pop(frame));
+        TSS463_CHECK(is_frame(frame, expected[i]));
+    }
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK(is_frame(frame, 202));
+    TSS463_CHECK(!ring.pop(frame));
+    TSS463_CHECK_EQUAL(ring.overflows(), 0);
+
+    // a push into the full ring is an overflow, not a blocked channel
+    frame.Length = 0;
+    for (uint8_t i = 0; i < ring.capacity(); i++)
+    {
+        TSS463_CHECK(ring.push(frame));
+    }
+    TSS463_CHECK(!ring.push(frame));
+    TSS463_CHECK(!ring.push(frame));
+    TSS463_CHECK_EQUAL(ring.overflows(), 2);
+    TSS463_CHECK_EQUAL(ring.blocked(), 2);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(0, 0x8A4, 4, 1, 0xFFF));
+    van.set_rearm_policy(0, REARM_IMMEDIATE);
+
+    test_threads_ring_only();
+    test_threads_receive();
+    test_ring_full();
+    return tss463_test_result("test_frame_ring");
+}
@@ -0,0 +1,112 @@
+/*
+    Handlers: one frame on the bus gives exactly one call of its handler, over any number of process calls and for every rearm policy
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_handlers.cpp ../../src/tss463_*.cpp -o test_handlers && ./test_handlers
+*/
+#include "tss463_test.h"
+
+#define IT_PIN 2
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static TSS463_HandlerTable<4> handlers;
+static uint32_t calls[3];
+static uint8_t lastData = 0;
+
+static void on_door(const VanMessageView& message, void*)
+{
+    calls[0]++;
+    lastData = message.Data[0];
+}
+
+static void on_temperature(const VanMessageView& message, void*)
+{
+    calls[1]++;
+    lastData = message.Data[0];
+}
+
+static void on_radio(const VanMessageView& message, void*)
+{
+    calls[2]++;
+    lastData = message.Data[0];
+}
+
+// one frame, then process is called until it has nothing left: exactly one dispatch
+static void check_one_dispatch(uint16_t identifier, uint8_t handler, uint8_t first)
+{
+    uint32_t before = calls[handler];
+    TSS463_CHECK(probe.receive(identifier, first));
+
+    uint8_t dispatched = 0;
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        dispatched += van.process();
+    }
+    TSS463_CHECK_EQUAL(dispatched, 1);
+    TSS463_CHECK_EQUAL(calls[handler] - before, 1);
+    TSS463_CHECK_EQUAL(lastData, first);
+}
+
+static void test_policies()
+{
+    // REARM_AFTER_ACK: dispatched once until acknowledged, then the next frame is dispatched once
+    check_one_dispatch(0x4FC, 0, 0x10);
+    TSS463_CHECK(van.reactivate_channel(0));
+    check_one_dispatch(0x4FC, 0, 0x20);
+    TSS463_CHECK(van.reactivate_channel(0));
+
+    check_one_dispatch(0x8A4, 1, 0x30);
+    check_one_dispatch(0x8A4, 1, 0x40);
+
+    check_one_dispatch(0x4D4, 2, 0x50);
+    TSS463_CHECK(!van.is_channel_occupied(2));
+}
+
+// a message without a handler is counted as unhandled once, and its channel is not left waiting for an acknowledge
+static void test_unhandled()
+{
+    TSS463_CHECK(van.set_channel_for_receive_message(3, 0x564, 4, 1, 0xFFF));
+    uint32_t unhandled = handlers.unhandled();
+    TSS463_CHECK(probe.receive(0x564, 0x60));
+    TSS463_CHECK_EQUAL(van.process(), 0);
+    TSS463_CHECK_EQUAL(van.process(), 0);
+    TSS463_CHECK_EQUAL(handlers.unhandled() - unhandled, 1);
+    TSS463_CHECK(probe.receive(0x564, 0x70));
+    van.disable_channel(3);
+}
+
+static void test_interrupt()
+{
+    TSS463_CHECK(van.set_channel_for_receive_message(2, 0x4D4, 4, 1, 0xFFF));
+    van.set_rearm_policy(2, REARM_AFTER_ACK);
+    van.attach_interrupt(IT_PIN);
+
+    check_one_dispatch(0x4FC, 0, 0x80);
+    check_one_dispatch(0x8A4, 1, 0x90);
+    check_one_dispatch(0x4D4, 2, 0xA0);
+    TSS463_CHECK(van.reactivate_channel(0));
+    TSS463_CHECK(van.reactivate_channel(2));
+    check_one_dispatch(0x4FC, 0, 0xB0);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(handlers.on(0x4FC, on_door));
+    TSS463_CHECK(handlers.on(0x8A4, on_temperature));
+    TSS463_CHECK(handlers.on(0x4D4, on_radio));
+    van.set_handlers(&handlers);
+    probe.Van = &van;
+
+    TSS463_CHECK(van.set_channel_for_receive_message(0, 0x4FC, 4, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x8A4, 4, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(2, 0x4D4, 4, 1, 0xFFF));
+    van.set_rearm_policy(1, REARM_IMMEDIATE);
+    van.set_rearm_policy(2, REARM_ONE_SHOT);
+
+    test_policies();
+    test_unhandled();
+    test_interrupt();
+    return tss463_test_result("test_handlers");
+}
@@ -0,0 +1,121 @@
+/*
+    Identifier demultiplexers: the table filled by add and the one generated at compile time give the same slots, across the blocks
+    of 64 identifiers, and the identifiers over 0xFFF are rejected without touching the tables
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_identifier_demux.cpp ../../src/tss463_*.cpp -o test_identifier_demux && ./test_identifier_demux
+*/
+#include "tss463_test.h"
+
+// not sorted, on both sides of block edges, the first and the last identifier
+static const uint16_t IDENTIFIERS[] = { 0x8A4, 0x000, 0x4FC, 0x03F, 0x040, 0xFFF, 0x4D4, 0x824 };
+#define IDENTIFIER_COUNT (sizeof(IDENTIFIERS) / sizeof(IDENTIFIERS[0]))
+
+static TSS463_IdentifierDemuxTable<IDENTIFIER_COUNT> table;
+static TSS463_StaticIdentifierDemux<0x8A4, 0x000, 0x4FC, 0x03F, 0x040, 0xFFF, 0x4D4, 0x824> constant;
+static TSS463_StaticHandlerTable<0x4FC, 0x8A4> handlers;
+static uint32_t calls[2];
+
+static void on_door(const VanMessageView&, void*)
+{
+    calls[0]++;
+}
+
+static void on_temperature(const VanMessageView&, void*)
+{
+    calls[1]++;
+}
+
+// the slot of every listed identifier is its position, the other identifiers have none
+static void check_slots(const TSS463_IdentifierDemux& demux)
+{
+    uint8_t found = 0;
+    for (uint16_t identifier = 0; identifier < TSS463_IDENTIFIER_COUNT; identifier++)
+    {
+        uint8_t slot = demux.find(identifier);
+        if (slot != TSS463_NO_SLOT)
+        {
+            TSS463_CHECK(slot < IDENTIFIER_COUNT && IDENTIFIERS[slot] == identifier);
+            TSS463_CHECK(demux.contains(identifier));
+            found++;
+        }
+        else
+        {
+            TSS463_CHECK(!demux.contains(identifier));
+        }
+    }
+    TSS463_CHECK_EQUAL(found, IDENTIFIER_COUNT);
+    TSS463_CHECK_EQUAL(demux.count(), IDENTIFIER_COUNT);
+}
+
+static void test_table()
+{
+    // over 0xFFF: rejected, nothing changes
+    TSS463_CHECK(!table.add(0x1000, 0));
+    TSS463_CHECK(!table.add(0xFFFF, 0));
+    TSS463_CHECK_EQUAL(table.count(), 0);
+
+    for (uint8_t i = 0; i < IDENTIFIER_COUNT; i++)
+    {
+        TSS463_CHECK(table.add(IDENTIFIERS[i], i));
+    }
+    check_slots(table);
+
+    // known, full, over 0xFFF
+    TSS463_CHECK(!table.add(0x4FC, 0));
+    TSS463_CHECK(!table.add(0x123, 0));
+    TSS463_CHECK(!table.add(0x1000, 0));
+    TSS463_CHECK_EQUAL(table.find(0x1000), TSS463_NO_SLOT);
+    TSS463_CHECK_EQUAL(table.find(0xFFFF), TSS463_NO_SLOT);
+    TSS463_CHECK(!table.contains(0x1FFF));
+    check_slots(table);
+
+    table.clear();
+    TSS463_CHECK_EQUAL(table.count(), 0);
+    TSS463_CHECK_EQUAL(table.find(0x8A4), TSS463_NO_SLOT);
+}
+
+static void test_constant()
+{
+    check_slots(constant);
+    TSS463_CHECK_EQUAL(constant.capacity(), IDENTIFIER_COUNT);
+    TSS463_CHECK_EQUAL(constant.find(0x1000), TSS463_NO_SLOT);
+
+    // the tables cannot change
+    TSS463_CHECK(!constant.add(0x123, 0));
+    constant.clear();
+    check_slots(constant);
+}
+
+static void test_static_handlers()
+{
+    VanMessageView message;
+    memset(&message, 0, sizeof(message));
+
+    // a listed identifier without a handler goes to the catch-all
+    message.Identifier = 0x4FC;
+    TSS463_CHECK(!handlers.dispatch(message));
+    TSS463_CHECK_EQUAL(handlers.unhandled(), 1);
+
+    TSS463_CHECK(handlers.on(0x4FC, on_door));
+    TSS463_CHECK(handlers.on(0x8A4, on_temperature));
+    TSS463_CHECK(!handlers.on(0x4D4, on_door));
+    TSS463_CHECK(!handlers.on(0x1000, on_door));
+
+    TSS463_CHECK(handlers.dispatch(message));
+    message.Identifier = 0x8A4;
+    TSS463_CHECK(handlers.dispatch(message));
+    message.Identifier = 0x4D4;
+    TSS463_CHECK(!handlers.dispatch(message));
+    TSS463_CHECK_EQUAL(calls[0], 1);
+    TSS463_CHECK_EQUAL(calls[1], 1);
+    TSS463_CHECK_EQUAL(handlers.unhandled(), 2);
+}
+
+int main()
+{
+    test_table();
+    test_constant();
+    test_static_handlers();
+    return tss463_test_result("test_identifier_demux");
+}
@@ -0,0 +1,151 @@
+/*
+    Interrupt driven receive with a simulated INT line: on_interrupt is called when the INT pin of the emulator falls (TSS463_SpiProbe::Van)
+    Two channels receiving before the interrupt is serviced are both read, and the next frames still raise an interrupt
+    A reception serviced before the next frame could end reads only the channel of the Last Message Status Register
+
+    Build and run from this folder:
+      g++ -std=c++11 -I../../src test_interrupt.cpp ../../src/tss463_*.cpp -o test_interrupt && ./test_interrupt
+*/
+#include "tss463_test.h"
+
+#define IT_PIN 2
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+
+static void receive(uint16_t identifier, uint8_t first)
+{
+    // a frame of 7 bytes takes 134 timeslots of 8 us at 125 kbps
+    now += 134 * 8;
+    probe.receive(identifier, first, 7);
+}
+
+static void setup_channels()
+{
+    TSS463_CHECK(van.set_channel_for_receive_message(0, 0x824, 7, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x8A4, 7, 1, 0xFFF));
+    van.set_rearm_policy(0, REARM_IMMEDIATE);
+    van.set_rearm_policy(1, REARM_IMMEDIATE);
+}
+
+// services the interrupts until none is pending, returns the channels which were read (bit n: channel n)
+static uint16_t service(uint8_t expectedData[CHANNELS])
+{
+    uint16_t channels = 0;
+    uint8_t buffer[32];
+    uint8_t length;
+    uint8_t channelId;
+    while ((channelId = van.service_interrupt(&length, buffer)) != TSS463_NO_CHANNEL)
+    {
+        channels |= 1 << channelId;
+        TSS463_CHECK_EQUAL(length, 2 + 7);
+        TSS463_CHECK_EQUAL(buffer[2], expectedData[channelId]);
+    }
+    TSS463_CHECK(!van.interrupt_pending());
+    return channels;
+}
+
+static void test_no_traffic_without_interrupt()
+{
+    uint8_t buffer[32];
+    uint8_t length;
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.service_interrupt(&length, buffer), TSS463_NO_CHANNEL);
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 0);
+}
+
+static void test_two_channels_before_service()
+{
+    uint8_t expected[CHANNELS] = { 0 };
+
+    receive(0x824, 0x10);
+    receive(0x8A4, 0x20);
+    TSS463_CHECK(van.interrupt_pending());
+    expected[0] = 0x10;
+    expected[1] = 0x20;
+    TSS463_CHECK_EQUAL(service(expected), (1 << 0) | (1 << 1));
+
+    // both channels were rearmed: the next frames raise an interrupt again and are read
+    receive(0x8A4, 0x30);
+    TSS463_CHECK(van.interrupt_pending());
+    expected[1] = 0x30;
+    TSS463_CHECK_EQUAL(service(expected), 1 << 1);
+
+    receive(0x824, 0x40);
+    expected[0] = 0x40;
+    TSS463_CHECK_EQUAL(service(expected), 1 << 0);
+}
+
+// true if the status of the channel was read since the probe was cleared
+static bool status_read(uint8_t channelId)
+{
+    for (uint16_t i = 0; i < probe.LogCount; i++)
+    {
+        if (probe.covers(i, READ, CHANNEL_ADDR(channelId) + 3))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void test_prompt_service()
+{
+    uint8_t expected[CHANNELS] = { 0 };
+
+    // serviced right away: the channel of the last message is read, the status of the other channels is not
+    receive(0x8A4, 0x48);
+    probe.clear();
+    expected[1] = 0x48;
+    TSS463_CHECK_EQUAL(service(expected), 1 << 1);
+    TSS463_CHECK(!status_read(0));
+
+    // serviced after the shortest frame: another channel may have received meanwhile, all of them are read
+    receive(0x824, 0x4C);
+    now += 1000;
+    probe.clear();
+    expected[0] = 0x4C;
+    TSS463_CHECK_EQUAL(service(expected), 1 << 0);
+    TSS463_CHECK(status_read(1));
+}
+
+static void test_frame_ring()
+{
+    static TSS463_FrameRingBuffer<8> ring;
+    van.set_frame_ring(&ring);
+
+    receive(0x824, 0x50);
+    receive(0x8A4, 0x60);
+    TSS463_CHECK_EQUAL(van.receive(), 2);
+    TSS463_CHECK(!van.interrupt_pending());
+
+    VanFrame frame;
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x824);
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x50);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x8A4);
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x60);
+    TSS463_CHECK(!ring.pop(frame));
+
+    receive(0x8A4, 0x70);
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x70);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    van.attach_interrupt(IT_PIN);
+    van.set_clock(fake_clock);
+    probe.Van = &van;
+    setup_channels();
+
+    test_no_traffic_without_interrupt();
+    test_two_channels_before_service();
+    test_prompt_service();
+    test_frame_ring();
+    return tss463_test_result("test_interrupt");
+}
@@ -0,0 +1,153 @@
+/*
+    Latency histograms: bucket placement, the overflow bucket and percentile_us, then the transmit and reply latencies recorded by the
+    library with a fake clock, from the arming of a channel to the completion it reads (CHTx, CHRx). A transmission with CHER is not recorded
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_latency.cpp ../../src/tss463_*.cpp -o test_latency && ./test_latency
+*/
+#include "tss463_test.h"
+#include "tss463_latency_histogram.h"
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static TSS463_LatencyHistogramTable<10, 250> replies;
+static TSS463_LatencyHistogramTable<20, 100> transmissions;
+static const uint8_t DATA[7] = { 0x0F, 0x07, 0x00, 0x00, 0x00, 0x00, 0x60 };
+
+// the frames of the chip are transmitted, with the given errors at every attempt (0: success) and the in-frame reply
+static void transmit(uint8_t errors, const VanBusFrame* reply)
+{
+    VanBusFrame frame;
+    while (probe.next_frame(&frame))
+    {
+        probe.frame_sent(errors, reply);
+    }
+}
+
+static void test_buckets()
+{
+    TSS463_LatencyHistogramTable<4, 100> histogram;
+    TSS463_CHECK_EQUAL(histogram.percentile_us(50), 0);
+
+    // the lower edge is in the bucket, the upper edge in the next one, the last bucket takes everything above
+    histogram.add(0);
+    histogram.add(99);
+    histogram.add(100);
+    histogram.add(399);
+    histogram.add(400);
+    histogram.add(100000);
+    TSS463_CHECK_EQUAL(histogram.bucket_count(0), 2);
+    TSS463_CHECK_EQUAL(histogram.bucket_count(1), 1);
+    TSS463_CHECK_EQUAL(histogram.bucket_count(2), 0);
+    TSS463_CHECK_EQUAL(histogram.bucket_count(3), 3);
+    TSS463_CHECK_EQUAL(histogram.bucket_count(4), 0);
+    TSS463_CHECK_EQUAL(histogram.count(), 6);
+    TSS463_CHECK_EQUAL(histogram.min_us(), 0);
+    TSS463_CHECK_EQUAL(histogram.max_us(), 100000);
+
+    // the upper edge of the bucket of the rank, the largest latency in the last bucket
+    TSS463_CHECK_EQUAL(histogram.percentile_us(33), 100);
+    TSS463_CHECK_EQUAL(histogram.percentile_us(34), 200);
+    TSS463_CHECK_EQUAL(histogram.percentile_us(50), 200);
+    TSS463_CHECK_EQUAL(histogram.percentile_us(51), 100000);
+    TSS463_CHECK_EQUAL(histogram.percentile_us(100), 100000);
+
+    // the edge is not above the largest latency
+    histogram.clear();
+    TSS463_CHECK_EQUAL(histogram.count(), 0);
+    histogram.add(30);
+    histogram.add(40);
+    TSS463_CHECK_EQUAL(histogram.percentile_us(99), 40);
+    TSS463_CHECK_EQUAL(histogram.min_us(), 30);
+}
+
+static void test_transmit_latency()
+{
+    now = 1000;
+    TSS463_CHECK(van.set_channel_for_transmit_message(0, 0x8A4, DATA, 7, 0));
+    now = 1600;
+    transmit(0, NULL);
+
+    // the completion is taken when the library reads it
+    now = 1800;
+    TSS463_CHECK(van.message_available(0).data.CHTx);
+    TSS463_CHECK_EQUAL(van.completion_time(0), 1800);
+    TSS463_CHECK_EQUAL(transmissions.count(), 1);
+    TSS463_CHECK_EQUAL(transmissions.bucket_count(8), 1);
+    TSS463_CHECK_EQUAL(transmissions.min_us(), 800);
+
+    // once per arming
+    now = 2500;
+    van.poll_all_channels();
+    TSS463_CHECK_EQUAL(van.completion_time(0), 1800);
+    TSS463_CHECK_EQUAL(transmissions.count(), 1);
+
+    // exceeded retries: the completion time is taken, the latency is not recorded
+    now = 3000;
+    TSS463_CHECK(van.reactivate_channel(0));
+    transmit(1 << 4, NULL);
+    now = 3500;
+    MessageLengthAndStatusRegister status = van.message_available(0);
+    TSS463_CHECK(status.data.CHTx);
+    TSS463_CHECK(status.data.CHER);
+    TSS463_CHECK_EQUAL(van.completion_time(0), 3500);
+    TSS463_CHECK_EQUAL(transmissions.count(), 1);
+    TSS463_CHECK_EQUAL(replies.count(), 0);
+    van.disable_channel(0);
+}
+
+static void test_reply_latency()
+{
+    VanBusFrame reply;
+    reply.Identifier = 0x564;
+    reply.Command.Value = 0;
+    reply.Command.data.EXT = 1;
+    reply.Command.data.RNW = 1;
+    reply.Length = 7;
+    memcpy(reply.Data, DATA, sizeof(DATA));
+
+    // in-frame reply
+    now = 5000;
+    TSS463_CHECK(van.set_channel_for_reply_request_message(1, 0x564, 7, 0));
+    now = 5300;
+    transmit(0, &reply);
+    now = 5750;
+    TSS463_CHECK(van.poll_all_channels() & (1 << 1));
+    TSS463_CHECK_EQUAL(van.completion_time(1), 5750);
+    TSS463_CHECK_EQUAL(replies.count(), 1);
+    TSS463_CHECK_EQUAL(replies.bucket_count(3), 1);
+
+    // the request is sent without a reply (CHTx), the reply comes later in its own frame (CHRx)
+    now = 8000;
+    TSS463_CHECK(van.reactivate_channel(1));
+    transmit(0, NULL);
+    now = 8200;
+    TSS463_CHECK(van.message_available(1).data.CHTx);
+    TSS463_CHECK_EQUAL(replies.count(), 1);
+    TSS463_CHECK_EQUAL(van.completion_time(1), 5750);
+
+    // received without an acknowledge request, so not acknowledged
+    TSS463_CHECK(!probe.frame_received(reply));
+    now = 9100;
+    TSS463_CHECK(van.message_available(1).data.CHRx);
+    TSS463_CHECK_EQUAL(van.completion_time(1), 9100);
+    TSS463_CHECK_EQUAL(replies.count(), 2);
+    TSS463_CHECK_EQUAL(replies.bucket_count(4), 1);
+    TSS463_CHECK_EQUAL(replies.max_us(), 1100);
+
+    // a reply request is not a transmission
+    TSS463_CHECK_EQUAL(transmissions.count(), 1);
+}
+
+int main()
+{
+    test_buckets();
+
+    van.set_clock(fake_clock);
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    van.set_latency_histograms(&replies, &transmissions);
+    test_transmit_latency();
+    test_reply_latency();
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    return tss463_test_result("test_latency");
+}
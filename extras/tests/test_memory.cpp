@@ -0,0 +1,127 @@
+/*
+    Memory of the channels: after a fragmentation of the Message DATA RAM compact_memory moves the buffers together, every message
+    pointer follows its buffer and the data are kept, so a message which did not fit any free area fits again. A message longer than
+    the 30 bytes of a channel is rejected
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_memory.cpp ../../src/tss463_*.cpp -o test_memory && ./test_memory
+*/
+#include "tss463_test.h"
+
+#define DATA_LENGTH 16
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static const uint8_t KEPT[4] = { 0, 2, 4, 5 };
+
+static uint8_t data_byte(uint8_t channelId, uint8_t index)
+{
+    return (channelId << 4) + index;
+}
+
+static void check_kept_channels(uint8_t expectedPointers[4])
+{
+    for (uint8_t k = 0; k < 4; k++)
+    {
+        uint8_t channelId = KEPT[k];
+        MessagePointerRegister pointer;
+        pointer.Value = probe.peek(CHANNEL_ADDR(channelId) + 2);
+        TSS463_CHECK_EQUAL(pointer.data.M_P, expectedPointers[k]);
+        // the first byte of the buffer is the message status, the data follows it
+        for (uint8_t i = 0; i < DATA_LENGTH; i++)
+        {
+            TSS463_CHECK_EQUAL(probe.peek(GETMAIL(pointer.data.M_P + 1 + i)), data_byte(channelId, i));
+        }
+    }
+}
+
+static void test_compact_fragmented()
+{
+    uint8_t data[28];
+    for (uint8_t channelId = 0; channelId < 6; channelId++)
+    {
+        for (uint8_t i = 0; i < DATA_LENGTH; i++)
+        {
+            data[i] = data_byte(channelId, i);
+        }
+        TSS463_CHECK(van.set_channel_for_transmit_message(channelId, 0x100 + channelId, data, DATA_LENGTH, 1));
+    }
+
+    // two holes of 17 bytes and 26 bytes at the end: 60 bytes free, but no room for a buffer of 29
+    van.disable_channel(1);
+    van.disable_channel(3);
+    uint8_t before[4] = { 0, 2 * (DATA_LENGTH + 1), 4 * (DATA_LENGTH + 1), 5 * (DATA_LENGTH + 1) };
+    check_kept_channels(before);
+    memset(data, 0x77, sizeof(data));
+    TSS463_CHECK(!van.set_channel_for_transmit_message(7, 0x564, data, sizeof(data), 1));
+
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.compact_memory(), 128 - 4 * (DATA_LENGTH + 1));
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    uint8_t after[4] = { 0, DATA_LENGTH + 1, 2 * (DATA_LENGTH + 1), 3 * (DATA_LENGTH + 1) };
+    check_kept_channels(after);
+
+    TSS463_CHECK(van.set_channel_for_transmit_message(7, 0x564, data, sizeof(data), 1));
+    MessagePointerRegister pointer;
+    pointer.Value = probe.peek(CHANNEL_ADDR(7) + 2);
+    TSS463_CHECK_EQUAL(pointer.data.M_P, 4 * (DATA_LENGTH + 1));
+}
+
+// the frames on the bus carry the data of the moved buffers
+static void test_transmit_after_compact()
+{
+    VanBusFrame frame;
+    uint8_t sent = 0;
+    while (probe.next_frame(&frame))
+    {
+        uint8_t channelId = frame.Identifier - 0x100;
+        if (frame.Identifier != 0x564)
+        {
+            TSS463_CHECK_EQUAL(frame.Length, DATA_LENGTH);
+            for (uint8_t i = 0; i < DATA_LENGTH; i++)
+            {
+                TSS463_CHECK_EQUAL(frame.Data[i], data_byte(channelId, i));
+            }
+        }
+        else
+        {
+            TSS463_CHECK_EQUAL(frame.Length, 28);
+            TSS463_CHECK_EQUAL(frame.Data[27], 0x77);
+        }
+        probe.frame_sent(0, NULL);
+        sent++;
+    }
+    TSS463_CHECK_EQUAL(sent, 5);
+}
+
+// a channel reserves at most 30 data bytes (M_L[4:0] = 31), a longer message is rejected without writing anything
+static void test_longest_message()
+{
+    uint8_t data[TSS463_MAX_DATA_LENGTH + 1] = { 0 };
+    probe.clear();
+    TSS463_CHECK(!van.set_channel_for_transmit_message(8, 0x4D4, data, TSS463_MAX_DATA_LENGTH + 1, 1));
+    TSS463_CHECK(!van.set_channel_for_receive_message(8, 0x4D4, TSS463_MAX_DATA_LENGTH + 1, 1));
+    TSS463_CHECK(!van.set_channel_for_reply_request_message(8, 0x4D4, 255, 1));
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 0);
+    TSS463_CHECK(!van.is_channel_occupied(8));
+
+    // the longest buffer is moved by compact_memory like the others
+    van.reset_channels();
+    TSS463_CHECK(van.set_channel_for_receive_message(8, 0x4D4, 8, 1));
+    TSS463_CHECK(van.set_channel_for_transmit_message(9, 0x564, data, TSS463_MAX_DATA_LENGTH, 1));
+    van.disable_channel(8);
+    TSS463_CHECK_EQUAL(van.compact_memory(), 128 - (TSS463_MAX_DATA_LENGTH + 1));
+    MessagePointerRegister pointer;
+    pointer.Value = probe.peek(CHANNEL_ADDR(9) + 2);
+    TSS463_CHECK_EQUAL(pointer.data.M_P, 0);
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    test_compact_fragmented();
+    test_transmit_after_compact();
+    test_longest_message();
+    return tss463_test_result("test_memory");
+}
@@ -0,0 +1,111 @@
+/*
+    Message descriptors: a channel set up by set_channel from a VanMessage has the same eight channel registers and the same data as the
+    channel set up by the matching set_channel_for_ method, for every message type and acknowledge setting
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_message_descriptor.cpp ../../src/tss463_*.cpp -o test_message_descriptor && ./test_message_descriptor
+*/
+#include "tss463_test.h"
+
+#define CHANNEL 4
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static const uint8_t DATA[VAN_MAX_FRAME_DATA_LENGTH] = { 0x0F, 0x07, 0x00, 0x00, 0x00, 0x00, 0x60, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                                       0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6 };
+
+static void take_registers(uint8_t registers[8])
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        registers[i] = probe.peek(CHANNEL_ADDR(CHANNEL) + i);
+    }
+}
+
+/*
+    The channel was just set up by a set_channel_for_ method (setUp is its result). It is disabled, its buffer is released and set up again
+    from the descriptor on the same buffer, so the message pointers are equal too
+*/
+static void check_descriptor(const VanMessageDescriptor& message, bool setUp, const uint8_t values[], uint16_t line)
+{
+    uint8_t expected[8];
+    uint8_t actual[8];
+
+    TSS463_CHECK(setUp);
+    take_registers(expected);
+    van.disable_channel(CHANNEL);
+
+    TSS463_CHECK(van.set_channel(CHANNEL, message, values));
+    take_registers(actual);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        if (actual[i] != expected[i])
+        {
+            printf("identifier 0x%03X (line %u): register %u is 0x%02X, expected 0x%02X\n", message.Identifier, line, i, actual[i], expected[i]);
+            tss463_failures++;
+        }
+    }
+    for (uint8_t i = 0; message.HasData && i < message.Length; i++)
+    {
+        TSS463_CHECK_EQUAL(probe.peek(GETMAIL((actual[2] & 0x7F) + 1 + i)), values[i]);
+    }
+    van.disable_channel(CHANNEL);
+}
+
+static void test_transmit()
+{
+    check_descriptor(VanMessage<0x8A4, VAN_MODE_TRANSMIT, 7>::Descriptor,
+        van.set_channel_for_transmit_message(CHANNEL, 0x8A4, DATA, 7, 0), DATA, __LINE__);
+    check_descriptor(VanMessage<0x4FC, VAN_MODE_TRANSMIT, 14, 1>::Descriptor,
+        van.set_channel_for_transmit_message(CHANNEL, 0x4FC, DATA, 14, 1), DATA, __LINE__);
+    check_descriptor(VanMessage<0x524, VAN_MODE_TRANSMIT, VAN_MAX_FRAME_DATA_LENGTH>::Descriptor,
+        van.set_channel_for_transmit_message(CHANNEL, 0x524, DATA, VAN_MAX_FRAME_DATA_LENGTH, 0), DATA, __LINE__);
+}
+
+static void test_receive()
+{
+    check_descriptor(VanMessage<0x4D4, VAN_MODE_RECEIVE, 10, 1>::Descriptor,
+        van.set_channel_for_receive_message(CHANNEL, 0x4D4, 10, 1), NULL, __LINE__);
+    check_descriptor(VanMessage<0x664, VAN_MODE_RECEIVE, 13>::Descriptor,
+        van.set_channel_for_receive_message(CHANNEL, 0x664, 13, 0), NULL, __LINE__);
+    check_descriptor(VanMessage<0x8A4, VAN_MODE_RECEIVE, 7, 1, 0xFFF>::Descriptor,
+        van.set_channel_for_receive_message(CHANNEL, 0x8A4, 7, 1, 0xFFF), NULL, __LINE__);
+    // the spy channel of the monitor example: every identifier, the longest buffer
+    check_descriptor(VanMessage<0x000, VAN_MODE_RECEIVE, TSS463_MAX_DATA_LENGTH>::Descriptor,
+        van.set_channel_for_receive_message(CHANNEL, 0x000, TSS463_MAX_DATA_LENGTH, 0), NULL, __LINE__);
+}
+
+static void test_reply_request()
+{
+    check_descriptor(VanMessage<0x564, VAN_MODE_REPLY_REQUEST, 29, 1>::Descriptor,
+        van.set_channel_for_reply_request_message(CHANNEL, 0x564, 29, 1), NULL, __LINE__);
+    check_descriptor(VanMessage<0xADC, VAN_MODE_REPLY_REQUEST, 28>::Descriptor,
+        van.set_channel_for_reply_request_message(CHANNEL, 0xADC, 28, 0), NULL, __LINE__);
+    check_descriptor(VanMessage<0x000, VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION, TSS463_MAX_DATA_LENGTH>::Descriptor,
+        van.set_channel_for_reply_request_message_without_transmission(CHANNEL, 0x000, TSS463_MAX_DATA_LENGTH), NULL, __LINE__);
+    check_descriptor(VanMessage<0x8C4, VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION, 8, 0, 0xFF0>::Descriptor,
+        van.set_channel_for_reply_request_message_without_transmission(CHANNEL, 0x8C4, 8, 0xFF0), NULL, __LINE__);
+    check_descriptor(VanMessage<0x000, VAN_MODE_REPLY_REQUEST_DETECTION, TSS463_MAX_DATA_LENGTH>::Descriptor,
+        van.set_channel_for_reply_request_detection_message(CHANNEL, 0x000, TSS463_MAX_DATA_LENGTH), NULL, __LINE__);
+}
+
+static void test_reply()
+{
+    check_descriptor(VanMessage<0x4EC, VAN_MODE_IMMEDIATE_REPLY, 12>::Descriptor,
+        van.set_channel_for_immediate_reply_message(CHANNEL, 0x4EC, DATA, 12), DATA, __LINE__);
+    check_descriptor(VanMessage<0x8FC, VAN_MODE_DEFERRED_REPLY, 7, 1>::Descriptor,
+        van.set_channel_for_deferred_reply_message(CHANNEL, 0x8FC, DATA, 7, 1), DATA, __LINE__);
+    check_descriptor(VanMessage<0x8FC, VAN_MODE_DEFERRED_REPLY, 7>::Descriptor,
+        van.set_channel_for_deferred_reply_message(CHANNEL, 0x8FC, DATA, 7, 0), DATA, __LINE__);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    test_transmit();
+    test_receive();
+    test_reply_request();
+    test_reply();
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    return tss463_test_result("test_message_descriptor");
+}
@@ -0,0 +1,144 @@
+/*
+    poll_all_channels reads the status of every channel in the shorter of one burst and one frame per channel, message_available needs
+    one frame per channel. With the default frame overhead the channels of the monitor example are polled in one frame
+
+    Build and run from this folder:
+      g++ -std=c++11 -I../../src test_poll_all_channels.cpp ../../src/tss463_*.cpp -o test_poll_all_channels && ./test_poll_all_channels
+*/
+#include "tss463_test.h"
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+
+static void test_no_channel()
+{
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(), 0);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 0);
+}
+
+// the bus time of a poll is the shorter of one burst from the first to the last occupied channel and one frame per occupied channel
+static void check_bus_time(uint8_t firstChannel, uint8_t lastChannel, uint8_t occupied, uint32_t overheadNs)
+{
+    uint64_t burstNs = tss463_spi_time_ns(1, 2 + (lastChannel - firstChannel) * 8 + 1) + overheadNs;
+    uint64_t perChannelNs = tss463_spi_time_ns(occupied, occupied * 3) + occupied * overheadNs;
+    uint64_t expectedNs = burstNs < perChannelNs ? burstNs : perChannelNs;
+    TSS463_CHECK_EQUAL(probe.BusNs + probe.spi_frames() * overheadNs, expectedNs);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), burstNs < perChannelNs ? 1 : occupied);
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+}
+
+// the receiving channels of the monitor example with the default TSS463_FRAME_OVERHEAD_NS: one burst per poll, idle or not
+static void test_default_overhead()
+{
+    TSS463_CHECK(van.set_channel_for_reply_request_message_without_transmission(0, 0x00, 30));
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x00, 30, 0));
+    TSS463_CHECK(van.set_channel_for_reply_request_message_without_transmission(2, 0x00, 30));
+    TSS463_CHECK(van.set_channel_for_reply_request_detection_message(3, 0x00, 30));
+
+    MessageLengthAndStatusRegister statuses[CHANNELS];
+    // idle: only the reply request detection channel, which is set up with CHTx
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(statuses), 1 << 3);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 1);
+    check_bus_time(0, 3, 4, TSS463_FRAME_OVERHEAD_NS);
+
+    probe.receive(0x8A4, 0, 7);
+    probe.clear();
+    TSS463_CHECK(van.poll_all_channels(statuses) & (1 << 1));
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 1);
+    TSS463_CHECK(statuses[1].data.CHRx);
+
+    // on the SPI bus alone the short frames win
+    van.set_frame_overhead(0);
+    probe.clear();
+    van.poll_all_channels(statuses);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 4);
+    check_bus_time(0, 3, 4, 0);
+    van.set_frame_overhead(TSS463_FRAME_OVERHEAD_NS);
+
+    van.reset_channels();
+}
+
+static void test_channels_far_apart()
+{
+    uint8_t data[8] = { 0 };
+    TSS463_CHECK(van.set_channel_for_transmit_message(0, 0x4FC, data, sizeof(data), 1));
+    TSS463_CHECK(van.set_channel_for_receive_message(5, 0x8A4, 7, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(13, 0x524, 16, 1, 0xFFF));
+    van.set_frame_overhead(0);
+
+    // idle: nothing received, the transmit channel is still waiting for the bus
+    MessageLengthAndStatusRegister statuses[CHANNELS];
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(statuses), 0);
+    check_bus_time(0, 13, 3, 0);
+
+    // a burst from channel 0 to 13 reads 105 bytes, three short frames 9
+    probe.receive(0x8A4, 0, 7);
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(statuses), 1 << 5);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 3);
+    check_bus_time(0, 13, 3, 0);
+    TSS463_CHECK(statuses[5].data.CHRx);
+    TSS463_CHECK(!statuses[13].data.CHRx);
+    uint64_t pollNs = probe.BusNs;
+
+    // the same with message_available: one frame per channel
+    probe.clear();
+    uint16_t available = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (van.message_available(i).data.CHRx && van.is_channel_occupied(i))
+        {
+            available |= 1 << i;
+        }
+    }
+    TSS463_CHECK_EQUAL(available, 1 << 5);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), CHANNELS);
+    TSS463_CHECK(pollNs < probe.BusNs);
+
+    printf("poll of channels 0, 5 and 13: %lu ns (message_available: %u frames, %lu ns)\n", (unsigned long)pollNs, CHANNELS,
+        (unsigned long)probe.BusNs);
+    van.disable_channel(5);
+    van.disable_channel(13);
+}
+
+// with a frame overhead of a few microseconds the burst is shorter for channels next to each other
+static void test_channels_close_together()
+{
+    const uint32_t overheadNs = 20000;
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x8A4, 7, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(2, 0x524, 16, 1, 0xFFF));
+    van.set_frame_overhead(overheadNs);
+
+    probe.receive(0x524, 0, 16);
+    MessageLengthAndStatusRegister statuses[CHANNELS];
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(statuses), 1 << 2);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 1);
+    check_bus_time(0, 2, 3, overheadNs);
+    // the status registers from channel 0 to channel 2 (offset 3 of each)
+    TSS463_CHECK_EQUAL(probe.Log[0].Address, CHANNEL_ADDR(0) + 3);
+    TSS463_CHECK_EQUAL(probe.Log[0].Bytes, 2 + 2 * 8 + 1);
+    TSS463_CHECK(statuses[2].data.CHRx);
+    TSS463_CHECK(!statuses[1].data.CHRx);
+
+    // with channel 13 too, four short frames are shorter than a burst over all the channels
+    TSS463_CHECK(van.set_channel_for_receive_message(13, 0x564, 16, 1, 0xFFF));
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(statuses), 1 << 2);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 4);
+    check_bus_time(0, 13, 4, overheadNs);
+    van.set_frame_overhead(TSS463_FRAME_OVERHEAD_NS);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    test_no_channel();
+    test_default_overhead();
+    test_channels_far_apart();
+    test_channels_close_together();
+    return tss463_test_result("test_poll_all_channels");
+}
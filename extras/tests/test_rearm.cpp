@@ -0,0 +1,144 @@
+/*
+    Rearm policies: a received message is delivered once by receive whatever the policy, a REARM_AFTER_ACK channel is skipped until
+    reactivate_channel, and with REARM_IMMEDIATE the channel cannot receive only between the mailbox read and the next SPI frame
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_rearm.cpp ../../src/tss463_*.cpp -o test_rearm && ./test_rearm
+*/
+#include "tss463_test.h"
+
+#define IMMEDIATE_CHANNEL 0
+#define AFTER_ACK_CHANNEL 1
+#define ONE_SHOT_CHANNEL 2
+#define WILDCARD_CHANNEL 3
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static TSS463_FrameRingBuffer<16> ring;
+static TSS463_IdentifierDemuxTable<4> filter;
+
+// receive is called several times for one frame on the bus, the frame must get into the ring once
+static void test_delivered_once(uint8_t channelId, uint16_t identifier)
+{
+    VanFrame frame;
+    TSS463_CHECK(probe.receive(identifier, 0x10 + channelId));
+
+    uint8_t stored = 0;
+    for (uint8_t i = 0; i < 5; i++)
+    {
+        stored += van.receive();
+    }
+    TSS463_CHECK_EQUAL(stored, 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Channel, channelId);
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x10 + channelId);
+    TSS463_CHECK(!ring.pop(frame));
+}
+
+static void test_after_ack()
+{
+    VanFrame frame;
+    test_delivered_once(AFTER_ACK_CHANNEL, 0x4FC);
+
+    // not acknowledged yet: the channel does not receive, receive does not read it again
+    TSS463_CHECK(!probe.receive(0x4FC, 0x20));
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+
+    TSS463_CHECK(van.reactivate_channel(AFTER_ACK_CHANNEL));
+    TSS463_CHECK(probe.receive(0x4FC, 0x30));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x30);
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+
+    // read by read_message: receive does not deliver it again either
+    TSS463_CHECK(van.reactivate_channel(AFTER_ACK_CHANNEL));
+    TSS463_CHECK(probe.receive(0x4FC, 0x40));
+    uint8_t buffer[32];
+    uint8_t length;
+    van.read_message(AFTER_ACK_CHANNEL, &length, buffer);
+    TSS463_CHECK_EQUAL(buffer[2], 0x40);
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    TSS463_CHECK(van.reactivate_channel(AFTER_ACK_CHANNEL));
+}
+
+static void test_one_shot()
+{
+    test_delivered_once(ONE_SHOT_CHANNEL, 0x8C4);
+    TSS463_CHECK(!van.is_channel_occupied(ONE_SHOT_CHANNEL));
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+}
+
+// a frame dropped by the receive filter is not delivered, so nobody acknowledges it: its channel is reactivated
+static void test_filtered_out()
+{
+    VanFrame frame;
+    TSS463_CHECK(van.set_channel_for_receive_message(WILDCARD_CHANNEL, 0x000, 4, 1, 0x000));
+    TSS463_CHECK(probe.receive(0x5E4, 0x60));
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    TSS463_CHECK(probe.receive(0x664, 0x70));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x664);
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    van.disable_channel(WILDCARD_CHANNEL);
+}
+
+static void test_immediate_blind_window()
+{
+    test_delivered_once(IMMEDIATE_CHANNEL, 0x8A4);
+
+    TSS463_CHECK(probe.receive(0x8A4, 0x80));
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+
+    // the frame reading the mailbox, then the frame reactivating the channel (its status register)
+    uint16_t read = probe.LogCount;
+    uint16_t rearm = probe.LogCount;
+    for (uint16_t i = 0; i < probe.LogCount; i++)
+    {
+        if (read == probe.LogCount && probe.Log[i].Control == READ && probe.Log[i].Address >= GETMAIL(0))
+        {
+            read = i;
+        }
+        if (probe.covers(i, WRITE, CHANNEL_ADDR(IMMEDIATE_CHANNEL) + 3))
+        {
+            rearm = i;
+        }
+    }
+    TSS463_CHECK(read < probe.LogCount);
+    TSS463_CHECK_EQUAL(rearm, read + 1);
+    if (rearm == read + 1)
+    {
+        uint64_t blindNs = probe.Log[rearm].EndNs - probe.Log[read].EndNs;
+        TSS463_CHECK_EQUAL(blindNs, tss463_spi_time_ns(1, 3));
+        printf("REARM_IMMEDIATE: the channel cannot receive for %lu ns after the mailbox read\n", (unsigned long)blindNs);
+    }
+
+    // reactivated: the next frame is received
+    VanFrame frame;
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK(probe.receive(0x8A4, 0x90));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x90);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(IMMEDIATE_CHANNEL, 0x8A4, 4, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(AFTER_ACK_CHANNEL, 0x4FC, 4, 1, 0xFFF));
+    TSS463_CHECK(van.set_channel_for_receive_message(ONE_SHOT_CHANNEL, 0x8C4, 4, 1, 0xFFF));
+    van.set_rearm_policy(IMMEDIATE_CHANNEL, REARM_IMMEDIATE);
+    van.set_rearm_policy(ONE_SHOT_CHANNEL, REARM_ONE_SHOT);
+    TSS463_CHECK(filter.add(0x664, 0));
+    van.set_receive_filter(&filter);
+    van.set_frame_ring(&ring);
+
+    test_after_ack();
+    test_one_shot();
+    test_filtered_out();
+    test_immediate_blind_window();
+    return tss463_test_result("test_rearm");
+}
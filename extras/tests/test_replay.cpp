@@ -0,0 +1,183 @@
+/*
+    Replay of a short recording with the driver on an emulated TSS463C of the bus simulator: the counters of the replay (sent,
+    superseded, expired and skipped frames), the in-flight limit of the channel pool, one frame in flight per identifier,
+    the drift at 100 and 200 percent speed and the end of the replay
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_replay.cpp ../../src/tss463_*.cpp -o test_replay && ./test_replay
+*/
+#include "tss463_test.h"
+#include "tss463_replay.h"
+#include "tss463_bus_simulator.h"
+
+// replay.poll is called every poll period of simulated time
+#define POLL_US 200
+// a replay of this test never takes this long
+#define REPLAY_LIMIT_US 1000000UL
+
+static TSS463_Emulator replayer;
+static TSS463_Emulator car;
+static TSS463_BusSimulator simulator(VAN_125KBPS);
+static TSS463_VAN van(&replayer, VAN_125KBPS);
+
+static uint32_t bus_clock()
+{
+    return (uint32_t)simulator.now_us();
+}
+
+static TSS463_Replay replay(&van, bus_clock);
+
+static VanFrame recorded(uint32_t time, uint16_t identifier, uint8_t length, uint8_t first, bool reply = false)
+{
+    VanFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.Timestamp = time;
+    frame.Identifier = identifier;
+    frame.Length = length;
+    frame.Status.data.RRNW = reply;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        frame.Data[i] = first + i;
+    }
+    return frame;
+}
+
+// runs the replay to its end, returns its duration in microseconds
+static uint32_t run(uint8_t* maxInFlight)
+{
+    uint32_t start = bus_clock();
+    *maxInFlight = 0;
+    while (replay.is_running() && bus_clock() - start < REPLAY_LIMIT_US)
+    {
+        replay.poll();
+        if (replay.in_flight() > *maxInFlight)
+        {
+            *maxInFlight = replay.in_flight();
+        }
+        simulator.run(POLL_US);
+    }
+    TSS463_CHECK(!replay.is_running());
+    return bus_clock() - start;
+}
+
+/*
+    Two channels for the replay. The car requests the 0x8FC reply once at 10 ms and never the 0xADC reply
+*/
+static void test_counters()
+{
+    VanFrame frames[] = {
+        recorded(0, 0x4FC, 11, 0x10),
+        // the same identifier: sent after the first one
+        recorded(0, 0x4FC, 11, 0x20),
+        recorded(1000, 0x824, 7, 0x30),
+        recorded(2000, 0x8FC, 7, 0x40, true),
+        // the next reply of the identifier before the request: its data replaces the first one
+        recorded(3000, 0x8FC, 7, 0x50, true),
+        // a reply request of the other node
+        recorded(4000, 0x564, 0, 0, true),
+        recorded(5000, 0xADC, 5, 0x60, true),
+        // both channels are taken by the replies until the request of 0x8FC
+        recorded(6000, 0x8A4, 7, 0x70),
+    };
+    frames[5].Status.data.RRTR = 1;
+    frames[0].Status.data.RRAK = 1;
+    frames[1].Status.data.RRAK = 1;
+
+    TSS463_CHECK(replay.begin((1 << 0) | (1 << 1)));
+    TSS463_CHECK(replay.start(frames, sizeof(frames) / sizeof(frames[0])));
+    TSS463_CHECK(replay.is_running());
+
+    // the second 0x4FC is due but waits for the first one
+    TSS463_CHECK_EQUAL(replay.poll(), 1);
+    TSS463_CHECK_EQUAL(replay.in_flight(), 1);
+
+    uint8_t maxInFlight;
+    uint32_t duration = run(&maxInFlight);
+    const ReplayStats* stats = replay.stats();
+    TSS463_CHECK_EQUAL(stats->Sent, 5);
+    TSS463_CHECK_EQUAL(stats->Superseded, 1);
+    TSS463_CHECK_EQUAL(stats->Expired, 1);
+    TSS463_CHECK_EQUAL(stats->Skipped, 1);
+    TSS463_CHECK_EQUAL(stats->Errors, 0);
+    TSS463_CHECK_EQUAL(maxInFlight, 2);
+    TSS463_CHECK_EQUAL(replay.in_flight(), 0);
+
+    // the car got the data of the second reply
+    TSS463_CHECK_EQUAL(car.peek(GETMAIL(1)), 0x50);
+    // 0x8A4 waited for the request of 0x8FC at 10 ms
+    TSS463_CHECK(stats->MaxDriftUs >= 10000 - 6000);
+    // the 0xADC reply gave its channel back after the reply window
+    TSS463_CHECK(duration >= 5000 + TSS463_REPLAY_REPLY_WINDOW_MS * 1000UL);
+
+    TSS463_CHECK(!van.is_channel_occupied(0));
+    TSS463_CHECK(!van.is_channel_occupied(1));
+}
+
+/*
+    Every channel for the replay, 10 frames 10 ms apart: the replay takes the recorded time divided by the speed, the drift stays
+    below a frame and a poll period
+*/
+static uint32_t replay_at(uint16_t speed, uint32_t* maxDriftUs)
+{
+    VanFrame frames[10];
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        frames[i] = recorded(i * 10000UL, i % 2 ? 0x824 : 0x8A4, 7, i);
+    }
+    TSS463_LatencyHistogramTable<10, 500> drift;
+
+    TSS463_CHECK(replay.begin((1 << CHANNELS) - 1));
+    replay.set_speed(speed);
+    replay.set_drift_histogram(&drift);
+    replay.clear_stats();
+    TSS463_CHECK(replay.start(frames, 10));
+
+    uint8_t maxInFlight;
+    uint32_t duration = run(&maxInFlight);
+    TSS463_CHECK_EQUAL(replay.stats()->Sent, 10);
+    TSS463_CHECK_EQUAL(drift.count(), 10);
+    TSS463_CHECK_EQUAL(drift.max_us(), replay.stats()->MaxDriftUs);
+    TSS463_CHECK_EQUAL(maxInFlight, 1);
+    replay.set_drift_histogram(NULL);
+
+    *maxDriftUs = replay.stats()->MaxDriftUs;
+    return duration;
+}
+
+static void test_speed()
+{
+    uint32_t frameUs = TSS463_BusSimulator::frame_timeslots(7) * 8;
+    uint32_t drift100;
+    uint32_t drift200;
+
+    uint32_t duration100 = replay_at(100, &drift100);
+    uint32_t duration200 = replay_at(200, &drift200);
+    printf("speed 100: %lu us, max drift %lu us; speed 200: %lu us, max drift %lu us\n", (unsigned long)duration100, (unsigned long)drift100,
+        (unsigned long)duration200, (unsigned long)drift200);
+
+    TSS463_CHECK(duration100 >= 90000);
+    TSS463_CHECK(duration100 <= 90000 + frameUs + 3 * POLL_US);
+    TSS463_CHECK(duration200 >= 45000);
+    TSS463_CHECK(duration200 <= 45000 + frameUs + 3 * POLL_US);
+    TSS463_CHECK(drift100 <= frameUs + 2 * POLL_US);
+    TSS463_CHECK(drift200 <= frameUs + 2 * POLL_US);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    van.set_clock(bus_clock);
+    simulator.add_node(&replayer);
+    simulator.add_node(&car);
+
+    // the rest of the car: a reply request of 0x8FC at 10 ms, a channel acknowledging every frame
+    TSS463_CHECK(simulator.setup_transmit(1, 0, 0x8FC, NULL, 7, true));
+    car.poke(CHANNEL_ADDR(0) + 1, car.peek(CHANNEL_ADDR(0) + 1) | 0x03); // RNW = 1, RTR = 1
+    TSS463_CHECK(simulator.add_periodic(1, 0, 10000000UL, 10000) != 0xFF);
+    TSS463_CHECK(simulator.setup_receive(1, CHANNELS - 1, 0x000, 0x000, 0, true));
+    simulator.auto_rearm(1, CHANNELS - 1);
+
+    test_counters();
+    test_speed();
+    return tss463_test_result("test_replay");
+}
@@ -0,0 +1,239 @@
+/*
+    Resync after a brown-out: the TSS463C stops answering, then comes back with its registers reset.
+    The resync is requested after TSS463_RESYNC_THRESHOLD frames in a row without the answer and runs at the next entry point only,
+    a failed resync is retried, and the restored channels keep their state: a transmitted message is not sent again
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_resync.cpp ../../src/tss463_*.cpp -o test_resync && ./test_resync
+*/
+#include "tss463_test.h"
+
+/*
+    TSS463_SpiProbe whose supply can be cut: while Off it does not answer and ignores the SPI bytes
+    The registers are lost by the initialization sequence of the resync, which resets the TSS463C
+*/
+class TSS463_BrownOutChip : public TSS463_SpiProbe
+{
+public:
+    bool Off = false;
+
+    void select()
+    {
+        if (!Off)
+        {
+            TSS463_SpiProbe::select();
+        }
+    }
+
+    uint8_t transfer(uint8_t data)
+    {
+        return Off ? 0xFF : TSS463_SpiProbe::transfer(data);
+    }
+
+    void unselect()
+    {
+        if (!Off)
+        {
+            TSS463_SpiProbe::unselect();
+        }
+    }
+
+    void power_up()
+    {
+        Off = false;
+    }
+
+    // number of initialization sequences (0x00, 0x00) logged since clear
+    uint16_t initializations()
+    {
+        uint16_t count = 0;
+        for (uint16_t i = 0; i < LogCount; i++)
+        {
+            if (Log[i].Address == MOTOROLA_MODE && Log[i].Control == MOTOROLA_MODE)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+static TSS463_BrownOutChip chip;
+static TSS463_VAN van(&chip, VAN_125KBPS);
+static TSS463_FrameRingBuffer<2> ring;
+static const uint8_t DATA[7] = { 0x0F, 0x07, 0x00, 0x00, 0x00, 0x00, 0x60 };
+
+// frames without the answer, from a method which is not an entry point
+static void unanswered_frames(uint8_t count)
+{
+    chip.Off = true;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        van.read_bus_status();
+    }
+}
+
+// transmits the frames of the chip, returns their number, the identifier and the data of the last one
+static uint8_t transmit(uint16_t* identifier, uint8_t data[])
+{
+    VanBusFrame frame;
+    uint8_t frames = 0;
+    while (chip.next_frame(&frame))
+    {
+        *identifier = frame.Identifier;
+        memcpy(data, frame.Data, frame.Length);
+        chip.frame_sent(0, NULL);
+        frames++;
+    }
+    return frames;
+}
+
+// the initialization sequence alone resets the registers
+static void test_initialization_sequence()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(3, 0x664, 7, 1));
+    TSS463_CHECK(chip.is_active());
+
+    chip.select();
+    chip.transfer(MOTOROLA_MODE);
+    chip.transfer(MOTOROLA_MODE);
+    chip.unselect();
+    TSS463_CHECK(!chip.is_active());
+    TSS463_CHECK_EQUAL(chip.peek(CHANNEL_ADDR(3) + 3), 0xFF);
+    TSS463_CHECK(!chip.receive(0x664, 0x10, 7));
+}
+
+static void test_threshold()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(3, 0x664, 7, 1));
+
+    // one frame less than the threshold: an answered frame ends the run, nothing is requested
+    unanswered_frames(TSS463_RESYNC_THRESHOLD - 1);
+    chip.Off = false;
+    van.read_bus_status();
+    chip.clear();
+    van.message_available(3);
+    TSS463_CHECK_EQUAL(chip.initializations(), 0);
+    TSS463_CHECK_EQUAL(van.spi_stats().HandshakeErrors, TSS463_RESYNC_THRESHOLD - 1);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 0);
+
+    // the threshold is reached, the chip comes back: the frames outside the entry points do not resync
+    unanswered_frames(TSS463_RESYNC_THRESHOLD);
+    chip.power_up();
+    chip.clear();
+    van.read_bus_status();
+    TSS463_CHECK_EQUAL(chip.LogCount, 1);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 0);
+
+    // the next entry point resyncs first, then reads the channel
+    van.message_available(3);
+    TSS463_CHECK_EQUAL(chip.initializations(), 1);
+    TSS463_CHECK_EQUAL(chip.Log[1].Address, MOTOROLA_MODE);
+    TSS463_CHECK(chip.covers(chip.LogCount - 1, READ, CHANNEL_ADDR(3) + 3));
+    TSS463_CHECK_EQUAL(van.spi_stats().HandshakeErrors, 2 * TSS463_RESYNC_THRESHOLD - 1);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 1);
+    TSS463_CHECK(chip.is_active());
+    TSS463_CHECK(chip.receive(0x664, 0x10, 7));
+}
+
+static void test_retry()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK(van.set_channel_for_receive_message(3, 0x664, 7, 1));
+
+    // the chip is still off at the entry point: the resync fails, the read reports nothing
+    unanswered_frames(TSS463_RESYNC_THRESHOLD);
+    TSS463_CHECK_EQUAL(van.message_available(3).Value, 0);
+    TSS463_CHECK_EQUAL(van.poll_all_channels(), 0);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 0);
+    TSS463_CHECK_EQUAL(van.spi_stats().HandshakeErrors, TSS463_RESYNC_THRESHOLD + 2);
+
+    // it is retried by the next entry point, once
+    chip.power_up();
+    chip.clear();
+    TSS463_CHECK_EQUAL(van.poll_all_channels(), 0);
+    TSS463_CHECK_EQUAL(chip.initializations(), 1);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 1);
+    van.poll_all_channels();
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 1);
+    TSS463_CHECK_EQUAL(van.spi_stats().HandshakeErrors, TSS463_RESYNC_THRESHOLD + 2);
+    TSS463_CHECK(chip.receive(0x664, 0x10, 7));
+}
+
+static void test_channel_state()
+{
+    uint16_t identifier = 0;
+    uint8_t data[32];
+    VanFrame frame = {};
+
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    van.set_frame_ring(&ring);
+    TSS463_CHECK(van.set_channel_for_transmit_message(0, 0x8A4, DATA, 7, 0));
+    TSS463_CHECK(van.set_channel_for_receive_message(2, 0x4D4, 7, 1));
+    TSS463_CHECK(van.set_channel_for_receive_message(3, 0x664, 7, 1));
+    TSS463_CHECK(van.set_channel_for_receive_message(4, 0x524, 7, 1));
+    van.set_rearm_policy(2, REARM_AFTER_ACK);
+    van.set_rearm_policy(3, REARM_IMMEDIATE);
+    van.set_rearm_policy(4, REARM_IMMEDIATE);
+
+    // channel 0 transmitted and seen by the library
+    TSS463_CHECK_EQUAL(transmit(&identifier, data), 1);
+    TSS463_CHECK(van.message_available(0).data.CHTx);
+    // channel 1 set up, not transmitted yet
+    TSS463_CHECK(van.set_channel_for_transmit_message(1, 0x4FC, DATA, 7, 0));
+    // channel 2 delivered, it waits for reactivate_channel, channel 4 is held by the full ring
+    TSS463_CHECK(chip.receive(0x4D4, 0x20, 7));
+    TSS463_CHECK(chip.receive(0x524, 0x40, 7));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK_EQUAL(ring.blocked(), 1);
+
+    unanswered_frames(TSS463_RESYNC_THRESHOLD);
+    chip.power_up();
+    TSS463_CHECK_EQUAL(van.receive(), 0);
+    TSS463_CHECK_EQUAL(van.spi_stats().Resyncs, 1);
+
+    // only channel 1 is transmitted, with its data from the shadow copy
+    memset(data, 0, sizeof(data));
+    TSS463_CHECK_EQUAL(transmit(&identifier, data), 1);
+    TSS463_CHECK_EQUAL(identifier, 0x4FC);
+#if TSS463_SHADOW_ENABLED
+    TSS463_CHECK(memcmp(data, DATA, sizeof(DATA)) == 0);
+#endif
+    TSS463_CHECK(van.message_available(0).data.CHTx);
+
+    // channel 2 still waits for its acknowledge
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x4D4);
+    TSS463_CHECK(!chip.receive(0x4D4, 0x21, 7));
+    TSS463_CHECK(van.reactivate_channel(2));
+    TSS463_CHECK(chip.receive(0x4D4, 0x22, 7));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x22);
+
+    // channel 3 is armed again
+    TSS463_CHECK(chip.receive(0x664, 0x30, 7));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x664);
+
+    // channel 4 too: its message was lost with the reset and it is no longer held
+    TSS463_CHECK(chip.receive(0x524, 0x41, 7));
+    TSS463_CHECK_EQUAL(van.receive(), 1);
+    TSS463_CHECK(ring.pop(frame));
+    TSS463_CHECK_EQUAL(frame.Identifier, 0x524);
+    TSS463_CHECK_EQUAL(frame.Data[0], 0x41);
+    TSS463_CHECK_EQUAL(ring.blocked(), 1);
+}
+
+int main()
+{
+    test_initialization_sequence();
+    test_threshold();
+    test_retry();
+    test_channel_state();
+    TSS463_CHECK_EQUAL(chip.Faults, 0);
+    return tss463_test_result("test_resync");
+}
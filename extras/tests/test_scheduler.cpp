@@ -0,0 +1,195 @@
+/*
+    Periodic frames with a fake clock: channels by period, spread first deadlines, one arming per period, missed deadlines and errors
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_scheduler.cpp ../../src/tss463_*.cpp -o test_scheduler && ./test_scheduler
+*/
+#include "tss463_test.h"
+#include "tss463_scheduler.h"
+
+#define STEP_US 100
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static uint8_t counter = 0;
+static uint8_t lastCounter = 0xFF;
+
+static void count_frames(uint16_t, uint8_t payload[], uint8_t)
+{
+    payload[0] = ++counter;
+}
+
+// the bus transmits every ready channel, or fails every attempt until the retries are exceeded
+static void bus(bool errors)
+{
+    VanBusFrame frame;
+    while (probe.next_frame(&frame))
+    {
+        if (!errors && frame.Identifier == 0x4FC)
+        {
+            lastCounter = frame.Data[0];
+        }
+        probe.frame_sent(errors ? 1 << 4 : 0, NULL);
+    }
+}
+
+static uint8_t payloads[4][8];
+static TSS463_Scheduler scheduler(&van, fake_clock);
+static uint8_t frames[4];
+static const uint32_t PERIODS_MS[4] = { 10, 20, 50, 100 };
+
+static void test_start()
+{
+    // registered out of order, the last one on a fixed channel
+    frames[3] = scheduler.add_frame(0x8C4, PERIODS_MS[3], payloads[3], 8, 1, 5);
+    frames[2] = scheduler.add_frame(0x564, PERIODS_MS[2], payloads[2], 8, 1);
+    frames[0] = scheduler.add_frame(0x4FC, PERIODS_MS[0], payloads[0], 8, 1);
+    frames[1] = scheduler.add_frame(0x824, PERIODS_MS[1], payloads[1], 8, 1);
+    TSS463_CHECK(scheduler.set_payload_source(frames[0], count_frames));
+    TSS463_CHECK_EQUAL(scheduler.add_frame(0x8A4, 0, payloads[0], 8, 1), TSS463_NO_FRAME);
+    TSS463_CHECK_EQUAL(scheduler.time_to_next_deadline_us(), 0xFFFFFFFF);
+
+    TSS463_CHECK(scheduler.start());
+    // the shortest period gets the lowest channel (transmitted first by the TSS463C)
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[0]), 0);
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[1]), 1);
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[2]), 2);
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[3]), 5);
+
+    // the first deadlines are spread over the shortest period
+    TSS463_CHECK_EQUAL(scheduler.time_to_next_deadline_us(), 0);
+    TSS463_CHECK_EQUAL(scheduler.poll(), 1);
+    TSS463_CHECK_EQUAL(scheduler.time_to_next_deadline_us(), 2500);
+    now = 2500;
+    TSS463_CHECK_EQUAL(scheduler.poll(), 1);
+    now = 5000;
+    TSS463_CHECK_EQUAL(scheduler.poll(), 1);
+    now = 7500;
+    TSS463_CHECK_EQUAL(scheduler.poll(), 1);
+    TSS463_CHECK_EQUAL(scheduler.time_to_next_deadline_us(), 2500);
+    TSS463_CHECK(van.is_channel_occupied(5));
+}
+
+static void test_one_second()
+{
+    scheduler.clear_stats();
+    for (now = 7500 + STEP_US; now <= 1000000 + 7500; now += STEP_US)
+    {
+        bus(false);
+        scheduler.poll();
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        const ScheduledFrameStats* stats = scheduler.frame_stats(frames[i]);
+        uint32_t expected = 1000 / PERIODS_MS[i];
+        TSS463_CHECK_EQUAL(stats->Released, expected);
+        TSS463_CHECK_EQUAL(stats->Sent, expected);
+        TSS463_CHECK_EQUAL(stats->Missed, 0);
+        TSS463_CHECK_EQUAL(stats->Errors, 0);
+        TSS463_CHECK_EQUAL(stats->SetupFailures, 0);
+        TSS463_CHECK_EQUAL(stats->MaxLatenessUs, 0);
+    }
+    // the payload source ran right before each arming of the frame
+    bus(false);
+    TSS463_CHECK_EQUAL(lastCounter, counter);
+    TSS463_CHECK_EQUAL(counter, 1 + 100);
+}
+
+static void test_missed()
+{
+    scheduler.clear_stats();
+
+    // the bus is busy for two periods: the frame armed at the first deadline keeps its place at the second, which is missed
+    uint32_t start = now;
+    for (; now < start + 20000; now += STEP_US)
+    {
+        scheduler.poll();
+    }
+    TSS463_CHECK_EQUAL(scheduler.frame_stats(frames[0])->Released, 1);
+    TSS463_CHECK_EQUAL(scheduler.frame_stats(frames[0])->Missed, 1);
+    bus(false);
+
+    // poll is not called for 35 ms: the deadlines which passed are missed, the next ones stay on the period
+    now += 35000;
+    scheduler.poll();
+    const ScheduledFrameStats* stats = scheduler.frame_stats(frames[0]);
+    TSS463_CHECK_EQUAL(stats->Released, 2);
+    TSS463_CHECK_EQUAL(stats->Missed, 1 + 3);
+    TSS463_CHECK(stats->MaxLatenessUs >= 35000 - 10000);
+    // every deadline is on the grid of the spread first deadlines
+    TSS463_CHECK_EQUAL((now + scheduler.time_to_next_deadline_us()) % 2500, 0);
+}
+
+static void test_errors()
+{
+    scheduler.clear_stats();
+    uint32_t start = now;
+    for (; now < start + 20000; now += STEP_US)
+    {
+        bus(true);
+        scheduler.poll();
+    }
+    const ScheduledFrameStats* stats = scheduler.frame_stats(frames[0]);
+    TSS463_CHECK_EQUAL(stats->Errors, 2);
+    TSS463_CHECK_EQUAL(stats->Sent, 0);
+    TSS463_CHECK_EQUAL(stats->Released, stats->Errors);
+    TSS463_CHECK_EQUAL(stats->SetupFailures, 0);
+}
+
+static void test_stop()
+{
+    scheduler.stop();
+    TSS463_CHECK_EQUAL(scheduler.time_to_next_deadline_us(), 0xFFFFFFFF);
+    TSS463_CHECK_EQUAL(scheduler.poll(), 0);
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        TSS463_CHECK(!van.is_channel_occupied(i));
+    }
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[0]), TSS463_NO_CHANNEL);
+    TSS463_CHECK_EQUAL(scheduler.frame_channel(frames[3]), 5);
+}
+
+// the Message DATA RAM is full at the first deadline: nothing is released, the setup is tried again at the next deadline
+static void test_setup_failure()
+{
+    static uint8_t payload[8];
+    static uint8_t filler[28];
+    TSS463_Scheduler late(&van, fake_clock);
+
+    // 4 * 29 + 8 bytes of the 128 are used, 8 + 1 are needed
+    for (uint8_t i = 10; i < CHANNELS; i++)
+    {
+        TSS463_CHECK(van.set_channel_for_transmit_message(i, 0x100 + i, filler, 28, 0));
+    }
+    TSS463_CHECK(van.set_channel_for_transmit_message(9, 0x8A4, filler, 7, 0));
+
+    uint8_t frame = late.add_frame(0x4FC, 10, payload, 8, 1);
+    TSS463_CHECK(late.start());
+    TSS463_CHECK_EQUAL(late.poll(), 0);
+    const ScheduledFrameStats* stats = late.frame_stats(frame);
+    TSS463_CHECK_EQUAL(stats->Released, 0);
+    TSS463_CHECK_EQUAL(stats->SetupFailures, 1);
+    TSS463_CHECK(!van.is_channel_occupied(late.frame_channel(frame)));
+
+    van.disable_channel(9);
+    now += 10000;
+    TSS463_CHECK_EQUAL(late.poll(), 1);
+    TSS463_CHECK_EQUAL(stats->Released, 1);
+    TSS463_CHECK_EQUAL(stats->SetupFailures, 1);
+    bus(false);
+    TSS463_CHECK_EQUAL(lastCounter, payload[0]);
+    late.stop();
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    test_start();
+    test_one_second();
+    test_missed();
+    test_errors();
+    test_stop();
+    test_setup_failure();
+    return tss463_test_result("test_scheduler");
+}
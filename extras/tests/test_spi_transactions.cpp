@@ -0,0 +1,117 @@
+/*
+    One SPI transaction per chip-select frame: counts the transactions and the modelled SPI bus time of 30 byte mailbox writes and reads
+
+    Build and run from this folder:
+      g++ -std=c++11 -I../../src test_spi_transactions.cpp ../../src/tss463_*.cpp -o test_spi_transactions && ./test_spi_transactions
+*/
+#include "tss463_test.h"
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+
+static void test_begin()
+{
+    probe.clear();
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    TSS463_CHECK_EQUAL(probe.Transactions, probe.spi_frames());
+    printf("begin: %lu transactions for %lu bytes\n", (unsigned long)probe.Transactions, (unsigned long)probe.Bytes);
+}
+
+static void test_mailbox_write()
+{
+    uint8_t data[30];
+    for (uint8_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = 0x30 + i;
+    }
+
+    probe.clear();
+    TSS463_CHECK(van.set_channel_for_transmit_message(0, 0x4FC, data, sizeof(data), 1));
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    TSS463_CHECK_EQUAL(probe.Transactions, probe.spi_frames());
+    // the data, then the registers of the channel
+    TSS463_CHECK(probe.Transactions <= 2);
+
+    uint16_t dataFrame = probe.LogCount;
+    for (uint16_t i = 0; i < probe.LogCount; i++)
+    {
+        if (probe.covers(i, WRITE, GETMAIL(1)))
+        {
+            dataFrame = i;
+        }
+    }
+    TSS463_CHECK(dataFrame < probe.LogCount);
+    if (dataFrame < probe.LogCount)
+    {
+        uint64_t start = dataFrame > 0 ? probe.Log[dataFrame - 1].EndNs : 0;
+        uint64_t burstNs = probe.Log[dataFrame].EndNs - start;
+        uint64_t bytewiseNs = sizeof(data) * tss463_spi_time_ns(1, 3);
+
+        TSS463_CHECK_EQUAL(probe.Log[dataFrame].Bytes, 2 + sizeof(data));
+        TSS463_CHECK_EQUAL(burstNs, tss463_spi_time_ns(1, 2 + sizeof(data)));
+        TSS463_CHECK(burstNs * 2 < bytewiseNs);
+        printf("30 byte mailbox write: 1 transaction, %lu ns (a transaction per byte: %u transactions, %lu ns as single byte frames)\n",
+            (unsigned long)burstNs, 2 + (unsigned)sizeof(data), (unsigned long)bytewiseNs);
+    }
+
+    for (uint8_t i = 0; i < sizeof(data); i++)
+    {
+        TSS463_CHECK_EQUAL(probe.peek(GETMAIL(1 + i)), data[i]);
+    }
+}
+
+static void test_mailbox_read()
+{
+    TSS463_CHECK(van.set_channel_for_receive_message(1, 0x8A4, 30, 1, 0xFFF));
+    TSS463_CHECK(probe.receive(0x8A4, 0xA0, 30));
+
+    uint8_t buffer[32];
+    uint8_t length;
+    probe.clear();
+    van.read_message(1, &length, buffer);
+    TSS463_CHECK_EQUAL(length, 32);
+    TSS463_CHECK_EQUAL(buffer[2], 0xA0);
+    TSS463_CHECK_EQUAL(buffer[31], 0xA0 + 29);
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    // the identifier comes from the setup of the channel, the status and the data are one frame
+    TSS463_CHECK_EQUAL(probe.Transactions, 1);
+    TSS463_CHECK_EQUAL(probe.Bytes, 2 + 1 + 30);
+    printf("30 byte mailbox read: %lu transaction, %lu ns\n", (unsigned long)probe.Transactions, (unsigned long)probe.BusNs);
+}
+
+// one data byte changed in a channel which is set up: with the shadow copy of the mailbox (the default, on AVR too) only that byte is written, in one 3 byte frame
+static void test_payload_update()
+{
+    uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    TSS463_CHECK(van.set_channel_for_transmit_message(2, 0x4FC, data, sizeof(data), 1));
+    MessagePointerRegister pointer;
+    pointer.Value = probe.peek(CHANNEL_ADDR(2) + 2);
+
+    data[3] = 0x40;
+    probe.clear();
+    TSS463_CHECK(van.update_channel_payload(2, data, sizeof(data)));
+    TSS463_CHECK_EQUAL(probe.Faults, 0);
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 1);
+#if TSS463_SHADOW_ENABLED
+    TSS463_CHECK_EQUAL(probe.Log[0].Address, GETMAIL(pointer.data.M_P + 1 + 3));
+    TSS463_CHECK_EQUAL(probe.Log[0].Bytes, 3);
+
+    // nothing changed: nothing is written
+    probe.clear();
+    TSS463_CHECK(van.update_channel_payload(2, data, sizeof(data)));
+    TSS463_CHECK_EQUAL(probe.spi_frames(), 0);
+#else
+    TSS463_CHECK_EQUAL(probe.Log[0].Bytes, 2 + sizeof(data));
+#endif
+    TSS463_CHECK_EQUAL(probe.peek(GETMAIL(pointer.data.M_P + 1 + 3)), 0x40);
+}
+
+int main()
+{
+    test_begin();
+    test_mailbox_write();
+    test_mailbox_read();
+    test_payload_update();
+    return tss463_test_result("test_spi_transactions");
+}
@@ -0,0 +1,82 @@
+/*
+    Timing model of the SPI interface (tss463_timing.h): no wait below the datasheet minimum for any crystal, no wait much longer than needed
+
+    Build and run from this folder:
+      g++ -std=c++11 -I../../src test_timing.cpp ../../src/tss463_*.cpp -o test_timing && ./test_timing
+*/
+#include "tss463_test.h"
+
+static const uint32_t XTAL_FREQUENCIES[] = { 1000000, 3000000, 3686400, 7372800, 8000000, 12000000, 16000000, 20000000 };
+static const uint32_t CPU_FREQUENCIES[] = { 8000000, 16000000, 80000000, 160000000, 240000000 };
+static const uint32_t GAP_XTAL_CLOCKS[] = { TSS463_LEAD_XTAL_CLOCKS, TSS463_ADDRESS_XTAL_CLOCKS, TSS463_CONTROL_XTAL_CLOCKS, TSS463_DATA_XTAL_CLOCKS };
+
+// the fixed waits of the library before the timing model: tLEAD, address, control and data gaps in microseconds
+static const uint32_t FIXED_WAITS_US[] = { 1, 2, 4, 3 };
+
+static void test_gaps_never_below_minimum()
+{
+    for (uint8_t x = 0; x < sizeof(XTAL_FREQUENCIES) / sizeof(XTAL_FREQUENCIES[0]); x++)
+    {
+        for (uint8_t g = 0; g < 4; g++)
+        {
+            uint64_t minimum = (uint64_t)GAP_XTAL_CLOCKS[g] * 1000000000ULL;
+            uint32_t ns = tss463_xtal_clocks_to_ns(GAP_XTAL_CLOCKS[g], XTAL_FREQUENCIES[x]);
+
+            TSS463_CHECK((uint64_t)ns * XTAL_FREQUENCIES[x] >= minimum);
+            // rounded up by less than a nanosecond
+            TSS463_CHECK((uint64_t)(ns - 1) * XTAL_FREQUENCIES[x] < minimum);
+
+            // the busy-waits round up again: CPU cycles (AVR, ESP32) or microseconds (other boards)
+            for (uint8_t c = 0; c < sizeof(CPU_FREQUENCIES) / sizeof(CPU_FREQUENCIES[0]); c++)
+            {
+                uint32_t cycles = tss463_ns_to_cpu_cycles(ns, CPU_FREQUENCIES[c]);
+                TSS463_CHECK((uint64_t)cycles * 1000000000ULL >= (uint64_t)ns * CPU_FREQUENCIES[c]);
+                TSS463_CHECK(cycles == 0 || (uint64_t)(cycles - 1) * 1000000000ULL < (uint64_t)ns * CPU_FREQUENCIES[c]);
+            }
+            TSS463_CHECK(tss463_ns_to_us(ns) * 1000ULL >= ns);
+            TSS463_CHECK(tss463_ns_to_us(ns) * 1000ULL < ns + 1000);
+        }
+    }
+}
+
+static void test_configured_profile()
+{
+    TSS463_CHECK_EQUAL(TSS463_LEAD_GAP_NS, tss463_xtal_clocks_to_ns(TSS463_LEAD_XTAL_CLOCKS, TSS463_XTAL_FREQUENCY));
+    TSS463_CHECK_EQUAL(TSS463_ADDRESS_GAP_NS, tss463_xtal_clocks_to_ns(TSS463_ADDRESS_XTAL_CLOCKS, TSS463_XTAL_FREQUENCY));
+    TSS463_CHECK_EQUAL(TSS463_CONTROL_GAP_NS, tss463_xtal_clocks_to_ns(TSS463_CONTROL_XTAL_CLOCKS, TSS463_XTAL_FREQUENCY));
+    TSS463_CHECK_EQUAL(TSS463_DATA_GAP_NS, tss463_xtal_clocks_to_ns(TSS463_DATA_XTAL_CLOCKS, TSS463_XTAL_FREQUENCY));
+
+    // 4 Mbits/s at most on MOSI, a byte takes at least 2 us
+    TSS463_CHECK(TSS463_SPI_CLOCK <= 4000000);
+    TSS463_CHECK(TSS463_SPI_BYTE_NS >= 2000);
+    TSS463_CHECK((uint64_t)TSS463_SPI_BYTE_NS * TSS463_SPI_CLOCK >= 8ULL * 1000000000ULL);
+}
+
+static void test_frame_model()
+{
+    // a frame reading one register: tLEAD, address byte and gap, control byte and gap, data byte and gap
+    uint64_t oneRegister = TSS463_LEAD_GAP_NS + 3ULL * TSS463_SPI_BYTE_NS + TSS463_ADDRESS_GAP_NS + TSS463_CONTROL_GAP_NS + TSS463_DATA_GAP_NS;
+    TSS463_CHECK_EQUAL(tss463_spi_time_ns(1, 3), oneRegister);
+    TSS463_CHECK_EQUAL(tss463_spi_time_ns(2, 6), 2 * oneRegister);
+
+    // the 128 bytes of the Message DATA RAM in one frame: the waits are the datasheet minimums, about half of the fixed waits before
+    uint64_t waits = tss463_spi_time_ns(1, 2 + 128) - 130ULL * TSS463_SPI_BYTE_NS;
+    uint64_t fixedWaits = (FIXED_WAITS_US[0] + FIXED_WAITS_US[1] + FIXED_WAITS_US[2] + 128ULL * FIXED_WAITS_US[3]) * 1000;
+    TSS463_CHECK_EQUAL(waits, TSS463_LEAD_GAP_NS + TSS463_ADDRESS_GAP_NS + TSS463_CONTROL_GAP_NS + 128ULL * TSS463_DATA_GAP_NS);
+    TSS463_CHECK(waits * TSS463_XTAL_FREQUENCY >= 128ULL * TSS463_DATA_XTAL_CLOCKS * 1000000000ULL);
+    if (TSS463_XTAL_FREQUENCY >= 8000000)
+    {
+        TSS463_CHECK(waits * 2 <= fixedWaits);
+    }
+
+    printf("128 byte mailbox write: %lu ns on the SPI bus, %lu ns of waits (fixed waits: %lu ns)\n", (unsigned long)tss463_spi_time_ns(1, 2 + 128),
+        (unsigned long)waits, (unsigned long)fixedWaits);
+}
+
+int main()
+{
+    test_gaps_never_below_minimum();
+    test_configured_profile();
+    test_frame_model();
+    return tss463_test_result("test_timing");
+}
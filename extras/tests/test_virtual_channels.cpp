@@ -0,0 +1,104 @@
+/*
+    Virtual channels: a receive stream gets only the frames of its identifier, and a channel whose listening window expired
+    is stopped before it is set up for another stream
+
+    Build and run from this folder:
+      g++ -std=c++11 -pthread -I../../src test_virtual_channels.cpp ../../src/tss463_*.cpp -o test_virtual_channels && ./test_virtual_channels
+*/
+#include "tss463_test.h"
+#include "tss463_virtual_channels.h"
+
+static TSS463_SpiProbe probe;
+static TSS463_VAN van(&probe, VAN_125KBPS);
+static TSS463_VirtualChannels virtualChannels(&van, fake_clock);
+static uint8_t buffers[3][8];
+static uint8_t streams[3];
+
+static void test_identifier_of_stream()
+{
+    virtualChannels.poll();
+    // the one channel of the pool listens for the first receive stream
+    TSS463_CHECK_EQUAL(virtualChannels.stream(streams[0])->Channel, 13);
+    // ID_MASK: every bit of the identifier is compared
+    TSS463_CHECK_EQUAL(probe.peek(CHANNEL_ADDR(13) + 6), 0xFF);
+    TSS463_CHECK_EQUAL(probe.peek(CHANNEL_ADDR(13) + 7) & 0xF0, 0xF0);
+
+    // 0x8A4 and 0x8A0 differ only in ID[3:0], which the default mask does not compare
+    TSS463_CHECK(!probe.receive(0x8A0, 0x10, 8));
+    virtualChannels.poll();
+    TSS463_CHECK_EQUAL(virtualChannels.take_received(streams[0]), 0);
+
+    TSS463_CHECK(probe.receive(0x8A4, 0x20, 8));
+    virtualChannels.poll();
+    TSS463_CHECK_EQUAL(virtualChannels.take_received(streams[0]), 8);
+    TSS463_CHECK_EQUAL(buffers[0][0], 0x20);
+}
+
+static uint8_t stream_on(uint8_t channelId)
+{
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        if (virtualChannels.stream(streams[i])->Channel == channelId)
+        {
+            return i;
+        }
+    }
+    return TSS463_NO_STREAM;
+}
+
+static void test_expired_window()
+{
+    // the channel went to the next receive stream (round robin), its window expires while it is still armed
+    uint8_t channelId = 13;
+    uint8_t previous = stream_on(channelId);
+    TSS463_CHECK(previous != TSS463_NO_STREAM);
+    now += TSS463_VC_RECEIVE_WINDOW_MS * 1000UL;
+
+    probe.clear();
+    virtualChannels.poll();
+    uint8_t next = stream_on(channelId);
+    TSS463_CHECK(next != previous && next != TSS463_NO_STREAM);
+    if (next == TSS463_NO_STREAM || previous == TSS463_NO_STREAM)
+    {
+        return;
+    }
+
+    // the status register is written inactive (CHER, CHTx, CHRx) before the channel is set up for the other identifier
+    uint16_t disabled = probe.LogCount;
+    uint16_t setup = probe.LogCount;
+    for (uint16_t i = 0; i < probe.LogCount; i++)
+    {
+        if (!probe.covers(i, WRITE, CHANNEL_ADDR(channelId) + 3))
+        {
+            continue;
+        }
+        if (disabled == probe.LogCount)
+        {
+            disabled = i;
+        }
+        setup = i;
+    }
+    TSS463_CHECK(disabled < setup);
+    TSS463_CHECK(setup < probe.LogCount);
+
+    // the frame of the stream which lost the channel is not taken, the new one is received
+    TSS463_CHECK(!probe.receive(virtualChannels.stream(streams[previous])->Identifier, 0x30, 8));
+    TSS463_CHECK(probe.receive(virtualChannels.stream(streams[next])->Identifier, 0x40, 8));
+    virtualChannels.poll();
+    TSS463_CHECK_EQUAL(virtualChannels.take_received(streams[next]), 8);
+    TSS463_CHECK_EQUAL(buffers[next][0], 0x40);
+    TSS463_CHECK_EQUAL(virtualChannels.take_received(streams[previous]), 0);
+}
+
+int main()
+{
+    TSS463_CHECK_EQUAL(van.begin(), BEGIN_OK);
+    streams[0] = virtualChannels.add_receive(0x8A4, buffers[0], 8, 1);
+    streams[1] = virtualChannels.add_receive(0x4D4, buffers[1], 8, 1);
+    streams[2] = virtualChannels.add_receive(0x564, buffers[2], 8, 1);
+    TSS463_CHECK(virtualChannels.begin(1 << 13));
+
+    test_identifier_of_stream();
+    test_expired_window();
+    return tss463_test_result("test_virtual_channels");
+}
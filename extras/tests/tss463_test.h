@@ -0,0 +1,180 @@
+// tss463_test.h
+#pragma once
+
+#ifndef _tss463_test_h
+    #define _tss463_test_h
+
+#include <stdio.h>
+#include "tss463_van.h"
+#include "tss463_emulator.h"
+
+/*
+    Checks of the host tests, a failed check prints its line and the test returns the number of failed checks
+    Build and run every test from this folder:
+      for test in test_*.cpp; do g++ -std=c++11 -pthread -I../../src $test ../../src/tss463_*.cpp -o ${test%.cpp} && ./${test%.cpp} || echo "$test FAILED"; done
+*/
+static int tss463_failures = 0;
+
+#define TSS463_CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            tss463_failures++; \
+        } \
+    } while (0)
+
+#define TSS463_CHECK_EQUAL(actual, expected) \
+    do \
+    { \
+        long long actualValue = (long long)(actual); \
+        long long expectedValue = (long long)(expected); \
+        if (actualValue != expectedValue) \
+        { \
+            printf("%s:%d: check failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, actualValue, expectedValue); \
+            tss463_failures++; \
+        } \
+    } while (0)
+
+// Time of the tests which drive the clock of the library or of a helper (set_clock, TSS463_Scheduler...), moved by the test
+static uint32_t now = 0;
+
+inline uint32_t fake_clock()
+{
+    return now;
+}
+
+#define TSS463_PROBE_LOG_SIZE 256
+
+typedef struct
+{
+    uint8_t Address;
+    uint8_t Control;
+    // bytes of the frame, the address and control bytes included
+    uint8_t Bytes;
+    // end of the frame (SS high) on the modelled SPI bus
+    uint64_t EndNs;
+}SpiProbeFrame;
+
+/*
+    TSS463_Emulator which also plays the SPIClass of the board: every select is one beginTransaction (see TSS463_SpiTransport)
+    The frames are logged with the time of the SPI bus modelled by tss463_spi_time_ns, so the tests count the transactions and
+    measure windows in bus time. Bytes sent outside a transaction and nested transactions are counted as faults.
+    receive puts a frame on the bus like another module, its INT pin is wired to the library set in Van (attach_interrupt)
+*/
+class TSS463_SpiProbe : public TSS463_Emulator
+{
+private:
+    bool _inTransaction = false;
+    uint8_t _bytes = 0;
+    uint8_t _address = 0;
+    uint8_t _control = 0;
+
+public:
+    uint32_t Transactions = 0;
+    uint32_t Bytes = 0;
+    uint32_t Faults = 0;
+    uint64_t BusNs = 0;
+    SpiProbeFrame Log[TSS463_PROBE_LOG_SIZE];
+    uint16_t LogCount = 0;
+    // when set, its on_interrupt is called when a received frame pulls the INT pin low, like the ISR of attach_interrupt
+    TSS463_VAN* Van = NULL;
+
+    // A frame with an acknowledge request and the data first, first + 1... Returns true if a channel received it
+    bool receive(uint16_t identifier, uint8_t first, uint8_t length = 4)
+    {
+        VanBusFrame frame;
+        frame.Identifier = identifier;
+        frame.Command.Value = 0;
+        frame.Command.data.EXT = 1;
+        frame.Command.data.RAK = 1;
+        frame.Length = length;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            frame.Data[i] = first + i;
+        }
+        bool line = interrupt_line();
+        bool received = frame_received(frame);
+        if (Van != NULL && !line && interrupt_line())
+        {
+            Van->on_interrupt();
+        }
+        return received;
+    }
+
+    void select()
+    {
+        if (_inTransaction)
+        {
+            Faults++;
+        }
+        _inTransaction = true;
+        _bytes = 0;
+        Transactions++;
+        TSS463_Emulator::select();
+    }
+
+    uint8_t transfer(uint8_t data)
+    {
+        if (!_inTransaction)
+        {
+            Faults++;
+        }
+        if (_bytes == 0)
+        {
+            _address = data;
+        }
+        else if (_bytes == 1)
+        {
+            _control = data;
+        }
+        _bytes++;
+        Bytes++;
+        return TSS463_Emulator::transfer(data);
+    }
+
+    void unselect()
+    {
+        if (!_inTransaction)
+        {
+            Faults++;
+        }
+        _inTransaction = false;
+        BusNs += tss463_spi_time_ns(1, _bytes);
+        if (LogCount < TSS463_PROBE_LOG_SIZE)
+        {
+            SpiProbeFrame* frame = &Log[LogCount++];
+            frame->Address = _address;
+            frame->Control = _control;
+            frame->Bytes = _bytes;
+            frame->EndNs = BusNs;
+        }
+        TSS463_Emulator::unselect();
+    }
+
+    void clear()
+    {
+        Transactions = 0;
+        Bytes = 0;
+        Faults = 0;
+        BusNs = 0;
+        LogCount = 0;
+        clear_counters();
+    }
+
+    // True if the logged frame reads or writes the given register
+    bool covers(uint16_t index, uint8_t control, uint8_t address)
+    {
+        const SpiProbeFrame* frame = &Log[index];
+        return frame->Control == control && frame->Bytes > 2 && address >= frame->Address && address < frame->Address + frame->Bytes - 2;
+    }
+};
+
+inline int tss463_test_result(const char* name)
+{
+    printf("%s: %s\n", name, tss463_failures == 0 ? "passed" : "FAILED");
+    return tss463_failures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,485 @@
+#include "tss463_bus_simulator.h"
+#include <string.h>
+
+#define SIM_NO_NODE 0xFF
+
+TSS463_BusSimulator::TSS463_BusSimulator(VAN_SPEED vanSpeed)
+{
+    switch (vanSpeed)
+    {
+        case VAN_62K5BPS:
+            _timeslotsPerSecond = 62500;
+            break;
+        case VAN_125KBPS:
+        default:
+            _timeslotsPerSecond = 125000;
+            break;
+    }
+    memset(_stats, 0, sizeof(_stats));
+}
+
+uint8_t TSS463_BusSimulator::add_node(TSS463_Emulator* emulator)
+{
+    if (_nodeCount >= TSS463_SIM_MAX_NODES)
+    {
+        return SIM_NO_NODE;
+    }
+    if (!emulator->is_active())
+    {
+        emulator->select();
+        emulator->transfer(COMMANDREGISTER);
+        emulator->transfer(WRITE);
+        emulator->transfer(1 << 4); // ACTI
+        emulator->unselect();
+    }
+
+    _nodes[_nodeCount] = emulator;
+    _mailboxUsed[_nodeCount] = 0;
+    _autoRearm[_nodeCount] = 0;
+    return _nodeCount++;
+}
+
+uint64_t TSS463_BusSimulator::us_to_timeslots(uint32_t us)
+{
+    return ((uint64_t)us * _timeslotsPerSecond + 999999) / 1000000;
+}
+
+uint32_t TSS463_BusSimulator::frame_timeslots(uint8_t dataLength)
+{
+    return VAN_SOF_TIMESLOTS + VAN_IDENTIFIER_TIMESLOTS + VAN_COMMAND_TIMESLOTS + dataLength * VAN_DATA_BYTE_TIMESLOTS
+        + VAN_FCS_TIMESLOTS + VAN_EOD_TIMESLOTS + VAN_ACK_TIMESLOTS + VAN_EOF_TIMESLOTS + VAN_IFS_TIMESLOTS;
+}
+
+uint8_t TSS463_BusSimulator::allocate_mailbox(uint8_t node, uint8_t size)
+{
+    if (_mailboxUsed[node] + size > 128)
+    {
+        return SIM_NO_NODE;
+    }
+    uint8_t pointer = _mailboxUsed[node];
+    _mailboxUsed[node] += size;
+    return pointer;
+}
+
+void TSS463_BusSimulator::setup_channel(uint8_t node, uint8_t channelId, uint16_t identifier, uint16_t mask, uint8_t command, uint8_t pointer, uint8_t status)
+{
+    TSS463_Emulator* emulator = _nodes[node];
+    uint8_t base = CHANNEL_ADDR(channelId);
+
+    emulator->poke(base, (uint8_t)(identifier >> 4));
+    emulator->poke(base + 1, (uint8_t)((identifier & 0x0F) << 4) | command);
+    emulator->poke(base + 2, pointer);
+    emulator->poke(base + 3, status);
+    emulator->poke(base + 6, (uint8_t)(mask >> 4));
+    emulator->poke(base + 7, (uint8_t)((mask & 0x0F) << 4));
+}
+
+bool TSS463_BusSimulator::setup_transmit(uint8_t node, uint8_t channelId, uint16_t identifier, const uint8_t data[], uint8_t length, bool ack)
+{
+    if (node >= _nodeCount || channelId >= CHANNELS || length > TSS463_MAX_DATA_LENGTH)
+    {
+        return false;
+    }
+    uint8_t pointer = allocate_mailbox(node, length + 1);
+    if (pointer == SIM_NO_NODE)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _nodes[node]->poke(GETMAIL(pointer + 1 + i), data != NULL ? data[i] : 0);
+    }
+
+    Id2AndCommandRegister command;
+    command.Value = 0;
+    command.data.EXT = 1;
+    command.data.RAK = ack;
+
+    // CHTx = 1: the channel is armed by a periodic source or by the caller
+    MessageLengthAndStatusRegister status;
+    status.Value = 0;
+    status.data.M_L = length + 1;
+    status.data.CHTx = 1;
+
+    setup_channel(node, channelId, identifier, 0x0FFF, command.Value, pointer, status.Value);
+    return true;
+}
+
+bool TSS463_BusSimulator::setup_receive(uint8_t node, uint8_t channelId, uint16_t identifier, uint16_t mask, uint8_t length, bool ack)
+{
+    if (node >= _nodeCount || channelId >= CHANNELS || length > TSS463_MAX_DATA_LENGTH)
+    {
+        return false;
+    }
+    uint8_t pointer = allocate_mailbox(node, length + 1);
+    if (pointer == SIM_NO_NODE)
+    {
+        return false;
+    }
+
+    Id2AndCommandRegister command;
+    command.Value = 0;
+    command.data.EXT = 1;
+    command.data.RAK = ack;
+    command.data.RTR = 1;
+
+    MessagePointerRegister messagePointer;
+    messagePointer.data.M_P = pointer;
+    messagePointer.data.DRAK = !ack;
+
+    MessageLengthAndStatusRegister status;
+    status.Value = 0;
+    status.data.M_L = length + 1;
+
+    setup_channel(node, channelId, identifier, mask, command.Value, messagePointer.Value, status.Value);
+    return true;
+}
+
+uint8_t TSS463_BusSimulator::add_periodic(uint8_t node, uint8_t channelId, uint32_t periodUs, uint32_t offsetUs)
+{
+    // a period of 0 would release the source again and again at the same time slot
+    if (_sourceCount >= TSS463_SIM_MAX_SOURCES || node >= _nodeCount || channelId >= CHANNELS || periodUs == 0)
+    {
+        return SIM_NO_NODE;
+    }
+
+    uint8_t base = CHANNEL_ADDR(channelId);
+    VanPeriodicSource* source = &_sources[_sourceCount];
+    source->Node = node;
+    source->Channel = channelId;
+    source->Identifier = (uint16_t)(_nodes[node]->peek(base) << 4) | (_nodes[node]->peek(base + 1) >> 4);
+    source->Period = (uint32_t)us_to_timeslots(periodUs);
+    source->NextRelease = _now + us_to_timeslots(offsetUs);
+    source->Pending = false;
+
+    MessageLengthAndStatusRegister armed;
+    armed.Value = _nodes[node]->peek(base + 3);
+    armed.data.CHTx = 0;
+    armed.data.CHER = 0;
+    source->ArmedStatus = armed.Value;
+
+    _stats[_sourceCount].Identifier = source->Identifier;
+    return _sourceCount++;
+}
+
+/*
+    Re-arms the channels of the sources whose period has elapsed, a frame still waiting at that moment is lost
+*/
+void TSS463_BusSimulator::release_sources()
+{
+    for (uint8_t i = 0; i < _sourceCount; i++)
+    {
+        VanPeriodicSource* source = &_sources[i];
+        while (source->NextRelease <= _now)
+        {
+            if (source->Pending)
+            {
+                _stats[i].Lost++;
+            }
+
+            _nodes[source->Node]->poke(CHANNEL_ADDR(source->Channel) + 3, source->ArmedStatus);
+
+            source->Pending = true;
+            source->Released = source->NextRelease;
+            source->NextRelease += source->Period;
+            _stats[i].Released++;
+        }
+    }
+}
+
+bool TSS463_BusSimulator::auto_rearm(uint8_t node, uint8_t channelId)
+{
+    if (node >= _nodeCount || channelId >= CHANNELS)
+    {
+        return false;
+    }
+    _autoRearm[node] |= 1 << channelId;
+    _rearmStatus[node][channelId] = _nodes[node]->peek(CHANNEL_ADDR(channelId) + 3);
+    return true;
+}
+
+void TSS463_BusSimulator::rearm_channels()
+{
+    for (uint8_t n = 0; n < _nodeCount; n++)
+    {
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (_autoRearm[n] & (1 << i))
+            {
+                _nodes[n]->poke(CHANNEL_ADDR(i) + 3, _rearmStatus[n][i]);
+            }
+        }
+    }
+}
+
+uint64_t TSS463_BusSimulator::next_release()
+{
+    uint64_t next = UINT64_MAX;
+    for (uint8_t i = 0; i < _sourceCount; i++)
+    {
+        if (_sources[i].NextRelease < next)
+        {
+            next = _sources[i].NextRelease;
+        }
+    }
+    return next;
+}
+
+/*
+    Bitwise arbitration over the identifier, the command and the data field, 0 is dominant
+    The nodes which read a dominant bit while sending a recessive one stop transmitting, missing bits of a shorter frame are recessive
+*/
+void TSS463_BusSimulator::arbitrate(VanBusFrame frames[], bool ready[])
+{
+    uint16_t bits = 16 + TSS463_MAX_DATA_LENGTH * 8;
+
+    for (uint16_t bit = 0; bit < bits; bit++)
+    {
+        uint8_t levels[TSS463_SIM_MAX_NODES] = { 0 };
+        uint8_t bus = 1;
+        uint8_t remaining = 0;
+
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            if (!ready[n])
+            {
+                continue;
+            }
+            remaining++;
+
+            uint8_t level = 1;
+            if (bit < 12)
+            {
+                level = (frames[n].Identifier >> (11 - bit)) & 1;
+            }
+            else if (bit < 16)
+            {
+                level = (frames[n].Command.Value >> (15 - bit)) & 1;
+            }
+            else if ((bit - 16) / 8 < frames[n].Length)
+            {
+                level = (frames[n].Data[(bit - 16) / 8] >> (7 - (bit - 16) % 8)) & 1;
+            }
+            levels[n] = level;
+            bus &= level;
+        }
+
+        if (remaining <= 1)
+        {
+            return;
+        }
+
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            if (ready[n] && levels[n] != bus)
+            {
+                ready[n] = false;
+                _arbitrationLosses++;
+            }
+        }
+    }
+}
+
+void TSS463_BusSimulator::add_latency(uint8_t source, uint64_t latency)
+{
+    VanSourceStats* stats = &_stats[source];
+    uint32_t bin = (uint32_t)(latency / TSS463_SIM_LATENCY_BIN_WIDTH);
+    if (bin > TSS463_SIM_LATENCY_BINS)
+    {
+        bin = TSS463_SIM_LATENCY_BINS;
+    }
+    stats->Histogram[bin]++;
+    if (latency > stats->LatencyMax)
+    {
+        stats->LatencyMax = (uint32_t)latency;
+    }
+}
+
+/*
+    After a transmission attempt of a node: a pending source whose channel is disabled again (CHTx = 1) is done, with CHER set its retries were exceeded
+*/
+void TSS463_BusSimulator::complete_sources(uint8_t node)
+{
+    for (uint8_t i = 0; i < _sourceCount; i++)
+    {
+        VanPeriodicSource* source = &_sources[i];
+        if (source->Node != node || !source->Pending)
+        {
+            continue;
+        }
+
+        MessageLengthAndStatusRegister status;
+        status.Value = _nodes[node]->peek(CHANNEL_ADDR(source->Channel) + 3);
+        if (!status.data.CHTx)
+        {
+            continue;
+        }
+
+        source->Pending = false;
+        if (status.data.CHER)
+        {
+            _stats[i].Lost++;
+        }
+        else
+        {
+            _stats[i].Sent++;
+            add_latency(i, _now - source->Released);
+        }
+    }
+}
+
+void TSS463_BusSimulator::run(uint32_t durationUs)
+{
+    uint64_t end = _now + us_to_timeslots(durationUs);
+    VanBusFrame frames[TSS463_SIM_MAX_NODES];
+    bool ready[TSS463_SIM_MAX_NODES];
+
+    while (_now < end)
+    {
+        release_sources();
+
+        bool anyReady = false;
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            ready[n] = _nodes[n]->next_frame(&frames[n]);
+            anyReady |= ready[n];
+        }
+
+        if (!anyReady)
+        {
+            uint64_t next = next_release();
+            _now = next < end ? next : end;
+            continue;
+        }
+
+        arbitrate(frames, ready);
+
+        uint8_t transmitter = SIM_NO_NODE;
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            if (ready[n])
+            {
+                transmitter = n;
+                break;
+            }
+        }
+        VanBusFrame* frame = &frames[transmitter];
+
+        // a reply request is completed in-frame by the first node with a matching immediate reply channel
+        VanBusFrame reply;
+        uint8_t replier = SIM_NO_NODE;
+        if (frame->Command.data.RNW && frame->Command.data.RTR)
+        {
+            for (uint8_t n = 0; n < _nodeCount; n++)
+            {
+                if (!ready[n] && _nodes[n]->in_frame_reply(*frame, &reply))
+                {
+                    replier = n;
+                    break;
+                }
+            }
+        }
+        const VanBusFrame* onBus = replier != SIM_NO_NODE ? &reply : frame;
+
+        uint32_t duration = frame_timeslots(onBus->Length);
+        _now += duration;
+        _busy += duration;
+        _frames++;
+
+        bool acknowledged = false;
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            if (!ready[n] && n != replier)
+            {
+                acknowledged |= _nodes[n]->frame_received(*onBus);
+            }
+        }
+
+        uint8_t errors = 0;
+        if (replier == SIM_NO_NODE && frame->Command.data.RAK && !acknowledged)
+        {
+            errors = 1 << VAN_ERROR_ACK;
+            _ackErrors++;
+        }
+
+        for (uint8_t n = 0; n < _nodeCount; n++)
+        {
+            if (ready[n])
+            {
+                _nodes[n]->frame_sent(errors, replier != SIM_NO_NODE ? &reply : NULL);
+                complete_sources(n);
+            }
+        }
+
+        rearm_channels();
+    }
+}
+
+uint64_t TSS463_BusSimulator::now_us()
+{
+    return _now * 1000000 / _timeslotsPerSecond;
+}
+
+float TSS463_BusSimulator::bus_load()
+{
+    return _now == 0 ? 0.0f : 100.0f * (float)_busy / (float)_now;
+}
+
+uint32_t TSS463_BusSimulator::frames()
+{
+    return _frames;
+}
+
+uint32_t TSS463_BusSimulator::arbitration_losses()
+{
+    return _arbitrationLosses;
+}
+
+uint32_t TSS463_BusSimulator::ack_errors()
+{
+    return _ackErrors;
+}
+
+uint8_t TSS463_BusSimulator::source_count()
+{
+    return _sourceCount;
+}
+
+const VanSourceStats* TSS463_BusSimulator::source_stats(uint8_t source)
+{
+    return source < _sourceCount ? &_stats[source] : NULL;
+}
+
+uint32_t TSS463_BusSimulator::latency_percentile_us(uint8_t source, uint8_t percent)
+{
+    if (source >= _sourceCount || _stats[source].Sent == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = ((uint64_t)_stats[source].Sent * percent + 99) / 100;
+    uint64_t count = 0;
+    for (uint32_t bin = 0; bin <= TSS463_SIM_LATENCY_BINS; bin++)
+    {
+        count += _stats[source].Histogram[bin];
+        if (count >= target)
+        {
+            if (bin == TSS463_SIM_LATENCY_BINS || (bin + 1) * TSS463_SIM_LATENCY_BIN_WIDTH > _stats[source].LatencyMax)
+            {
+                break;
+            }
+            return (uint32_t)((uint64_t)(bin + 1) * TSS463_SIM_LATENCY_BIN_WIDTH * 1000000 / _timeslotsPerSecond);
+        }
+    }
+    return latency_max_us(source);
+}
+
+uint32_t TSS463_BusSimulator::latency_max_us(uint8_t source)
+{
+    if (source >= _sourceCount)
+    {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)_stats[source].LatencyMax * 1000000 / _timeslotsPerSecond);
+}
@@ -0,0 +1,135 @@
+// tss463_bus_simulator.h
+#pragma once
+
+#ifndef _tss463_bus_simulator_h
+    #define _tss463_bus_simulator_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_registers.h"
+#include "tss463_emulator.h"
+
+#ifndef TSS463_SIM_MAX_NODES
+    #define TSS463_SIM_MAX_NODES 8
+#endif
+#ifndef TSS463_SIM_MAX_SOURCES
+    #define TSS463_SIM_MAX_SOURCES 32
+#endif
+// Latency histogram: bins of this many timeslots, latencies above the last bin are counted in an overflow bin
+#ifndef TSS463_SIM_LATENCY_BINS
+    #define TSS463_SIM_LATENCY_BINS 128
+#endif
+#ifndef TSS463_SIM_LATENCY_BIN_WIDTH
+    #define TSS463_SIM_LATENCY_BIN_WIDTH 16
+#endif
+
+// Bits of the Last Error Status Register (0x07) reported to the transmitter
+#define VAN_ERROR_ACK (2)
+
+typedef struct
+{
+    uint8_t Node;
+    uint8_t Channel;
+    uint16_t Identifier;
+    uint32_t Period;        // timeslots
+    uint64_t NextRelease;   // timeslots
+    uint64_t Released;      // time of the pending frame, timeslots
+    uint8_t ArmedStatus;    // Message Length and Status Register value written at each period
+    bool Pending;
+}VanPeriodicSource;
+
+typedef struct
+{
+    uint16_t Identifier;
+    uint32_t Released;
+    uint32_t Sent;
+    // the previous frame was still waiting when the next period came, or its retry count was exceeded
+    uint32_t Lost;
+    uint32_t LatencyMax;    // timeslots
+    uint32_t Histogram[TSS463_SIM_LATENCY_BINS + 1];
+}VanSourceStats;
+
+/*
+    Discrete-event model of a VAN bus with several emulated TSS463C
+    Each round the ready nodes start a frame, the identifier arbitration is done bit by bit (dominant 0 wins, Page 15),
+    the losers try again on the next round (contention is not an error). Reply requests are completed in-frame by a node
+    with a matching immediate reply channel, RAK frames are acknowledged by the nodes which received them.
+    Periodic sources re-arm a transmit channel (CHTx = 0) like the application would, their latency is measured from the re-arm to the end of the frame.
+*/
+class TSS463_BusSimulator
+{
+private:
+    uint32_t _timeslotsPerSecond;
+    uint64_t _now = 0;
+    uint64_t _busy = 0;
+
+    TSS463_Emulator* _nodes[TSS463_SIM_MAX_NODES];
+    uint8_t _mailboxUsed[TSS463_SIM_MAX_NODES];
+    // channels set back to their setup state after each frame, like an application reading them at once
+    uint16_t _autoRearm[TSS463_SIM_MAX_NODES];
+    uint8_t _rearmStatus[TSS463_SIM_MAX_NODES][CHANNELS];
+    uint8_t _nodeCount = 0;
+
+    VanPeriodicSource _sources[TSS463_SIM_MAX_SOURCES];
+    VanSourceStats _stats[TSS463_SIM_MAX_SOURCES];
+    uint8_t _sourceCount = 0;
+
+    uint32_t _frames = 0;
+    uint32_t _arbitrationLosses = 0;
+    uint32_t _ackErrors = 0;
+
+    uint64_t us_to_timeslots(uint32_t us);
+    uint8_t allocate_mailbox(uint8_t node, uint8_t size);
+    void setup_channel(uint8_t node, uint8_t channelId, uint16_t identifier, uint16_t mask, uint8_t command, uint8_t pointer, uint8_t status);
+    void release_sources();
+    uint64_t next_release();
+    void arbitrate(VanBusFrame frames[], bool ready[]);
+    void complete_sources(uint8_t node);
+    void rearm_channels();
+    void add_latency(uint8_t source, uint64_t latency);
+
+public:
+    TSS463_BusSimulator(VAN_SPEED vanSpeed);
+
+    // Adds an emulator to the bus (sends the activate command if it is idle), returns its node number or 0xFF if the bus is full
+    uint8_t add_node(TSS463_Emulator* emulator);
+
+    // Sets up a channel of a node without the driver (registers and mailbox written directly), false if the mailbox of the node is full
+    bool setup_transmit(uint8_t node, uint8_t channelId, uint16_t identifier, const uint8_t data[], uint8_t length, bool ack);
+    bool setup_receive(uint8_t node, uint8_t channelId, uint16_t identifier, uint16_t mask, uint8_t length, bool ack);
+
+    // Re-arms the transmit (or reply request) channel of the node every period, returns the source number or 0xFF if there are too many sources or the period is 0
+    uint8_t add_periodic(uint8_t node, uint8_t channelId, uint32_t periodUs, uint32_t offsetUs);
+
+    // Sets the channel back to its current state after every frame which changed it (received message read, reply sent)
+    bool auto_rearm(uint8_t node, uint8_t channelId);
+
+    // Runs the bus for the given time
+    void run(uint32_t durationUs);
+
+    uint64_t now_us();
+    // Percent of the time the bus was carrying a frame (including EOF and IFS)
+    float bus_load();
+    uint32_t frames();
+    uint32_t arbitration_losses();
+    uint32_t ack_errors();
+
+    uint8_t source_count();
+    const VanSourceStats* source_stats(uint8_t source);
+    // Latency under which the given percent of the sent frames of the source were completed (upper bound of the histogram bin, at most the maximum), in microseconds
+    uint32_t latency_percentile_us(uint8_t source, uint8_t percent);
+    uint32_t latency_max_us(uint8_t source);
+
+    // Length of a frame with the given number of data bytes, in timeslots
+    static uint32_t frame_timeslots(uint8_t dataLength);
+};
+
+#endif
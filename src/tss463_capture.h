@@ -0,0 +1,374 @@
+// tss463_capture.h
+#pragma once
+
+#ifndef _tss463_capture_h
+    #define _tss463_capture_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+        #include <string.h>
+    #endif
+
+#include "tss463_channel_registers_struct.h"
+#include "tss463_frame_ring.h"
+#include "tss463_handlers.h"
+
+/*
+    Binary capture record of a received frame, the multi-byte fields are sent high byte first
+    ..........................................................................................................
+    : Sync : Size : Time delta  : ID_TAG   : ID_TAG / CMD        : Status       : Channel : Data    : CRC     :
+    : 0xA5 : N    : 1-5 bytes   : ID[11:4] : ID[3:0] EXT RAK     : RRAK RRNW    :         : 0 - 30  : 2 bytes :
+    :      :      : (LEB128)    :          : RNW RTR             : RRTR RM_L    :         : bytes   :         :
+    :......:......:.............:..........:.....................:..............:.........:.........:.........:
+    N is the number of bytes from the time delta to the end of the data, the length of the data is N minus the other fields.
+    The time delta is the number of microseconds since the previous record of the stream (since 0 for the first one), 7 bits
+    per byte with the lowest bits first, bit 7 is set when another byte follows. The command bits are the received ones (the
+    same as in the status). The CRC is CRC-16/CCITT (polynom 0x1021, initial value 0xFFFF) of the size and the following bytes.
+    A reader finds the start of the next record after lost bytes by the sync byte, the size and the CRC.
+*/
+#define TSS463_CAPTURE_SYNC 0xA5
+#define TSS463_CAPTURE_MAX_DATA 30
+#define TSS463_CAPTURE_MAX_HEADER (2 + 5 + 4)
+#define TSS463_CAPTURE_MIN_SIZE (1 + 4)
+#define TSS463_CAPTURE_MAX_SIZE (5 + 4 + TSS463_CAPTURE_MAX_DATA)
+#define TSS463_CAPTURE_MAX_RECORD (2 + TSS463_CAPTURE_MAX_SIZE + 2)
+
+/*
+    CRC-16/CCITT of the data, continuing from the given CRC (0xFFFF at the start), 4 bits at a time with a 16 entry table
+*/
+inline uint16_t tss463_crc16(uint16_t crc, const uint8_t data[], size_t length)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/*
+    Writes the record up to the data into the header (at least TSS463_CAPTURE_MAX_HEADER bytes), returns its length
+    The data and the CRC follow, so the data can be sent from where it was received
+*/
+inline uint8_t tss463_capture_header(uint8_t header[], uint32_t delta, uint16_t identifier, MessageStatusRegister status, uint8_t channel, uint8_t length)
+{
+    uint8_t position = 2;
+    while (delta >= 0x80)
+    {
+        header[position++] = (uint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    header[position++] = (uint8_t)delta;
+
+    header[position++] = (uint8_t)(identifier >> 4);
+    header[position++] = (uint8_t)((identifier & 0x0F) << 4) | (1 << 3) | (status.data.RRAK << 2) | (status.data.RRNW << 1) | status.data.RRTR;
+    header[position++] = status.Value;
+    header[position++] = channel;
+
+    header[0] = TSS463_CAPTURE_SYNC;
+    header[1] = position - 2 + length;
+    return position;
+}
+
+/*
+    Writes a whole record into the given buffer (at least TSS463_CAPTURE_MAX_RECORD bytes), returns its length
+    The data is cut to TSS463_CAPTURE_MAX_DATA bytes
+*/
+inline uint8_t tss463_capture_encode(uint8_t record[], uint32_t delta, uint16_t identifier, MessageStatusRegister status, uint8_t channel, const uint8_t data[], uint8_t length)
+{
+    if (length > TSS463_CAPTURE_MAX_DATA)
+    {
+        length = TSS463_CAPTURE_MAX_DATA;
+    }
+
+    uint8_t position = tss463_capture_header(record, delta, identifier, status, channel, length);
+    memcpy(&record[position], data, length);
+    position += length;
+
+    uint16_t crc = tss463_crc16(0xFFFF, &record[1], position - 1);
+    record[position++] = (uint8_t)(crc >> 8);
+    record[position++] = (uint8_t)crc;
+    return position;
+}
+
+/*
+    Decodes the records of a capture stream into frames, the bytes can be given in pieces of any size
+    The timestamps are the sum of the time deltas (they start from the first record, or from 0 if the capture was started with
+    the writer). A damaged record is skipped and counted, the time delta it carried is lost.
+*/
+class TSS463_CaptureReader
+{
+private:
+    uint8_t _buffer[TSS463_CAPTURE_MAX_RECORD];
+    uint8_t _count = 0;
+    uint32_t _time = 0;
+    uint32_t _records = 0;
+    uint32_t _crcErrors = 0;
+    uint32_t _skippedBytes = 0;
+
+    void drop(uint8_t length)
+    {
+        _count -= length;
+        memmove(_buffer, &_buffer[length], _count);
+    }
+
+    bool decode(VanFrame& frame)
+    {
+        uint8_t end = 2 + _buffer[1];
+        uint8_t position = 2;
+        uint32_t delta = 0;
+        uint8_t shift = 0;
+        uint8_t value;
+        do
+        {
+            if (position >= end || shift > 28)
+            {
+                return false;
+            }
+            value = _buffer[position++];
+            delta |= (uint32_t)(value & 0x7F) << shift;
+            shift += 7;
+        } while (value & 0x80);
+
+        if (end - position < 4)
+        {
+            return false;
+        }
+
+        _time += delta;
+        frame.Timestamp = _time;
+        frame.Identifier = ((uint16_t)_buffer[position] << 4) | (_buffer[position + 1] >> 4);
+        frame.Status.Value = _buffer[position + 2];
+        frame.Channel = _buffer[position + 3];
+        position += 4;
+
+        uint8_t length = end - position;
+        frame.Length = length < TSS463_FRAME_DATA_SIZE ? length : TSS463_FRAME_DATA_SIZE;
+        memcpy(frame.Data, &_buffer[position], frame.Length);
+        return true;
+    }
+
+public:
+    /*
+        Buffers the bytes of the stream, returns how many were taken (fewer than given when a whole record is waiting,
+        take it by next and give the rest again)
+    */
+    size_t feed(const uint8_t data[], size_t length)
+    {
+        size_t taken = sizeof(_buffer) - _count;
+        if (taken > length)
+        {
+            taken = length;
+        }
+        memcpy(&_buffer[_count], data, taken);
+        _count += taken;
+        return taken;
+    }
+
+    /*
+        Takes the next record out of the buffered bytes, returns false if no whole record is buffered yet
+    */
+    bool next(VanFrame& frame)
+    {
+        while (_count > 0)
+        {
+            if (_buffer[0] != TSS463_CAPTURE_SYNC)
+            {
+                _skippedBytes++;
+                drop(1);
+                continue;
+            }
+            if (_count < 2)
+            {
+                return false;
+            }
+            if (_buffer[1] < TSS463_CAPTURE_MIN_SIZE || _buffer[1] > TSS463_CAPTURE_MAX_SIZE)
+            {
+                _skippedBytes++;
+                drop(1);
+                continue;
+            }
+
+            uint8_t length = 2 + _buffer[1] + 2;
+            if (_count < length)
+            {
+                return false;
+            }
+
+            uint16_t crc = tss463_crc16(0xFFFF, &_buffer[1], length - 1);
+            // the CRC over the CRC itself gives 0 when the record is intact
+            if (crc != 0 || !decode(frame))
+            {
+                _crcErrors++;
+                _skippedBytes++;
+                drop(1);
+                continue;
+            }
+
+            drop(length);
+            _records++;
+            return true;
+        }
+        return false;
+    }
+
+    /*
+        Forgets the buffered bytes and the time, for a new capture
+    */
+    void clear()
+    {
+        _count = 0;
+        _time = 0;
+        _records = 0;
+        _crcErrors = 0;
+        _skippedBytes = 0;
+    }
+
+    uint32_t records() const
+    {
+        return _records;
+    }
+
+    uint32_t crc_errors() const
+    {
+        return _crcErrors;
+    }
+
+    // bytes which were not part of a valid record (for example text printed between the records)
+    uint32_t skipped_bytes() const
+    {
+        return _skippedBytes;
+    }
+};
+
+#if defined(ARDUINO)
+/*
+    Writes the received frames as capture records to any Print (a serial port, a file on an SD card...)
+    The header is built in 11 bytes on the stack, the data is written straight from where it was received and only the CRC is
+    computed, there is no formatting per byte. A 7 byte frame takes 17 bytes instead of about 40 as hex text.
+*/
+class TSS463_CaptureWriter
+{
+private:
+    Print* _out;
+    uint32_t _lastTimestamp = 0;
+    bool _isNonBlocking = false;
+    uint32_t _records = 0;
+    uint32_t _bytes = 0;
+    uint32_t _dropped = 0;
+
+public:
+    TSS463_CaptureWriter(Print& out)
+        : _out(&out)
+    {
+    }
+
+    /*
+        Writes one record, returns false if it was dropped (non-blocking mode) or not written completely
+    */
+    bool write(uint32_t timestamp, uint16_t identifier, MessageStatusRegister status, uint8_t channel, const uint8_t data[], uint8_t length)
+    {
+        if (length > TSS463_CAPTURE_MAX_DATA)
+        {
+            length = TSS463_CAPTURE_MAX_DATA;
+        }
+
+        uint8_t header[TSS463_CAPTURE_MAX_HEADER];
+        uint8_t headerLength = tss463_capture_header(header, timestamp - _lastTimestamp, identifier, status, channel, length);
+        size_t recordLength = headerLength + length + 2;
+
+        if (_isNonBlocking && _out->availableForWrite() < (int)recordLength)
+        {
+            // the delta of the next record covers this one
+            _dropped++;
+            return false;
+        }
+
+        uint16_t crc = tss463_crc16(0xFFFF, &header[1], headerLength - 1);
+        crc = tss463_crc16(crc, data, length);
+        uint8_t trailer[2] = { (uint8_t)(crc >> 8), (uint8_t)crc };
+
+        size_t written = _out->write(header, headerLength);
+        written += _out->write(data, length);
+        written += _out->write(trailer, 2);
+
+        _lastTimestamp = timestamp;
+        _bytes += written;
+        if (written != recordLength)
+        {
+            _dropped++;
+            return false;
+        }
+        _records++;
+        return true;
+    }
+
+    /*
+        Writes a frame taken out of the frame ring
+    */
+    bool write(const VanFrame& frame)
+    {
+        return write(frame.Timestamp, frame.Identifier, frame.Status, frame.Channel, frame.Data, frame.Length);
+    }
+
+    /*
+        Writes a message given to a handler, the data is sent from the receive buffer of process()
+    */
+    bool write(const VanMessageView& message)
+    {
+        return write(message.Timestamp, message.Identifier, message.Status, message.Channel, message.Data, message.Length);
+    }
+
+    /*
+        Drops the records which do not fit in the transmit buffer of the Print (availableForWrite) instead of waiting,
+        so a slow link never stalls the receive path. The Print must implement availableForWrite, like HardwareSerial.
+    */
+    void set_non_blocking(bool isNonBlocking)
+    {
+        _isNonBlocking = isNonBlocking;
+    }
+
+    /*
+        The time delta of the next record is counted from 0 (its timestamp), for example when a new file is opened
+    */
+    void restart()
+    {
+        _lastTimestamp = 0;
+    }
+
+    uint32_t records() const
+    {
+        return _records;
+    }
+
+    uint32_t bytes() const
+    {
+        return _bytes;
+    }
+
+    uint32_t dropped() const
+    {
+        return _dropped;
+    }
+
+    void clear_stats()
+    {
+        _records = 0;
+        _bytes = 0;
+        _dropped = 0;
+    }
+};
+#endif
+
+#endif
@@ -6,8 +6,12 @@
 
     #if defined(ARDUINO) && ARDUINO >= 100
         #include "Arduino.h"
-    #else
+    #elif defined(ARDUINO)
         #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
     #endif
 
 /*
@@ -74,4 +78,120 @@ typedef union
     uint8_t Value;
 }MessagePointerRegister;
 
+/*
+Message Status (Pointed by : Message Pointer Register)
+The first byte of a message buffer in the Message DATA RAM is written by the TSS463C on reception
+Page 42
+*/
+typedef union
+{
+    struct
+    {
+        /*
+        Message Length of the Received Frame
+        If the DATA field of the received frame included DATA0 to DATAn, RM_L[4:0] = n+1, even if the reserved length (Message Length and Status Register) is larger.
+        */
+        uint8_t RM_L : 5;
+        // Received RTR Bit: This bit is the RTR bit coming from the COM field of the received frame.
+        uint8_t RRTR : 1;
+        // Received RNW Bit: This bit is the RNW bit coming from the COM field of the received frame.
+        uint8_t RRNW : 1;
+        // Received RAK Bit: This bit is the RAK bit coming from the COM field of the received frame.
+        uint8_t RRAK : 1;
+    }data;
+    uint8_t Value;
+}MessageStatusRegister;
+
+/*
+Diagnosis Control Register (0x02)
+Page 28-30
+*/
+typedef union
+{
+    struct
+    {
+        // Enable System Diagnosis Clock: the SDC divider controls the cycle time of the synchronous diagnosis
+        uint8_t ESDC : 1;
+        // Enable Transmission In Progress: enables the transmission diagnosis
+        uint8_t ETIP : 1;
+        /*
+        Operating mode (Table 7) Ma Mb: 00 communication on RxD0 (differential), 01 on RxD2, 10 on RxD1, 11 automatic selection
+        */
+        uint8_t Mb   : 1;
+        uint8_t Ma   : 1;
+        // The SDC period is the timeslot clock divided by 64 << SDC[3:0]
+        uint8_t SDC  : 4;
+    }data;
+    uint8_t Value;
+}DiagnosisControlRegister;
+
+/*
+Line Status Register (0x04)
+Page 31
+*/
+typedef union
+{
+    struct
+    {
+        // Receiving: there is activity on the bus
+        uint8_t RXG : 1;
+        // Transmitting: an identifier was chosen and is being transmitted until it succeeds or the retry count is exceeded
+        uint8_t TXG : 1;
+        /*
+        Diagnosis system status (Table 8) Sa Sb: 00 nominal, 01 degraded (communication on RxD2), 10 degraded (communication on RxD1), 11 major error
+        */
+        uint8_t Sa  : 1;
+        uint8_t Sb  : 1;
+        // One of the inputs RxD0, RxD1, RxD2 differed from the others, reset by the RI signal or a general reset
+        uint8_t Sc  : 1;
+        uint8_t IDG : 1;
+        uint8_t SPG : 1;
+        uint8_t     : 1;
+    }data;
+    uint8_t Value;
+}LineStatusRegister;
+
+/*
+Transmission Status Register (0x05) and Last Message Status Register (0x06)
+0x05: the retries done so far and the channel currently in transmission
+0x06: the last channel which was successfully transmitted, received or exceeded its retry count, with the retries of a successful transmission (undefined in reception)
+Page 32
+*/
+typedef union
+{
+    struct
+    {
+        uint8_t Channel : 4;
+        uint8_t Retries : 4;
+    }data;
+    uint8_t Value;
+}TransmissionStatusRegister;
+
+/*
+Last Error Status Register (0x07)
+The error code of the last transmission or reception attempt, it is updated after each attempt
+Page 32-33
+*/
+typedef union
+{
+    struct
+    {
+        // Frame Violation: physical violation or collision on the ACK field when the TSS463C is a consumer
+        uint8_t FV   : 1;
+        // Code Violation: Manchester code violation or physical violation on ID, COM, DATA, CRC, or on the preamble and start fields
+        uint8_t CV   : 1;
+        // Acknowledge Error: physical violation or collision on the ACK field when the TSS463C is a producer
+        uint8_t ACKE : 1;
+        // Framing Check Sequence Error: the received FCS does not match
+        uint8_t FCSE : 1;
+        uint8_t      : 1;
+        // Buffer Overflow: the received message was longer than the buffer, data was lost
+        uint8_t BOV  : 1;
+        // Buffer Occupied: the received bit of the buffer was still set
+        uint8_t BOC  : 1;
+        uint8_t      : 1;
+    }data;
+    uint8_t Value;
+}LastErrorStatusRegister;
+
 #endif
@@ -0,0 +1,141 @@
+#include "tss463_diagnostics.h"
+#include <string.h>
+
+TSS463_Diagnostics::TSS463_Diagnostics(TSS463_VAN* van, TSS463_Clock clock)
+{
+    _van = van;
+    _clock = clock != NULL ? clock : tss463_micros;
+    // the values after reset (Figure 22), so the first sample only counts what changed since the initialization
+    memset(&_last, 0, sizeof(_last));
+    _last.Line.data.IDG = 1;
+    clear();
+}
+
+void TSS463_Diagnostics::count_errors(LastErrorStatusRegister error)
+{
+    _counters.Errors++;
+    _counters.FrameViolations += error.data.FV;
+    _counters.CodeViolations += error.data.CV;
+    _counters.AckErrors += error.data.ACKE;
+    _counters.FcsErrors += error.data.FCSE;
+    _counters.BufferOverflows += error.data.BOV;
+    _counters.BufferOccupied += error.data.BOC;
+}
+
+/*
+    Computes the rates when the current window is complete and starts a new one
+*/
+void TSS463_Diagnostics::roll_window(uint32_t now)
+{
+    uint32_t elapsed = now - _windowStart;
+    if (elapsed < TSS463_DIAGNOSTICS_WINDOW_MS * 1000UL)
+    {
+        return;
+    }
+
+    uint32_t messages = _counters.Transmissions + _counters.Receptions;
+    _errorRate = (_counters.Errors - _windowErrors) * 1000000.0f / elapsed;
+    _retryRate = (_counters.Retries - _windowRetries) * 1000000.0f / elapsed;
+    _messageRate = (messages - _windowMessages) * 1000000.0f / elapsed;
+
+    _windowStart = now;
+    _windowErrors = _counters.Errors;
+    _windowRetries = _counters.Retries;
+    _windowMessages = messages;
+}
+
+BusStatus TSS463_Diagnostics::sample()
+{
+    // the status registers and the flags in one frame, the flags come last: an event in between is counted by the next sample
+    uint8_t flags;
+    BusStatus status = _van->take_bus_status(&flags);
+    _counters.Samples++;
+
+    VAN_LINE_MODE mode = tss463_line_mode(status.Line);
+    if (mode == VAN_LINE_MAJOR_ERROR)
+    {
+        _counters.MajorErrorSamples++;
+    }
+    else if (mode != VAN_LINE_NOMINAL)
+    {
+        _counters.DegradedSamples++;
+    }
+    if (mode != VAN_LINE_NOMINAL && tss463_line_mode(_last.Line) == VAN_LINE_NOMINAL)
+    {
+        _counters.LineFaults++;
+    }
+    if (status.Line.data.Sc)
+    {
+        _counters.InputMismatches++;
+    }
+
+    if (flags & ((1 << TOKE) | (1 << TEE)))
+    {
+        _counters.Transmissions++;
+        // the retries are valid when the last message is a transmission
+        uint8_t channelId = status.LastMessage.data.Channel;
+        if (channelId >= CHANNELS || !_van->is_receiving_channel(channelId))
+        {
+            _counters.Retries += status.LastMessage.data.Retries;
+        }
+    }
+    if (flags & ((1 << ROKE) | (1 << RNOKE)))
+    {
+        _counters.Receptions++;
+    }
+
+    // the errors which were retried raise no flag, they are seen by a change of the Last Error Status Register
+    if ((flags & ((1 << TEE) | (1 << REE))) || (status.LastError.Value != _last.LastError.Value && status.LastError.Value != 0))
+    {
+        count_errors(status.LastError);
+    }
+
+    _last = status;
+    roll_window(_clock());
+    return status;
+}
+
+BusStatus TSS463_Diagnostics::last_status()
+{
+    return _last;
+}
+
+VAN_LINE_MODE TSS463_Diagnostics::line_mode()
+{
+    return tss463_line_mode(_last.Line);
+}
+
+const BusDiagnosticsCounters* TSS463_Diagnostics::counters()
+{
+    return &_counters;
+}
+
+float TSS463_Diagnostics::error_rate()
+{
+    return _errorRate;
+}
+
+float TSS463_Diagnostics::retry_rate()
+{
+    return _retryRate;
+}
+
+float TSS463_Diagnostics::message_rate()
+{
+    return _messageRate;
+}
+
+/*
+    Resets the counters and the rates, the registers of the last sample are kept so only the later changes are counted
+*/
+void TSS463_Diagnostics::clear()
+{
+    memset(&_counters, 0, sizeof(_counters));
+    _windowStart = _clock();
+    _windowErrors = 0;
+    _windowRetries = 0;
+    _windowMessages = 0;
+    _errorRate = 0;
+    _retryRate = 0;
+    _messageRate = 0;
+}
@@ -0,0 +1,111 @@
+// tss463_diagnostics.h
+#pragma once
+
+#ifndef _tss463_diagnostics_h
+    #define _tss463_diagnostics_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_van.h"
+
+// The rates are computed over windows of this length
+#ifndef TSS463_DIAGNOSTICS_WINDOW_MS
+    #define TSS463_DIAGNOSTICS_WINDOW_MS 1000
+#endif
+
+/*
+    State of the VAN bus found by the diagnosis system of the TSS463C from the RxD0 (differential), RxD1 (DATA) and RxD2 (DATA inverted) inputs (Page 22-23)
+*/
+enum VAN_LINE_MODE {
+    VAN_LINE_NOMINAL,
+    // one of the wires is faulty, the TSS463C communicates on the other one
+    VAN_LINE_DEGRADED_RXD2,
+    VAN_LINE_DEGRADED_RXD1,
+    // both wires are faulty
+    VAN_LINE_MAJOR_ERROR,
+};
+
+inline VAN_LINE_MODE tss463_line_mode(LineStatusRegister line)
+{
+    return (VAN_LINE_MODE)((line.data.Sa << 1) | line.data.Sb);
+}
+
+typedef struct
+{
+    uint32_t Samples;
+    // samples which found the TOK or TE flag (a message transmitted or whose retry count was exceeded), and the ROK or RNOK flag
+    uint32_t Transmissions;
+    uint32_t Receptions;
+    // retries of the transmitted messages
+    uint32_t Retries;
+    // samples which found the TE or RE flag or a change of the Last Error Status Register to an error, then the bits of these errors
+    uint32_t Errors;
+    uint32_t FrameViolations;
+    uint32_t CodeViolations;
+    uint32_t AckErrors;
+    uint32_t FcsErrors;
+    uint32_t BufferOverflows;
+    uint32_t BufferOccupied;
+    // samples in a degraded mode and in the major error mode
+    uint32_t DegradedSamples;
+    uint32_t MajorErrorSamples;
+    // changes from the nominal mode to a degraded or the major error mode
+    uint32_t LineFaults;
+    // samples with Sc set: one of the inputs differed from the others
+    uint32_t InputMismatches;
+}BusDiagnosticsCounters;
+
+/*
+    Bus telemetry from the status registers of the TSS463C, without an oscilloscope
+    sample reads the registers 0x04 - 0x07 and takes the interrupt flags in one SPI frame (see take_bus_status). The messages
+    are counted from the TOK, TE, ROK and RNOK flags, so the same message repeated on one channel is counted each time. A flag only
+    tells that at least one such event happened since the previous sample: the counts are exact when sample runs more often than
+    the shortest frame (about 0.5 ms at 125 kbps), otherwise they are a lower bound, good for trends.
+    The rates are computed over the last complete window of TSS463_DIAGNOSTICS_WINDOW_MS.
+*/
+class TSS463_Diagnostics
+{
+private:
+    TSS463_VAN* _van;
+    TSS463_Clock _clock;
+    BusStatus _last;
+    BusDiagnosticsCounters _counters;
+    uint32_t _windowStart = 0;
+    uint32_t _windowErrors = 0;
+    uint32_t _windowRetries = 0;
+    uint32_t _windowMessages = 0;
+    float _errorRate = 0;
+    float _retryRate = 0;
+    float _messageRate = 0;
+
+    void count_errors(LastErrorStatusRegister error);
+    void roll_window(uint32_t now);
+
+public:
+    // clock: time source in microseconds, micros is used when it is NULL
+    TSS463_Diagnostics(TSS463_VAN* van, TSS463_Clock clock = NULL);
+
+    // Reads the status registers in one SPI frame and updates the counters, returns the registers
+    BusStatus sample();
+
+    // Registers and line mode of the last sample
+    BusStatus last_status();
+    VAN_LINE_MODE line_mode();
+
+    const BusDiagnosticsCounters* counters();
+    // Errors, retries and messages (transmitted and received) per second
+    float error_rate();
+    float retry_rate();
+    float message_rate();
+    void clear();
+};
+
+#endif
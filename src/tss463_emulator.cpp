@@ -0,0 +1,602 @@
+#include "tss463_emulator.h"
+#include <string.h>
+
+// Command Register (0x03)
+#define EMU_GRES (7)
+#define EMU_SLEEP (6)
+#define EMU_IDLE (5)
+#define EMU_ACTI (4)
+#define EMU_REAR (3)
+
+// Line Status Register (0x04)
+#define EMU_SPG (6)
+#define EMU_IDG (5)
+#define EMU_TXG (1)
+
+// Last Error Status Register (0x07)
+#define EMU_BOC (6)
+
+#define EMU_NO_CHANNEL 0xFF
+
+TSS463_Emulator::TSS463_Emulator()
+{
+    reset();
+}
+
+/*
+    Default values on init - Figure 22
+    The channel registers are filled with inactive messages (CHTx = CHRx = 1) and the mailbox with a pattern, the real circuit contains random values
+*/
+void TSS463_Emulator::reset()
+{
+    memset(_registers, 0, 0x10);
+    _registers[TRANSMITCONTROL] = 0x02;
+    _registers[LINESTATUS] = 1 << EMU_IDG;
+    _registers[INTERRUPTSTATUS] = 1 << RSTR;
+    _registers[INTERRUPTENABLE] = 1 << RSTR;
+
+    memset(&_registers[CHANNEL_ADDR(0)], 0xFF, CHANNELS * 8);
+
+    for (uint16_t i = GETMAIL(0); i <= 0xFF; i++)
+    {
+        _registers[i] = (uint8_t)(i * 37 + 11);
+    }
+
+    _interruptReleased = false;
+    _txChannel = EMU_NO_CHANNEL;
+    _retries = 0;
+    _attempts = 0;
+}
+
+void TSS463_Emulator::select()
+{
+    _selected = true;
+    _byteIndex = 0;
+}
+
+/*
+    The first byte is the address, the second the control byte (DIR + 1100000), the TSS463C answers 0xAA and 0x55 during these bytes (Page 7)
+    The address auto-increment is inhibited when the address reaches 0xFF
+    The initialization sequence (address 0x00, control 0x00) is an asynchronous software reset, like the RESET pin (Reset)
+*/
+uint8_t TSS463_Emulator::transfer(uint8_t data)
+{
+    uint8_t result = 0xFF;
+
+    if (!_selected)
+    {
+        return result;
+    }
+
+    _spiBytes++;
+
+    switch (_byteIndex)
+    {
+        case 0:
+            _address = data;
+            result = ADDR_ANSW;
+            break;
+        case 1:
+            _control = data;
+            result = CMD_ANSW;
+            if (_address == MOTOROLA_MODE && _control == MOTOROLA_MODE)
+            {
+                reset();
+            }
+            break;
+        default:
+            // the initialization sequence and unknown control bytes carry no data
+            if (_control == WRITE)
+            {
+                write_register(_address, data);
+            }
+            else if (_control == READ)
+            {
+                result = read_register(_address);
+            }
+            else
+            {
+                break;
+            }
+
+            if (_address != 0xFF)
+            {
+                _address++;
+            }
+            break;
+    }
+
+    if (_byteIndex < 2)
+    {
+        _byteIndex++;
+    }
+
+    return result;
+}
+
+void TSS463_Emulator::unselect()
+{
+    if (_selected)
+    {
+        _spiFrames++;
+    }
+    _selected = false;
+}
+
+uint8_t TSS463_Emulator::read_register(uint8_t address)
+{
+    if (address >= 0x08 && address <= INTERRUPTRESET)
+    {
+        _interruptReleased = true;
+    }
+
+    switch (address)
+    {
+        case COMMANDREGISTER:
+        case 0x08:
+        case INTERRUPTRESET:
+        case 0x0C:
+        case 0x0D:
+        case 0x0E:
+        case 0x0F:
+            // write only or reserved
+            return 0x00;
+        default:
+            return _registers[address];
+    }
+}
+
+void TSS463_Emulator::write_register(uint8_t address, uint8_t value)
+{
+    if (address >= 0x08 && address <= INTERRUPTRESET)
+    {
+        _interruptReleased = true;
+    }
+
+    switch (address)
+    {
+        case COMMANDREGISTER:
+            command(value);
+            return;
+        case INTERRUPTRESET:
+            _registers[INTERRUPTSTATUS] &= ~value;
+            return;
+        case LINESTATUS:
+        case TRANSMITSTATUS:
+        case LASTMESSAGESTATUS:
+        case LASTERRORSTATUS:
+        case 0x08:
+        case INTERRUPTSTATUS:
+        case 0x0C:
+        case 0x0D:
+        case 0x0E:
+        case 0x0F:
+            // read only or reserved
+            return;
+    }
+
+    // base_address + 0x04 and + 0x05 are not registers
+    if (address >= CHANNEL_ADDR(0) && address < GETMAIL(0) && (address & 0x07) >= 4 && (address & 0x07) <= 5)
+    {
+        return;
+    }
+
+    _registers[address] = value;
+}
+
+/*
+    Command Register (0x03): the commands are performed at once, the real circuit may need up to 6 timeslots
+*/
+void TSS463_Emulator::command(uint8_t value)
+{
+    if (value & (1 << EMU_GRES))
+    {
+        reset();
+        return;
+    }
+    if (value & (1 << EMU_SLEEP))
+    {
+        _registers[LINESTATUS] |= 1 << EMU_SPG;
+    }
+    if (value & (1 << EMU_IDLE))
+    {
+        _registers[LINESTATUS] |= 1 << EMU_IDG;
+    }
+    if (value & (1 << EMU_ACTI))
+    {
+        _registers[LINESTATUS] &= ~((1 << EMU_SPG) | (1 << EMU_IDG));
+    }
+    if (value & (1 << EMU_REAR))
+    {
+        _txChannel = EMU_NO_CHANNEL;
+        _registers[LINESTATUS] &= ~(1 << EMU_TXG);
+    }
+}
+
+void TSS463_Emulator::set_interrupt(uint8_t flag)
+{
+    _registers[INTERRUPTSTATUS] |= 1 << flag;
+    _interruptReleased = false;
+}
+
+uint8_t TSS463_Emulator::peek(uint8_t address)
+{
+    return _registers[address];
+}
+
+void TSS463_Emulator::poke(uint8_t address, uint8_t value)
+{
+    _registers[address] = value;
+}
+
+bool TSS463_Emulator::interrupt_line()
+{
+    return !_interruptReleased && (_registers[INTERRUPTSTATUS] & _registers[INTERRUPTENABLE]) != 0;
+}
+
+bool TSS463_Emulator::is_active()
+{
+    return (_registers[LINESTATUS] & ((1 << EMU_SPG) | (1 << EMU_IDG))) == 0;
+}
+
+uint16_t TSS463_Emulator::channel_identifier(uint8_t channelId)
+{
+    uint8_t base = CHANNEL_ADDR(channelId);
+    return (uint16_t)(_registers[base] << 4) | (_registers[base + 1] >> 4);
+}
+
+uint16_t TSS463_Emulator::channel_mask(uint8_t channelId)
+{
+    uint8_t base = CHANNEL_ADDR(channelId);
+    return (uint16_t)(_registers[base + 6] << 4) | (_registers[base + 7] >> 4);
+}
+
+Id2AndCommandRegister TSS463_Emulator::channel_command(uint8_t channelId)
+{
+    Id2AndCommandRegister command;
+    command.Value = _registers[CHANNEL_ADDR(channelId) + 1];
+    return command;
+}
+
+MessageLengthAndStatusRegister TSS463_Emulator::channel_status(uint8_t channelId)
+{
+    MessageLengthAndStatusRegister status;
+    status.Value = _registers[CHANNEL_ADDR(channelId) + 3];
+    return status;
+}
+
+void TSS463_Emulator::set_channel_status(uint8_t channelId, MessageLengthAndStatusRegister status)
+{
+    _registers[CHANNEL_ADDR(channelId) + 3] = status.Value;
+}
+
+/*
+    Identifier comparison with the mask (1 = compared), no comparison on the command bits except EXT (Page 38)
+*/
+bool TSS463_Emulator::matches(uint8_t channelId, const VanBusFrame& frame)
+{
+    if (channel_command(channelId).data.EXT != frame.Command.data.EXT)
+    {
+        return false;
+    }
+    return ((frame.Identifier ^ channel_identifier(channelId)) & channel_mask(channelId) & 0x0FFF) == 0;
+}
+
+/*
+    Message types which generate a frame (Pages 44-45)
+    ..........................................................
+    : Message type          : RNW : RTR : CHTx : CHRx : Frame :
+    :.......................:.....:.....:......:......:.......:
+    : Transmit              :  0  :  0  :  0   :  x   : data  :
+    : Reply request         :  1  :  1  :  0   :  0   : RTR   :
+    : Deferred reply        :  1  :  0  :  0   :  1   : data  :
+    :.......................:.....:.....:......:......:.......:
+*/
+bool TSS463_Emulator::is_ready_to_transmit(uint8_t channelId)
+{
+    Id2AndCommandRegister command = channel_command(channelId);
+    MessageLengthAndStatusRegister status = channel_status(channelId);
+
+    if (status.data.CHTx)
+    {
+        return false;
+    }
+    if (!command.data.RNW)
+    {
+        return !command.data.RTR;
+    }
+    return command.data.RTR ? !status.data.CHRx : status.data.CHRx;
+}
+
+/*
+    Message types which take a frame of another module (Pages 44-45)
+    Receive (RNW = 0, RTR = 1, CHRx = 0): data frames
+    Reply request and reply request without transmission (RNW = 1, RTR = 1, CHRx = 0): deferred reply frames
+    Reply request detection (RNW = 1, RTR = 0, CHTx = 1, CHRx = 0): reply request frames
+*/
+bool TSS463_Emulator::is_ready_to_receive(uint8_t channelId, const VanBusFrame& frame)
+{
+    Id2AndCommandRegister command = channel_command(channelId);
+    MessageLengthAndStatusRegister status = channel_status(channelId);
+
+    if (status.data.CHRx)
+    {
+        return false;
+    }
+
+    bool isReplyRequest = frame.Command.data.RNW && frame.Command.data.RTR;
+
+    if (!command.data.RNW)
+    {
+        return command.data.RTR && !isReplyRequest;
+    }
+    if (command.data.RTR)
+    {
+        return frame.Command.data.RNW && !frame.Command.data.RTR;
+    }
+    return status.data.CHTx && isReplyRequest;
+}
+
+/*
+    If the message length is zero, the message pointer is a link to the channel holding the buffer (Page 38), only 1 level of link is supported
+*/
+uint8_t TSS463_Emulator::buffer_channel(uint8_t channelId)
+{
+    if (channel_status(channelId).data.M_L == 0)
+    {
+        return _registers[CHANNEL_ADDR(channelId) + 2] & 0x0F;
+    }
+    return channelId;
+}
+
+void TSS463_Emulator::load_data(uint8_t channelId, VanBusFrame* frame)
+{
+    uint8_t bufferChannel = buffer_channel(channelId);
+    uint8_t pointer = _registers[CHANNEL_ADDR(bufferChannel) + 2] & 0x7F;
+    uint8_t length = channel_status(bufferChannel).data.M_L;
+
+    frame->Length = length > 0 ? length - 1 : 0;
+    for (uint8_t i = 0; i < frame->Length; i++)
+    {
+        // the Mailbox RAM area is a circular buffer, the next location after 0xFF is 0x80 (Page 43)
+        frame->Data[i] = _registers[GETMAIL(((pointer + 1 + i) & 0x7F))];
+    }
+}
+
+/*
+    Writes the message status and the data of a received frame into the buffer of the channel (Figure 27), the received identifier into the ID_TAG
+    Returns false if the linked buffer is already occupied (BOC)
+*/
+bool TSS463_Emulator::store_message(uint8_t channelId, const VanBusFrame& frame)
+{
+    uint8_t bufferChannel = buffer_channel(channelId);
+    if (bufferChannel != channelId && channel_status(bufferChannel).data.CHRx)
+    {
+        _registers[LASTERRORSTATUS] = 1 << EMU_BOC;
+        return false;
+    }
+
+    uint8_t pointer = _registers[CHANNEL_ADDR(bufferChannel) + 2] & 0x7F;
+    uint8_t reserved = channel_status(bufferChannel).data.M_L;
+    uint8_t length = frame.Length;
+    if (reserved > 0 && length > reserved - 1)
+    {
+        length = reserved - 1;
+    }
+
+    MessageStatusRegister messageStatus;
+    messageStatus.data.RM_L = frame.Length;
+    messageStatus.data.RRTR = frame.Command.data.RTR;
+    messageStatus.data.RRNW = frame.Command.data.RNW;
+    messageStatus.data.RRAK = frame.Command.data.RAK;
+    _registers[GETMAIL(pointer)] = messageStatus.Value;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        _registers[GETMAIL(((pointer + 1 + i) & 0x7F))] = frame.Data[i];
+    }
+
+    uint8_t base = CHANNEL_ADDR(channelId);
+    _registers[base] = (uint8_t)(frame.Identifier >> 4);
+    _registers[base + 1] = (uint8_t)((frame.Identifier & 0x0F) << 4) | (_registers[base + 1] & 0x0F);
+
+    if (bufferChannel != channelId)
+    {
+        MessageLengthAndStatusRegister linked = channel_status(bufferChannel);
+        linked.data.CHRx = 1;
+        set_channel_status(bufferChannel, linked);
+    }
+
+    return true;
+}
+
+/*
+    Transmit function (Figure 30): the lowest ready channel number is selected and the retry counter is loaded with MR[3:0]
+    The same channel is attempted again after an error until the retries are exceeded or a re-arbitrate command
+*/
+bool TSS463_Emulator::next_frame(VanBusFrame* frame)
+{
+    if (!is_active())
+    {
+        return false;
+    }
+
+    if (_txChannel == EMU_NO_CHANNEL || !is_ready_to_transmit(_txChannel))
+    {
+        _txChannel = EMU_NO_CHANNEL;
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (is_ready_to_transmit(i))
+            {
+                _txChannel = i;
+                _retries = _registers[TRANSMITCONTROL] >> 4;
+                _attempts = 0;
+                break;
+            }
+        }
+    }
+
+    if (_txChannel == EMU_NO_CHANNEL)
+    {
+        _registers[LINESTATUS] &= ~(1 << EMU_TXG);
+        return false;
+    }
+
+    frame->Identifier = channel_identifier(_txChannel);
+    frame->Command = channel_command(_txChannel);
+    if (frame->Command.data.RNW && frame->Command.data.RTR)
+    {
+        frame->Length = 0;
+    }
+    else
+    {
+        load_data(_txChannel, frame);
+    }
+
+    _registers[LINESTATUS] |= 1 << EMU_TXG;
+    _registers[TRANSMITSTATUS] = (uint8_t)(_attempts << 4) | _txChannel;
+
+    return true;
+}
+
+void TSS463_Emulator::frame_sent(uint8_t errors, const VanBusFrame* reply)
+{
+    if (_txChannel == EMU_NO_CHANNEL)
+    {
+        return;
+    }
+
+    uint8_t channelId = _txChannel;
+    MessageLengthAndStatusRegister status = channel_status(channelId);
+    _registers[LASTERRORSTATUS] = errors;
+
+    if (errors != 0)
+    {
+        if (_retries > 0)
+        {
+            _retries--;
+            _attempts++;
+            _registers[TRANSMITSTATUS] = (uint8_t)(_attempts << 4) | channelId;
+            return;
+        }
+
+        // exceeded retry: set TE, set CHER, set CHTx (Figure 25)
+        status.data.CHER = 1;
+        status.data.CHTx = 1;
+        set_channel_status(channelId, status);
+        _registers[LASTMESSAGESTATUS] = (uint8_t)(_attempts << 4) | channelId;
+        set_interrupt(TEE);
+    }
+    else
+    {
+        status.data.CHTx = 1;
+        if (reply != NULL && status.data.M_L > 0 && store_message(channelId, *reply))
+        {
+            status.data.CHRx = 1;
+            set_interrupt(reply->Command.data.RAK ? ROKE : RNOKE);
+        }
+        set_channel_status(channelId, status);
+        _registers[LASTMESSAGESTATUS] = (uint8_t)(_attempts << 4) | channelId;
+        set_interrupt(TOKE);
+    }
+
+    _txChannel = EMU_NO_CHANNEL;
+    _registers[LINESTATUS] &= ~(1 << EMU_TXG);
+}
+
+/*
+    The lowest channel number matching the frame receives it (Page 46)
+*/
+bool TSS463_Emulator::frame_received(const VanBusFrame& frame)
+{
+    if (!is_active())
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (!is_ready_to_receive(i, frame) || !matches(i, frame))
+        {
+            continue;
+        }
+
+        if (!store_message(i, frame))
+        {
+            set_interrupt(REE);
+            return false;
+        }
+
+        MessageLengthAndStatusRegister status = channel_status(i);
+        status.data.CHRx = 1;
+        set_channel_status(i, status);
+
+        _registers[LASTMESSAGESTATUS] = i;
+        _registers[LASTERRORSTATUS] = 0;
+        set_interrupt(frame.Command.data.RAK ? ROKE : RNOKE);
+
+        MessagePointerRegister pointer;
+        pointer.Value = _registers[CHANNEL_ADDR(i) + 2];
+        return frame.Command.data.RAK && !pointer.data.DRAK;
+    }
+
+    return false;
+}
+
+/*
+    Immediate reply message (RNW = 1, RTR = 0, CHTx = 0, CHRx = 0): the data of the buffer is inserted into the reply request frame
+*/
+bool TSS463_Emulator::in_frame_reply(const VanBusFrame& request, VanBusFrame* reply)
+{
+    if (!is_active() || !request.Command.data.RNW || !request.Command.data.RTR)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        Id2AndCommandRegister command = channel_command(i);
+        MessageLengthAndStatusRegister status = channel_status(i);
+        if (!command.data.RNW || command.data.RTR || status.data.CHTx || status.data.CHRx || !matches(i, request))
+        {
+            continue;
+        }
+
+        reply->Identifier = request.Identifier;
+        reply->Command = request.Command;
+        reply->Command.data.RTR = 0;
+        load_data(i, reply);
+
+        status.data.CHTx = 1;
+        status.data.CHRx = 1;
+        set_channel_status(i, status);
+
+        _registers[LASTMESSAGESTATUS] = i;
+        set_interrupt(TOKE);
+        return true;
+    }
+
+    return false;
+}
+
+void TSS463_Emulator::receive_error(uint8_t errors)
+{
+    _registers[LASTERRORSTATUS] = errors;
+    set_interrupt(REE);
+}
+
+uint32_t TSS463_Emulator::spi_frames()
+{
+    return _spiFrames;
+}
+
+uint32_t TSS463_Emulator::spi_bytes()
+{
+    return _spiBytes;
+}
+
+void TSS463_Emulator::clear_counters()
+{
+    _spiFrames = 0;
+    _spiBytes = 0;
+}
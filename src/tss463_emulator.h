@@ -0,0 +1,112 @@
+// tss463_emulator.h
+#pragma once
+
+#ifndef _tss463_emulator_h
+    #define _tss463_emulator_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_registers.h"
+#include "tss463_channel_registers_struct.h"
+#include "tss463_transport.h"
+
+/*
+    A VAN frame as seen by the line interface of the emulated TSS463C
+*/
+typedef struct
+{
+    uint16_t Identifier;
+    // COM field (EXT, RAK, RNW, RTR), ID holds the 4 low bits of the identifier like in the ID_TAG / CMD register
+    Id2AndCommandRegister Command;
+    uint8_t Length;
+    uint8_t Data[TSS463_MAX_DATA_LENGTH];
+}VanBusFrame;
+
+/*
+    Register level model of the TSS463C behind the TSS463_Transport interface, so the library can run without the chip (host tests, benchmarks)
+    SPI side: address/control handshake (0xAA, 0x55), address auto-increment (stops at 0xFF), control and status registers, 14 channel register sets, 128 bytes mailbox
+    Line side: the channel state machines of the message types (Pages 44-45), retries, interrupt flags and the INT pin
+    The line side is driven by the caller: next_frame/frame_sent for the frames of this node, frame_received/in_frame_reply for the frames of the other modules
+    Not modelled: bit timing, the diagnosis system (Sa, Sb, Sc), the CRC bytes written after DATAn when the reserved length is larger than the frame
+*/
+class TSS463_Emulator : public TSS463_Transport
+{
+private:
+    uint8_t _registers[256];
+
+    bool _selected = false;
+    uint8_t _byteIndex = 0;
+    uint8_t _address = 0;
+    uint8_t _control = 0;
+
+    // INT pin released by an access to the interrupt registers until the next event
+    bool _interruptReleased = false;
+
+    uint8_t _txChannel;
+    uint8_t _retries = 0;
+    uint8_t _attempts = 0;
+
+    uint32_t _spiFrames = 0;
+    uint32_t _spiBytes = 0;
+
+    uint8_t read_register(uint8_t address);
+    void write_register(uint8_t address, uint8_t value);
+    void command(uint8_t value);
+    void set_interrupt(uint8_t flag);
+
+    uint16_t channel_identifier(uint8_t channelId);
+    uint16_t channel_mask(uint8_t channelId);
+    Id2AndCommandRegister channel_command(uint8_t channelId);
+    MessageLengthAndStatusRegister channel_status(uint8_t channelId);
+    void set_channel_status(uint8_t channelId, MessageLengthAndStatusRegister status);
+    bool matches(uint8_t channelId, const VanBusFrame& frame);
+    bool is_ready_to_transmit(uint8_t channelId);
+    bool is_ready_to_receive(uint8_t channelId, const VanBusFrame& frame);
+    uint8_t buffer_channel(uint8_t channelId);
+    void load_data(uint8_t channelId, VanBusFrame* frame);
+    bool store_message(uint8_t channelId, const VanBusFrame& frame);
+
+public:
+    TSS463_Emulator();
+
+    // Hardware reset (RESET pin)
+    void reset();
+
+    void select();
+    uint8_t transfer(uint8_t data);
+    void unselect();
+
+    // Register map access without SPI, for checks
+    uint8_t peek(uint8_t address);
+    void poke(uint8_t address, uint8_t value);
+
+    // True when the INT pin is low (active)
+    bool interrupt_line();
+    // True when the circuit is neither idle nor sleeping (after the ACTI command)
+    bool is_active();
+
+    // Frame this node would transmit next (lowest ready channel), false if nothing to transmit
+    bool next_frame(VanBusFrame* frame);
+    // Result of the attempt started by next_frame: errors as in the Last Error Status Register (0 = success), reply = in-frame reply of another module or NULL
+    void frame_sent(uint8_t errors, const VanBusFrame* reply);
+    // Frame transmitted by another module, returns true if this node acknowledges it
+    bool frame_received(const VanBusFrame& frame);
+    // Reply request frame of another module, returns true and the reply if a channel of this node replies in-frame
+    bool in_frame_reply(const VanBusFrame& request, VanBusFrame* reply);
+    // Erroneous frame seen on the line
+    void receive_error(uint8_t errors);
+
+    uint32_t spi_frames();
+    uint32_t spi_bytes();
+    void clear_counters();
+};
+
+#endif
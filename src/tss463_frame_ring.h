@@ -0,0 +1,193 @@
+// tss463_frame_ring.h
+#pragma once
+
+#ifndef _tss463_frame_ring_h
+    #define _tss463_frame_ring_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_channel_registers_struct.h"
+
+/*
+    Maximum number of data bytes stored in a frame record. A channel can reserve at most 30 data bytes (M_L[4:0] = 31),
+    define it to a lower value before including the library to save RAM on AVR if your messages are shorter
+*/
+#ifndef TSS463_FRAME_DATA_SIZE
+    #define TSS463_FRAME_DATA_SIZE 30
+#endif
+
+typedef struct
+{
+    uint32_t Timestamp;
+    uint16_t Identifier;
+    // received command bits (RRAK, RRNW, RRTR) and the received length
+    MessageStatusRegister Status;
+    uint8_t Channel;
+    uint8_t Length;
+    uint8_t Data[TSS463_FRAME_DATA_SIZE];
+}VanFrame;
+
+/*
+    Lock-free single-producer/single-consumer ring of received frames
+    The producer is the receive path of the library (loop, ISR service or a dedicated task), the consumer is the application.
+    Each index is written by only one side, so no locking is needed. The capacity must be a power of two, one slot is kept empty.
+*/
+class TSS463_FrameRing
+{
+private:
+    VanFrame* _frames;
+    uint8_t _mask;
+    uint8_t _head = 0; // written by the producer
+    uint8_t _tail = 0; // written by the consumer
+    // frames which push could not store and channels whose message was left in the mailbox by a full ring, written by the producer
+    volatile uint16_t _overflows = 0;
+    volatile uint16_t _blocked = 0;
+
+    static uint8_t load(const uint8_t* index, int order)
+    {
+        return __atomic_load_n(index, order);
+    }
+
+    static void store(uint8_t* index, uint8_t value)
+    {
+        __atomic_store_n(index, value, __ATOMIC_RELEASE);
+    }
+
+    // a 16 bit counter is read in two instructions on AVR, the producer may be an ISR
+    static uint16_t load_counter(const volatile uint16_t* counter)
+    {
+#if defined(ARDUINO_ARCH_AVR)
+        uint8_t sreg = SREG;
+        cli();
+        uint16_t value = *counter;
+        SREG = sreg;
+        return value;
+#else
+        return *counter;
+#endif
+    }
+
+protected:
+    TSS463_FrameRing(VanFrame* frames, uint8_t capacity)
+        : _frames(frames), _mask(capacity - 1)
+    {
+    }
+
+public:
+    /*
+        Producer: returns the slot to be filled or NULL if the ring is full
+    */
+    VanFrame* reserve()
+    {
+        uint8_t head = load(&_head, __ATOMIC_RELAXED);
+        uint8_t next = (head + 1) & _mask;
+        if (next == load(&_tail, __ATOMIC_ACQUIRE))
+        {
+            return NULL;
+        }
+        return &_frames[head];
+    }
+
+    /*
+        Producer: publishes the slot returned by reserve()
+    */
+    void commit()
+    {
+        uint8_t head = load(&_head, __ATOMIC_RELAXED);
+        store(&_head, (head + 1) & _mask);
+    }
+
+    /*
+        Producer: copies a frame into the ring, returns false if it was full (the frame is counted by overflows)
+    */
+    bool push(const VanFrame& frame)
+    {
+        VanFrame* slot = reserve();
+        if (slot == NULL)
+        {
+            _overflows = _overflows + 1;
+            return false;
+        }
+        *slot = frame;
+        commit();
+        return true;
+    }
+
+    /*
+        Consumer: copies the oldest frame into the given variable without blocking, returns false if the ring is empty
+    */
+    bool pop(VanFrame& frame)
+    {
+        uint8_t tail = load(&_tail, __ATOMIC_RELAXED);
+        if (tail == load(&_head, __ATOMIC_ACQUIRE))
+        {
+            return false;
+        }
+        frame = _frames[tail];
+        store(&_tail, (tail + 1) & _mask);
+        return true;
+    }
+
+    uint8_t count()
+    {
+        return (load(&_head, __ATOMIC_ACQUIRE) - load(&_tail, __ATOMIC_ACQUIRE)) & _mask;
+    }
+
+    uint8_t capacity()
+    {
+        return _mask;
+    }
+
+    /*
+        Producer: counts a channel blocked by the full ring, once until its message is stored
+    */
+    void count_blocked()
+    {
+        _blocked = _blocked + 1;
+    }
+
+    /*
+        Number of times a channel kept its message in the mailbox because the ring was full. Meanwhile the channel does not
+        receive: the frames which follow on the bus for it are lost, the TSS463C does not count them
+    */
+    uint16_t blocked()
+    {
+        return load_counter(&_blocked);
+    }
+
+    /*
+        Number of frames which push could not store because the ring was full
+    */
+    uint16_t overflows()
+    {
+        return load_counter(&_overflows);
+    }
+};
+
+/*
+    Frame ring with statically allocated storage, for example: TSS463_FrameRingBuffer<16> ring;
+*/
+template <uint8_t Capacity>
+class TSS463_FrameRingBuffer : public TSS463_FrameRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    VanFrame _storage[Capacity];
+
+public:
+    TSS463_FrameRingBuffer()
+        : TSS463_FrameRing(_storage, Capacity)
+    {
+    }
+};
+
+#endif
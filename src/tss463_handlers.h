@@ -0,0 +1,169 @@
+// tss463_handlers.h
+#pragma once
+
+#ifndef _tss463_handlers_h
+    #define _tss463_handlers_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_channel_registers_struct.h"
+#include "tss463_frame_ring.h"
+#include "tss463_identifier_demux.h"
+
+/*
+    A received message as given to the handlers, the data is not copied: it points into the buffer the message was read into
+    (the stack of process() or the frame of the ring), so it is only valid during the call of the handler
+*/
+typedef struct
+{
+    uint16_t Identifier;
+    uint8_t Channel;
+    // received command bits (RRAK, RRNW, RRTR) and the received length
+    MessageStatusRegister Status;
+    const uint8_t* Data;
+    uint8_t Length;
+    // when the message was seen by the library (see TSS463_VAN::completion_time)
+    uint32_t Timestamp;
+}VanMessageView;
+
+typedef void (*TSS463_MessageHandler)(const VanMessageView& message, void* context);
+
+typedef struct
+{
+    TSS463_MessageHandler Handler;
+    void* Context;
+}TSS463_HandlerEntry;
+
+/*
+    Handlers of the received messages by identifier plus a catch-all for the other identifiers
+    The identifier is looked up by a TSS463_IdentifierDemux, so the dispatch takes the same time for any number of handlers.
+    No memory is allocated, the storage is given by TSS463_HandlerTable.
+*/
+class TSS463_Handlers
+{
+private:
+    TSS463_IdentifierDemux* _demux;
+    TSS463_HandlerEntry* _entries;
+    uint8_t _count = 0;
+    TSS463_HandlerEntry _catchAll = { NULL, NULL };
+    uint32_t _unhandled = 0;
+
+protected:
+    TSS463_Handlers(TSS463_IdentifierDemux* demux, TSS463_HandlerEntry* entries)
+        : _demux(demux), _entries(entries)
+    {
+    }
+
+public:
+    /*
+        Registers the handler of an identifier (replaces the previous one), returns false if the table is full
+    */
+    bool on(uint16_t identifier, TSS463_MessageHandler handler, void* context = NULL)
+    {
+        uint8_t slot = _demux->find(identifier);
+        if (slot == TSS463_NO_SLOT)
+        {
+            if (!_demux->add(identifier, _count))
+            {
+                return false;
+            }
+            slot = _count++;
+        }
+        _entries[slot].Handler = handler;
+        _entries[slot].Context = context;
+        return true;
+    }
+
+    /*
+        Registers the handler of the messages without their own handler, NULL removes it
+    */
+    void on_any(TSS463_MessageHandler handler, void* context = NULL)
+    {
+        _catchAll.Handler = handler;
+        _catchAll.Context = context;
+    }
+
+    /*
+        Calls the handler of the message, returns false if there is no handler for it (counted by unhandled)
+    */
+    bool dispatch(const VanMessageView& message)
+    {
+        uint8_t slot = _demux->find(message.Identifier);
+        const TSS463_HandlerEntry* entry = slot != TSS463_NO_SLOT ? &_entries[slot] : &_catchAll;
+
+        if (entry->Handler == NULL)
+        {
+            _unhandled++;
+            return false;
+        }
+        entry->Handler(message, entry->Context);
+        return true;
+    }
+
+    /*
+        Dispatches a frame taken out of the frame ring
+    */
+    bool dispatch(const VanFrame& frame)
+    {
+        VanMessageView message;
+        message.Identifier = frame.Identifier;
+        message.Channel = frame.Channel;
+        message.Status = frame.Status;
+        message.Data = frame.Data;
+        message.Length = frame.Length;
+        message.Timestamp = frame.Timestamp;
+        return dispatch(message);
+    }
+
+    uint32_t unhandled()
+    {
+        return _unhandled;
+    }
+};
+
+/*
+    Handler table with statically allocated storage for the given number of identifiers, for example: TSS463_HandlerTable<16> handlers;
+    It uses 576 bytes of RAM for the identifier lookup plus a byte and two pointers per identifier
+*/
+template <uint8_t Capacity>
+class TSS463_HandlerTable : public TSS463_Handlers
+{
+private:
+    TSS463_IdentifierDemuxTable<Capacity> _demuxStorage;
+    TSS463_HandlerEntry _storage[Capacity];
+
+public:
+    TSS463_HandlerTable()
+        : TSS463_Handlers(&_demuxStorage, _storage)
+    {
+    }
+};
+
+/*
+    Handler table for a fixed set of identifiers, the identifier lookup is generated at compile time and kept in flash on AVR,
+    so it takes two pointers per identifier of RAM. on fails for the identifiers which are not listed.
+    For example: TSS463_StaticHandlerTable<0x4FC, 0x8A4, 0x4D4> handlers;
+*/
+template <uint16_t... Identifiers>
+class TSS463_StaticHandlerTable : public TSS463_Handlers
+{
+private:
+    TSS463_StaticIdentifierDemux<Identifiers...> _demuxStorage;
+    TSS463_HandlerEntry _storage[sizeof...(Identifiers)];
+
+public:
+    TSS463_StaticHandlerTable()
+        : TSS463_Handlers(&_demuxStorage, _storage), _storage()
+    {
+    }
+};
+
+#endif
@@ -0,0 +1,342 @@
+// tss463_identifier_demux.h
+#pragma once
+
+#ifndef _tss463_identifier_demux_h
+    #define _tss463_identifier_demux_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+        #include <string.h>
+    #endif
+
+    // the tables generated at compile time stay in flash on AVR
+    #if defined(__AVR__)
+        #include <avr/pgmspace.h>
+        #define TSS463_PROGMEM PROGMEM
+        #define TSS463_READ_CONSTANT(address) pgm_read_byte(address)
+    #else
+        #define TSS463_PROGMEM
+        #define TSS463_READ_CONSTANT(address) (*(address))
+    #endif
+
+#define TSS463_NO_SLOT 0xFF
+#define TSS463_IDENTIFIER_COUNT 4096
+
+/*
+    Identifier of a message from the first two bytes of the buffer of read_message (ID_TAG, ID_TAG/CMD)
+*/
+inline uint16_t tss463_identifier(const uint8_t idBytes[])
+{
+    return ((uint16_t)idBytes[0] << 4) | (idBytes[1] >> 4);
+}
+
+/*
+    Maps the 12 bit identifiers to slots (for example the index of a handler) in constant time
+    One bit per identifier (512 bytes) tells whether an identifier is known. The number of known identifiers before every block of
+    64 identifiers (64 bytes) plus the set bits before the identifier within its block (at most 8 bytes) give its rank, which
+    indexes the slots kept in the order of the identifiers.
+    The tables are either in RAM and filled by add at startup (TSS463_IdentifierDemuxTable, adding an identifier takes linear time)
+    or generated at compile time for a fixed set of identifiers (TSS463_StaticIdentifierDemux, in flash on AVR).
+*/
+class TSS463_IdentifierDemux
+{
+private:
+    // writable unless _constant
+    const uint8_t* _bits;
+    const uint8_t* _blockRank;
+    const uint8_t* _slots;
+    uint8_t _capacity;
+    uint8_t _count;
+    bool _constant;
+
+    uint8_t read(const uint8_t* table, uint16_t index) const
+    {
+        return _constant ? TSS463_READ_CONSTANT(&table[index]) : table[index];
+    }
+
+    // number of known identifiers below the identifier, _count for the identifiers over 0xFFF
+    uint8_t rank(uint16_t identifier) const
+    {
+        if (identifier >= TSS463_IDENTIFIER_COUNT)
+        {
+            return _count;
+        }
+
+        uint8_t block = identifier >> 6;
+        uint16_t byte = identifier >> 3;
+        uint8_t result = read(_blockRank, block);
+
+        for (uint16_t i = block * 8; i < byte; i++)
+        {
+            result += __builtin_popcount(read(_bits, i));
+        }
+        return result + __builtin_popcount(read(_bits, byte) & ((1 << (identifier & 7)) - 1));
+    }
+
+protected:
+    // tables in RAM, cleared by the derived class once its storage is constructed
+    TSS463_IdentifierDemux(uint8_t* bits, uint8_t* blockRank, uint8_t* slots, uint8_t capacity)
+        : _bits(bits), _blockRank(blockRank), _slots(slots), _capacity(capacity), _count(0), _constant(false)
+    {
+    }
+
+    // tables generated at compile time, read with TSS463_READ_CONSTANT
+    TSS463_IdentifierDemux(const uint8_t* bits, const uint8_t* blockRank, const uint8_t* slots, uint8_t count, bool)
+        : _bits(bits), _blockRank(blockRank), _slots(slots), _capacity(count), _count(count), _constant(true)
+    {
+    }
+
+public:
+    /*
+        Adds an identifier with its slot, returns false if the identifier is already known, it is over 0xFFF, the table is full
+        or it is generated at compile time
+    */
+    bool add(uint16_t identifier, uint8_t slot)
+    {
+        if (identifier >= TSS463_IDENTIFIER_COUNT || _constant || _count >= _capacity || contains(identifier))
+        {
+            return false;
+        }
+
+        uint8_t* bits = const_cast<uint8_t*>(_bits);
+        uint8_t* blockRank = const_cast<uint8_t*>(_blockRank);
+        uint8_t* slots = const_cast<uint8_t*>(_slots);
+
+        uint8_t position = rank(identifier);
+        memmove(&slots[position + 1], &slots[position], _count - position);
+        slots[position] = slot;
+
+        bits[identifier >> 3] |= 1 << (identifier & 7);
+        for (uint8_t block = (identifier >> 6) + 1; block < TSS463_IDENTIFIER_COUNT / 64; block++)
+        {
+            blockRank[block]++;
+        }
+        _count++;
+        return true;
+    }
+
+    bool contains(uint16_t identifier) const
+    {
+        return identifier < TSS463_IDENTIFIER_COUNT && ((read(_bits, identifier >> 3) >> (identifier & 7)) & 1);
+    }
+
+    /*
+        Returns the slot of the identifier or TSS463_NO_SLOT if it is not known
+    */
+    uint8_t find(uint16_t identifier) const
+    {
+        if (!contains(identifier))
+        {
+            return TSS463_NO_SLOT;
+        }
+        return read(_slots, rank(identifier));
+    }
+
+    /*
+        Removes every identifier, a table generated at compile time is kept
+    */
+    void clear()
+    {
+        if (_constant)
+        {
+            return;
+        }
+        memset(const_cast<uint8_t*>(_bits), 0, TSS463_IDENTIFIER_COUNT / 8);
+        memset(const_cast<uint8_t*>(_blockRank), 0, TSS463_IDENTIFIER_COUNT / 64);
+        _count = 0;
+    }
+
+    uint8_t count() const
+    {
+        return _count;
+    }
+
+    uint8_t capacity() const
+    {
+        return _capacity;
+    }
+};
+
+/*
+    Identifier demultiplexer with its tables in RAM, filled by add, for example: TSS463_IdentifierDemuxTable<64> demux;
+    It takes 576 bytes plus one byte per identifier
+*/
+template <uint8_t Capacity>
+class TSS463_IdentifierDemuxTable : public TSS463_IdentifierDemux
+{
+    static_assert(Capacity >= 1 && Capacity < TSS463_NO_SLOT, "Capacity must be between 1 and 254");
+
+private:
+    uint8_t _bitStorage[TSS463_IDENTIFIER_COUNT / 8];
+    uint8_t _blockRankStorage[TSS463_IDENTIFIER_COUNT / 64];
+    uint8_t _storage[Capacity];
+
+public:
+    TSS463_IdentifierDemuxTable()
+        : TSS463_IdentifierDemux(_bitStorage, _blockRankStorage, _storage, Capacity)
+    {
+        clear();
+    }
+};
+
+// list of indices 0 .. N - 1 to expand the tables generated at compile time, built in log(N) steps
+template <uint16_t... I>
+struct TSS463_Indices
+{
+};
+
+template <class First, class Second>
+struct TSS463_JoinIndices;
+
+template <uint16_t... First, uint16_t... Second>
+struct TSS463_JoinIndices<TSS463_Indices<First...>, TSS463_Indices<Second...> >
+{
+    typedef TSS463_Indices<First..., (uint16_t)(sizeof...(First) + Second)...> Type;
+};
+
+template <uint16_t N>
+struct TSS463_MakeIndices
+{
+    typedef typename TSS463_JoinIndices<typename TSS463_MakeIndices<N / 2>::Type, typename TSS463_MakeIndices<N - N / 2>::Type>::Type Type;
+};
+
+template <>
+struct TSS463_MakeIndices<0>
+{
+    typedef TSS463_Indices<> Type;
+};
+
+template <>
+struct TSS463_MakeIndices<1>
+{
+    typedef TSS463_Indices<0> Type;
+};
+
+/*
+    Bytes of the tables of a fixed set of identifiers, computed by the compiler (C++11 constexpr)
+    The slot of an identifier is its position in the list
+*/
+template <uint16_t... Identifiers>
+struct TSS463_IdentifierList
+{
+    static constexpr uint8_t Count = sizeof...(Identifiers);
+
+    static constexpr uint8_t bits(uint16_t byte)
+    {
+        return bits_of(byte, Identifiers...);
+    }
+
+    static constexpr uint8_t below(uint16_t identifier)
+    {
+        return below_of(identifier, Identifiers...);
+    }
+
+    static constexpr uint8_t slot(uint8_t rank)
+    {
+        return slot_of(rank, 0, Identifiers...);
+    }
+
+    // every identifier is at most 0xFFF and has its own rank, so no identifier is listed twice
+    static constexpr bool valid(uint8_t rank = 0)
+    {
+        return rank >= Count ? all_in_range(Identifiers...) : slot(rank) != TSS463_NO_SLOT && valid(rank + 1);
+    }
+
+private:
+    static constexpr uint8_t bits_of(uint16_t)
+    {
+        return 0;
+    }
+
+    template <typename... Rest>
+    static constexpr uint8_t bits_of(uint16_t byte, uint16_t identifier, Rest... rest)
+    {
+        return ((identifier >> 3) == byte ? 1 << (identifier & 7) : 0) | bits_of(byte, rest...);
+    }
+
+    static constexpr uint8_t below_of(uint16_t)
+    {
+        return 0;
+    }
+
+    template <typename... Rest>
+    static constexpr uint8_t below_of(uint16_t limit, uint16_t identifier, Rest... rest)
+    {
+        return (identifier < limit ? 1 : 0) + below_of(limit, rest...);
+    }
+
+    static constexpr uint8_t slot_of(uint8_t, uint8_t)
+    {
+        return TSS463_NO_SLOT;
+    }
+
+    template <typename... Rest>
+    static constexpr uint8_t slot_of(uint8_t rank, uint8_t position, uint16_t identifier, Rest... rest)
+    {
+        return below(identifier) == rank ? position : slot_of(rank, position + 1, rest...);
+    }
+
+    static constexpr bool all_in_range()
+    {
+        return true;
+    }
+
+    template <typename... Rest>
+    static constexpr bool all_in_range(uint16_t identifier, Rest... rest)
+    {
+        return identifier < TSS463_IDENTIFIER_COUNT && all_in_range(rest...);
+    }
+};
+
+template <class List, class Bytes, class Blocks, class Ranks>
+struct TSS463_IdentifierTables;
+
+template <class List, uint16_t... Byte, uint16_t... Block, uint16_t... Rank>
+struct TSS463_IdentifierTables<List, TSS463_Indices<Byte...>, TSS463_Indices<Block...>, TSS463_Indices<Rank...> >
+{
+    static const uint8_t Bits[sizeof...(Byte)];
+    static const uint8_t BlockRank[sizeof...(Block)];
+    static const uint8_t Slots[sizeof...(Rank)];
+};
+
+template <class List, uint16_t... Byte, uint16_t... Block, uint16_t... Rank>
+const uint8_t TSS463_IdentifierTables<List, TSS463_Indices<Byte...>, TSS463_Indices<Block...>, TSS463_Indices<Rank...> >::Bits[sizeof...(Byte)]
+    TSS463_PROGMEM = { List::bits(Byte)... };
+
+template <class List, uint16_t... Byte, uint16_t... Block, uint16_t... Rank>
+const uint8_t TSS463_IdentifierTables<List, TSS463_Indices<Byte...>, TSS463_Indices<Block...>, TSS463_Indices<Rank...> >::BlockRank[sizeof...(Block)]
+    TSS463_PROGMEM = { List::below(Block * 64)... };
+
+template <class List, uint16_t... Byte, uint16_t... Block, uint16_t... Rank>
+const uint8_t TSS463_IdentifierTables<List, TSS463_Indices<Byte...>, TSS463_Indices<Block...>, TSS463_Indices<Rank...> >::Slots[sizeof...(Rank)]
+    TSS463_PROGMEM = { List::slot(Rank)... };
+
+/*
+    Identifier demultiplexer for a fixed set of identifiers, its tables are generated by the compiler and kept in flash on AVR,
+    so it takes a few bytes of RAM only. The slot of an identifier is its position in the list, add always fails.
+    For example: TSS463_StaticIdentifierDemux<0x4FC, 0x8A4, 0x4D4> demux; (demux.find(0x8A4) is 1)
+*/
+template <uint16_t... Identifiers>
+class TSS463_StaticIdentifierDemux : public TSS463_IdentifierDemux
+{
+    typedef TSS463_IdentifierList<Identifiers...> List;
+    typedef TSS463_IdentifierTables<List, typename TSS463_MakeIndices<TSS463_IDENTIFIER_COUNT / 8>::Type,
+        typename TSS463_MakeIndices<TSS463_IDENTIFIER_COUNT / 64>::Type, typename TSS463_MakeIndices<sizeof...(Identifiers)>::Type> Tables;
+
+    static_assert(sizeof...(Identifiers) >= 1 && sizeof...(Identifiers) < TSS463_NO_SLOT, "Between 1 and 254 identifiers");
+    static_assert(List::valid(), "Identifiers must be at most 0xFFF and listed once");
+
+public:
+    TSS463_StaticIdentifierDemux()
+        : TSS463_IdentifierDemux(Tables::Bits, Tables::BlockRank, Tables::Slots, sizeof...(Identifiers), true)
+    {
+    }
+};
+
+#endif
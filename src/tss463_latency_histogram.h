@@ -0,0 +1,175 @@
+// tss463_latency_histogram.h
+#pragma once
+
+#ifndef _tss463_latency_histogram_h
+    #define _tss463_latency_histogram_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+        #include <string.h>
+    #endif
+
+/*
+    Histogram of latencies in microseconds with buckets of a fixed width, the last bucket takes every latency above the others
+    No memory is allocated, the storage is given by TSS463_LatencyHistogramTable. Adding a latency takes constant time.
+*/
+class TSS463_LatencyHistogram
+{
+private:
+    uint32_t* _counts;
+    uint8_t _buckets;
+    uint32_t _bucketUs;
+    uint32_t _count = 0;
+    uint32_t _minUs = 0;
+    uint32_t _maxUs = 0;
+
+protected:
+    TSS463_LatencyHistogram(uint32_t* counts, uint8_t buckets, uint32_t bucketUs)
+        : _counts(counts), _buckets(buckets), _bucketUs(bucketUs)
+    {
+        clear();
+    }
+
+public:
+    void add(uint32_t latencyUs)
+    {
+        uint32_t bucket = latencyUs / _bucketUs;
+        _counts[bucket < _buckets ? bucket : _buckets - 1]++;
+
+        if (_count == 0 || latencyUs < _minUs)
+        {
+            _minUs = latencyUs;
+        }
+        if (latencyUs > _maxUs)
+        {
+            _maxUs = latencyUs;
+        }
+        _count++;
+    }
+
+    /*
+        Returns the upper edge of the bucket of the given percentile (for example 99), the largest latency if it is in the last bucket
+    */
+    uint32_t percentile_us(uint8_t percent) const
+    {
+        if (_count == 0)
+        {
+            return 0;
+        }
+
+        uint32_t rank = (uint32_t)(((uint64_t)_count * percent + 99) / 100);
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < _buckets - 1; i++)
+        {
+            seen += _counts[i];
+            if (seen >= rank)
+            {
+                uint32_t edge = (i + 1) * _bucketUs;
+                return edge < _maxUs ? edge : _maxUs;
+            }
+        }
+        return _maxUs;
+    }
+
+    uint32_t count() const
+    {
+        return _count;
+    }
+
+    uint32_t min_us() const
+    {
+        return _minUs;
+    }
+
+    uint32_t max_us() const
+    {
+        return _maxUs;
+    }
+
+    uint8_t buckets() const
+    {
+        return _buckets;
+    }
+
+    uint32_t bucket_us() const
+    {
+        return _bucketUs;
+    }
+
+    // Number of latencies from bucket * bucket_us up to the next bucket
+    uint32_t bucket_count(uint8_t bucket) const
+    {
+        return bucket < _buckets ? _counts[bucket] : 0;
+    }
+
+    void clear()
+    {
+        memset(_counts, 0, _buckets * sizeof(uint32_t));
+        _count = 0;
+        _minUs = 0;
+        _maxUs = 0;
+    }
+
+#if defined(ARDUINO)
+    /*
+        Prints the summary and the non empty buckets on one line, for example:
+        n=120 min=812 p50=1000 p90=1250 p99=2000 max=2140 us, 750:3 1000:64 1250:41 1500:10 1750:1 2000:1
+        Every bucket is given by its lower edge in microseconds
+    */
+    void print(Print& out) const
+    {
+        out.print("n=");
+        out.print(_count);
+        out.print(" min=");
+        out.print(_minUs);
+        out.print(" p50=");
+        out.print(percentile_us(50));
+        out.print(" p90=");
+        out.print(percentile_us(90));
+        out.print(" p99=");
+        out.print(percentile_us(99));
+        out.print(" max=");
+        out.print(_maxUs);
+        out.print(" us,");
+        for (uint8_t i = 0; i < _buckets; i++)
+        {
+            if (_counts[i] == 0)
+            {
+                continue;
+            }
+            out.print(' ');
+            out.print(i * _bucketUs);
+            out.print(':');
+            out.print(_counts[i]);
+        }
+        out.println();
+    }
+#endif
+};
+
+/*
+    Latency histogram with statically allocated storage, for example: TSS463_LatencyHistogramTable<40, 250> replies; (0 - 10 ms by 250 us)
+*/
+template <uint8_t Buckets, uint32_t BucketUs>
+class TSS463_LatencyHistogramTable : public TSS463_LatencyHistogram
+{
+    static_assert(Buckets >= 2, "At least two buckets are needed");
+    static_assert(BucketUs >= 1, "The bucket width must be at least 1 us");
+
+private:
+    uint32_t _storage[Buckets];
+
+public:
+    TSS463_LatencyHistogramTable()
+        : TSS463_LatencyHistogram(_storage, Buckets, BucketUs)
+    {
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+// tss463_message_descriptor.h
+#pragma once
+
+#ifndef _tss463_message_descriptor_h
+    #define _tss463_message_descriptor_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_registers.h"
+
+// Identifier mask of the channels set up without an explicit mask: the bits of ID[11:4] which are set in the identifier are compared
+#define TSS463_MASK_FROM_IDENTIFIER 0xFFFF
+
+/*
+    A VAN frame carries at most 28 data bytes, the limit of the messages sent by a channel (transmit, immediate and deferred reply).
+    A receiving channel can reserve up to TSS463_MAX_DATA_LENGTH (30) bytes: the TSS463C writes the FCS after the data when the reserved
+    length is larger than the frame
+*/
+#define VAN_MAX_FRAME_DATA_LENGTH 28
+
+/*
+    Message types of a channel (Page 44-45)
+    ...........................................................................
+    : Mode                                    : RNW : RTR : CHTx : CHRx : Ack  :
+    :.........................................:.....:.....:......:......:......:
+    : VAN_MODE_TRANSMIT                       :  0  :  0  :  0   :  0   : RAK  :
+    : VAN_MODE_RECEIVE                        :  0  :  1  :  0   :  0   : DRAK :
+    : VAN_MODE_REPLY_REQUEST                  :  1  :  1  :  0   :  0   : RAK  :
+    : VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION  :  1  :  1  :  0   :  0   :  -   :
+    : VAN_MODE_IMMEDIATE_REPLY                :  1  :  0  :  0   :  0   :  -   :
+    : VAN_MODE_DEFERRED_REPLY                 :  1  :  0  :  0   :  1   : DRAK :
+    : VAN_MODE_REPLY_REQUEST_DETECTION        :  1  :  0  :  1   :  0   :  -   :
+    :.........................................:.....:.....:......:......:......:
+*/
+enum VAN_MESSAGE_MODE {
+    VAN_MODE_TRANSMIT,
+    VAN_MODE_RECEIVE,
+    VAN_MODE_REPLY_REQUEST,
+    VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION,
+    VAN_MODE_IMMEDIATE_REPLY,
+    VAN_MODE_DEFERRED_REPLY,
+    VAN_MODE_REPLY_REQUEST_DETECTION,
+};
+
+/*
+    Register values of a channel which do not depend on where its buffer is in the Message DATA RAM
+    The message pointer holds only the DRAK bit, M_P is added when the channel is set up
+*/
+typedef struct
+{
+    uint16_t Identifier;
+    uint16_t IdentifierMask;
+    uint8_t Length;
+    uint8_t Id1;
+    uint8_t Id2AndCommand;
+    uint8_t MessagePointer;
+    uint8_t LengthAndStatus;
+    // the data of the message is written into the buffer at setup (transmit, immediate and deferred reply)
+    bool HasData;
+}VanMessageDescriptor;
+
+constexpr bool tss463_mode_has_data(VAN_MESSAGE_MODE mode)
+{
+    return mode == VAN_MODE_TRANSMIT || mode == VAN_MODE_IMMEDIATE_REPLY || mode == VAN_MODE_DEFERRED_REPLY;
+}
+
+// ack: the RAK bit of the frames sent by the channel
+constexpr bool tss463_mode_uses_rak(VAN_MESSAGE_MODE mode)
+{
+    return mode == VAN_MODE_TRANSMIT || mode == VAN_MODE_REPLY_REQUEST;
+}
+
+// ack: the inverted DRAK bit, whether the channel acknowledges the frames it receives
+constexpr bool tss463_mode_uses_drak(VAN_MESSAGE_MODE mode)
+{
+    return mode == VAN_MODE_RECEIVE || mode == VAN_MODE_DEFERRED_REPLY;
+}
+
+// EXT (bit 3), RAK (bit 2), RNW (bit 1), RTR (bit 0) of the ID_TAG / CMD register (Page 38)
+constexpr uint8_t tss463_mode_command(VAN_MESSAGE_MODE mode, uint8_t ack)
+{
+    return (1 << 3)
+        | ((tss463_mode_uses_rak(mode) && ack) ? (1 << 2) : 0)
+        | ((mode == VAN_MODE_TRANSMIT || mode == VAN_MODE_RECEIVE) ? 0 : (1 << 1))
+        | ((mode == VAN_MODE_RECEIVE || mode == VAN_MODE_REPLY_REQUEST || mode == VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION) ? 1 : 0);
+}
+
+// DRAK (bit 7) of the MESS_PTR register (Page 38)
+constexpr uint8_t tss463_mode_pointer(VAN_MESSAGE_MODE mode, uint8_t ack)
+{
+    return (tss463_mode_uses_drak(mode) ? !ack : (mode == VAN_MODE_REPLY_REQUEST || mode == VAN_MODE_REPLY_REQUEST_NO_TRANSMISSION || mode == VAN_MODE_REPLY_REQUEST_DETECTION)) ? (1 << 7) : 0;
+}
+
+// CHTx (bit 1), CHRx (bit 0) of the MESS_L / STA register (Page 39)
+constexpr uint8_t tss463_mode_status(VAN_MESSAGE_MODE mode)
+{
+    return mode == VAN_MODE_DEFERRED_REPLY ? 1 : (mode == VAN_MODE_REPLY_REQUEST_DETECTION ? (1 << 1) : 0);
+}
+
+constexpr VanMessageDescriptor tss463_message_descriptor(uint16_t identifier, VAN_MESSAGE_MODE mode, uint8_t length, uint8_t ack, uint16_t identifierMask)
+{
+    return VanMessageDescriptor{
+        identifier,
+        identifierMask,
+        length,
+        (uint8_t)(identifier >> 4),
+        (uint8_t)(((identifier & 0x0F) << 4) | tss463_mode_command(mode, ack)),
+        tss463_mode_pointer(mode, ack),
+        (uint8_t)(((length + 1) << 3) | tss463_mode_status(mode)),
+        tss463_mode_has_data(mode)
+    };
+}
+
+/*
+    Message known at build time, the register values are computed by the compiler, for example:
+    typedef VanMessage<0x8A4, VAN_MODE_TRANSMIT, 7> ExternalTemperature;
+    VAN.set_channel(4, ExternalTemperature::Descriptor, packet);
+*/
+template <uint16_t Identifier, VAN_MESSAGE_MODE Mode, uint8_t Length, uint8_t Ack = 0, uint16_t IdentifierMask = TSS463_MASK_FROM_IDENTIFIER>
+struct VanMessage
+{
+    static_assert(Identifier <= 0xFFF, "The identifier has 12 bits");
+    static_assert(!tss463_mode_has_data(Mode) || Length <= VAN_MAX_FRAME_DATA_LENGTH, "A VAN frame carries at most 28 data bytes");
+    static_assert(Length <= TSS463_MAX_DATA_LENGTH, "A channel reserves at most 30 data bytes");
+    static_assert(Ack <= 1, "Ack is 0 or 1");
+    static_assert(Ack == 0 || tss463_mode_uses_rak(Mode) || tss463_mode_uses_drak(Mode), "This message type has no acknowledge setting");
+    static_assert(IdentifierMask == TSS463_MASK_FROM_IDENTIFIER || IdentifierMask <= 0xFFF, "The identifier mask has 12 bits");
+
+    static constexpr VanMessageDescriptor Descriptor = tss463_message_descriptor(Identifier, Mode, Length, Ack, IdentifierMask);
+};
+
+template <uint16_t Identifier, VAN_MESSAGE_MODE Mode, uint8_t Length, uint8_t Ack, uint16_t IdentifierMask>
+constexpr VanMessageDescriptor VanMessage<Identifier, Mode, Length, Ack, IdentifierMask>::Descriptor;
+
+#endif
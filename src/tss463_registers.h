@@ -0,0 +1,71 @@
+// tss463_registers.h
+#pragma once
+
+#ifndef _tss463_registers_h
+    #define _tss463_registers_h
+
+#define MOTOROLA_MODE 0x00
+#define WRITE         0xE0
+#define READ          0x60
+#define ADDR_ANSW     0xAA
+#define CMD_ANSW      0x55
+
+// Interrupt Enable (0x0A), Interrupt Status (0x09) and Interrupt Reset (0x0B) registers share the same bit positions
+#define RSTR  (7)
+#define TEE   (4)
+#define TOKE  (3)
+#define REE   (2)
+#define ROKE  (1)
+#define RNOKE (0)
+
+#pragma region TSS463C internal register adresses - Figure 22
+                                 // R/W?  - Default value on init
+                                 //------------------------------
+#define LINECONTROL       0x00   // r/w   - 0x00
+#define TRANSMITCONTROL   0x01   // r/w   - 0x02
+#define DIAGNOSISCONTROL  0x02   // r/w   - 0x00
+#define COMMANDREGISTER   0x03   // w     - 0x00
+#define LINESTATUS        0x04   // r     - 0bx01xxx00
+#define TRANSMITSTATUS    0x05   // r     - 0x00
+#define LASTMESSAGESTATUS 0x06   // r     - 0x00
+#define LASTERRORSTATUS   0x07   // r     - 0x00
+#define INTERRUPTSTATUS   0x09   // r     - 0x80
+#define INTERRUPTENABLE   0x0A   // r/w   - 0x80
+#define INTERRUPTRESET    0x0B   // w
+#pragma endregion
+
+#define TSS_8MHz_62k5BPS 0x30
+#define TSS_8MHz_125kBPS 0x20
+
+enum VAN_SPEED {
+    VAN_62K5BPS,
+    VAN_125KBPS,
+};
+
+/*
+    Length of the fields of a VAN frame in timeslots (Figure 14, 15 and 16)
+    Enhanced Manchester code: 3 NRZ bits followed by 1 Manchester bit, so 4 bits take 5 timeslots
+    The bus is free after EOF + IFS = 12 timeslots (Figure 30)
+*/
+#define VAN_SOF_TIMESLOTS        10
+#define VAN_IDENTIFIER_TIMESLOTS 15
+#define VAN_COMMAND_TIMESLOTS    5
+#define VAN_DATA_BYTE_TIMESLOTS  10
+#define VAN_FCS_TIMESLOTS        18
+#define VAN_EOD_TIMESLOTS        2
+#define VAN_ACK_TIMESLOTS        2
+#define VAN_EOF_TIMESLOTS        8
+#define VAN_IFS_TIMESLOTS        4
+// From the end of a frame to the end of the data of the next one without data bytes (IFS, SOF to EOD): no two receptions are closer
+#define VAN_SHORTEST_RECEPTION_TIMESLOTS (VAN_IFS_TIMESLOTS + VAN_SOF_TIMESLOTS + VAN_IDENTIFIER_TIMESLOTS + VAN_COMMAND_TIMESLOTS + \
+                                          VAN_FCS_TIMESLOTS + VAN_EOD_TIMESLOTS)
+
+// Channels
+#define CHANNEL_ADDR(x) (0x10 + (0x08 * x))
+#define CHANNELS 14
+// Largest DATA field the TSS463C can handle in one channel (M_L[4:0] = 31, minus the message status byte)
+#define TSS463_MAX_DATA_LENGTH 30
+// Mailbox - data register
+#define GETMAIL(x) (0x80 + x)
+
+#endif
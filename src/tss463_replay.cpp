@@ -0,0 +1,359 @@
+#include "tss463_replay.h"
+#include <string.h>
+
+TSS463_Replay::TSS463_Replay(TSS463_VAN* van, TSS463_Clock clock)
+{
+    _van = van;
+    _clock = clock != NULL ? clock : tss463_micros;
+    memset(_identifiers, 0, sizeof(_identifiers));
+    memset(_lengths, 0, sizeof(_lengths));
+    memset(_deadlines, 0, sizeof(_deadlines));
+    memset(_armedAt, 0, sizeof(_armedAt));
+    clear_stats();
+}
+
+bool TSS463_Replay::begin(uint16_t channelMask)
+{
+    channelMask &= (1 << CHANNELS) - 1;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((channelMask & (1 << i)) && _van->is_channel_occupied(i))
+        {
+            return false;
+        }
+    }
+    _pool = channelMask;
+    return true;
+}
+
+bool TSS463_Replay::start(TSS463_ReplaySource source, void* context)
+{
+    if (source == NULL)
+    {
+        return false;
+    }
+    _source = source;
+    _context = context;
+    _frames = NULL;
+    return start();
+}
+
+bool TSS463_Replay::start(const VanFrame frames[], uint16_t count)
+{
+    if (frames == NULL && count > 0)
+    {
+        return false;
+    }
+    _source = NULL;
+    _frames = frames;
+    _frameCount = count;
+    _frameIndex = 0;
+    return start();
+}
+
+bool TSS463_Replay::start()
+{
+    stop();
+    if (_pool == 0)
+    {
+        return false;
+    }
+
+    _startTime = _clock();
+    _running = true;
+    // the first frame is due at the start
+    load_next();
+    _recordedOffset = 0;
+    return true;
+}
+
+void TSS463_Replay::stop()
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_inFlight & (1 << i))
+        {
+            _van->disable_channel(i);
+            release(i);
+        }
+    }
+    _hasNext = false;
+    _running = false;
+}
+
+/*
+    Takes the next frame of the recording and adds its time to the offset from the first frame (the timestamps may wrap around)
+*/
+bool TSS463_Replay::load_next()
+{
+    if (_frames != NULL)
+    {
+        _hasNext = _frameIndex < _frameCount;
+        if (_hasNext)
+        {
+            _next = _frames[_frameIndex++];
+        }
+    }
+    else
+    {
+        _hasNext = _source(_next, _context);
+    }
+
+    if (!_hasNext)
+    {
+        return false;
+    }
+
+    _recordedOffset += (uint32_t)(_next.Timestamp - _lastRecorded);
+    _lastRecorded = _next.Timestamp;
+    return true;
+}
+
+uint32_t TSS463_Replay::next_deadline()
+{
+    if (_speedPercent == 0)
+    {
+        return _startTime;
+    }
+    return _startTime + (uint32_t)(_recordedOffset * 100 / _speedPercent);
+}
+
+uint8_t TSS463_Replay::free_channel()
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((_pool & (1 << i)) && !(_inFlight & (1 << i)))
+        {
+            return i;
+        }
+    }
+    return TSS463_NO_CHANNEL;
+}
+
+bool TSS463_Replay::is_in_flight(uint16_t identifier)
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((_inFlight & (1 << i)) && _identifiers[i] == identifier)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Returns the channel of the reply of the identifier which was not requested yet, if it has the same length
+*/
+uint8_t TSS463_Replay::pending_reply(uint16_t identifier, uint8_t length)
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((_inFlight & _isReply & (1 << i)) && _identifiers[i] == identifier && _lengths[i] == length)
+        {
+            return i;
+        }
+    }
+    return TSS463_NO_CHANNEL;
+}
+
+/*
+    Sets up the channel for the next frame: a transmit channel for a data frame, an immediate reply channel for a reply
+*/
+bool TSS463_Replay::arm(uint8_t channelId, uint32_t deadline, uint32_t now)
+{
+    bool isReply = _next.Status.data.RRNW;
+    bool result;
+
+    if (isReply)
+    {
+        result = _van->set_channel_for_immediate_reply_message(channelId, _next.Identifier, _next.Data, _next.Length);
+    }
+    else
+    {
+        result = _van->set_channel_for_transmit_message(channelId, _next.Identifier, _next.Data, _next.Length, _next.Status.data.RRAK);
+    }
+
+    if (result)
+    {
+        _inFlight |= 1 << channelId;
+        _isReply = isReply ? (_isReply | (1 << channelId)) : (_isReply & ~(1 << channelId));
+        _identifiers[channelId] = _next.Identifier;
+        _lengths[channelId] = _next.Length;
+        _deadlines[channelId] = deadline;
+        _armedAt[channelId] = now;
+    }
+    return result;
+}
+
+void TSS463_Replay::release(uint8_t channelId)
+{
+    _van->release_channel(channelId);
+    _inFlight &= ~(1 << channelId);
+}
+
+void TSS463_Replay::complete(uint8_t channelId, MessageLengthAndStatusRegister status)
+{
+    if (!status.data.CHTx)
+    {
+        return;
+    }
+
+    if (status.data.CHER)
+    {
+        _stats.Errors++;
+    }
+    else
+    {
+        uint32_t drift = _van->completion_time(channelId) - _deadlines[channelId];
+        // the clock of the deadlines and of the completion is the same, a negative value is a wrap of an unset time
+        if ((int32_t)drift < 0)
+        {
+            drift = 0;
+        }
+        _stats.Sent++;
+        _stats.LastDriftUs = drift;
+        if (drift > _stats.MaxDriftUs)
+        {
+            _stats.MaxDriftUs = drift;
+        }
+        if (_driftHistogram != NULL)
+        {
+            _driftHistogram->add(drift);
+        }
+    }
+    release(channelId);
+}
+
+uint8_t TSS463_Replay::poll()
+{
+    if (!_running)
+    {
+        return 0;
+    }
+
+    if (_inFlight != 0)
+    {
+        MessageLengthAndStatusRegister statuses[CHANNELS];
+        uint16_t completed = _van->poll_all_channels(statuses) & _inFlight;
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (completed & (1 << i))
+            {
+                complete(i, statuses[i]);
+            }
+        }
+    }
+
+    // the replies which were not requested give their channel back
+    uint32_t now = _clock();
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((_inFlight & _isReply & (1 << i)) && now - _armedAt[i] >= TSS463_REPLAY_REPLY_WINDOW_MS * 1000UL)
+        {
+            _van->disable_channel(i);
+            release(i);
+            _stats.Expired++;
+        }
+    }
+
+    uint8_t armed = 0;
+    while (_hasNext)
+    {
+        uint32_t deadline = next_deadline();
+        if ((int32_t)(now - deadline) < 0)
+        {
+            break;
+        }
+
+        if (_next.Status.data.RRNW && _next.Status.data.RRTR)
+        {
+            _stats.Skipped++;
+            load_next();
+            continue;
+        }
+
+        uint8_t channelId = _next.Status.data.RRNW ? pending_reply(_next.Identifier, _next.Length) : TSS463_NO_CHANNEL;
+        if (channelId != TSS463_NO_CHANNEL && _van->update_channel_payload(channelId, _next.Data, _next.Length))
+        {
+            _deadlines[channelId] = deadline;
+            _armedAt[channelId] = now;
+            _stats.Superseded++;
+            load_next();
+            continue;
+        }
+
+        channelId = free_channel();
+        if (channelId == TSS463_NO_CHANNEL || is_in_flight(_next.Identifier))
+        {
+            break;
+        }
+        if (!arm(channelId, deadline, now))
+        {
+            // a frame the driver refuses even with every channel free (invalid identifier or length) is dropped
+            if (_inFlight == 0)
+            {
+                _stats.Skipped++;
+                load_next();
+                continue;
+            }
+            break;
+        }
+        armed++;
+        load_next();
+    }
+
+    if (!_hasNext && _inFlight == 0)
+    {
+        _running = false;
+    }
+    return armed;
+}
+
+void TSS463_Replay::set_speed(uint16_t percent)
+{
+    _speedPercent = percent;
+}
+
+void TSS463_Replay::set_drift_histogram(TSS463_LatencyHistogram* histogram)
+{
+    _driftHistogram = histogram;
+}
+
+bool TSS463_Replay::is_running()
+{
+    return _running;
+}
+
+uint8_t TSS463_Replay::in_flight()
+{
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_inFlight & (1 << i))
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+uint32_t TSS463_Replay::lag_us()
+{
+    if (!_hasNext)
+    {
+        return 0;
+    }
+    uint32_t lag = _clock() - next_deadline();
+    return (int32_t)lag > 0 ? lag : 0;
+}
+
+const ReplayStats* TSS463_Replay::stats()
+{
+    return &_stats;
+}
+
+void TSS463_Replay::clear_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,125 @@
+// tss463_replay.h
+#pragma once
+
+#ifndef _tss463_replay_h
+    #define _tss463_replay_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_van.h"
+
+// A reply frame waits this long for the request of the other node, then its channel is disabled and given to the next frame
+#ifndef TSS463_REPLAY_REPLY_WINDOW_MS
+    #define TSS463_REPLAY_REPLY_WINDOW_MS 200
+#endif
+
+/*
+    Gives the next frame of the recording (for example from a TSS463_CaptureReader), returns false after the last one
+*/
+typedef bool (*TSS463_ReplaySource)(VanFrame& frame, void* context);
+
+typedef struct
+{
+    // frames transmitted, or given as the in-frame reply of a request
+    uint32_t Sent;
+    // the retry count was exceeded (CHER)
+    uint32_t Errors;
+    // reply frames which were not requested within TSS463_REPLAY_REPLY_WINDOW_MS
+    uint32_t Expired;
+    // reply frames whose data was replaced by the next reply of the identifier before they were requested
+    uint32_t Superseded;
+    // reply requests without a reply (they belong to the other node) and frames the driver refuses
+    uint32_t Skipped;
+    // delay between the recorded time (scaled by the speed) and the transmission, in microseconds
+    uint32_t LastDriftUs;
+    uint32_t MaxDriftUs;
+}ReplayStats;
+
+/*
+    Transmits a recorded frame stream again with the timing of the recording, or faster or slower by a speed factor
+    The recorded time of every frame becomes a deadline from the start of the replay. The data frames (RNW = 0) are transmitted
+    by transmit channels, the replies seen in the recording (RNW = 1, RTR = 0) are given by immediate reply channels when the other
+    node requests them. The frames are armed in the order of the recording on the free channels of the pool, so as many frames are
+    in flight as there are free channels, and a frame waits while a frame with the same identifier is in flight. A reply which was
+    not requested yet takes the data of the next reply of its identifier instead, like the node which was recorded.
+    The drift is measured from the deadline to the transmission seen by the library (see TSS463_VAN::completion_time).
+    poll has to be called frequently from the loop, the replay runs on the hardware or on the TSS463_Emulator of a TSS463_BusSimulator.
+*/
+class TSS463_Replay
+{
+private:
+    TSS463_VAN* _van;
+    TSS463_Clock _clock;
+    uint16_t _pool = 0;
+    uint16_t _inFlight = 0;
+    uint16_t _isReply = 0;
+    uint16_t _identifiers[CHANNELS];
+    uint8_t _lengths[CHANNELS];
+    uint32_t _deadlines[CHANNELS];
+    uint32_t _armedAt[CHANNELS];
+
+    TSS463_ReplaySource _source = NULL;
+    void* _context = NULL;
+    const VanFrame* _frames = NULL;
+    uint16_t _frameCount = 0;
+    uint16_t _frameIndex = 0;
+
+    VanFrame _next;
+    bool _hasNext = false;
+    bool _running = false;
+    uint16_t _speedPercent = 100;
+    uint32_t _startTime = 0;
+    uint32_t _lastRecorded = 0;
+    uint64_t _recordedOffset = 0;
+    ReplayStats _stats;
+    TSS463_LatencyHistogram* _driftHistogram = NULL;
+
+    bool start();
+    bool load_next();
+    uint32_t next_deadline();
+    uint8_t free_channel();
+    bool is_in_flight(uint16_t identifier);
+    uint8_t pending_reply(uint16_t identifier, uint8_t length);
+    bool arm(uint8_t channelId, uint32_t deadline, uint32_t now);
+    void complete(uint8_t channelId, MessageLengthAndStatusRegister status);
+    void release(uint8_t channelId);
+
+public:
+    // clock: time source in microseconds, micros is used when it is NULL
+    TSS463_Replay(TSS463_VAN* van, TSS463_Clock clock = NULL);
+
+    // Takes the given channels (bit n: channel n, they must be free), false if one of them is occupied
+    bool begin(uint16_t channelMask);
+
+    // Starts the replay of the frames given by the source, or of an array of frames, the first frame is due at once
+    bool start(TSS463_ReplaySource source, void* context = NULL);
+    bool start(const VanFrame frames[], uint16_t count);
+    // Disables the channels of the frames in flight
+    void stop();
+
+    // 100: the timing of the recording, 200: twice as fast, 50: half speed, 0: every frame as soon as a channel is free, the drift is then the time since the start (set it before start)
+    void set_speed(uint16_t percent);
+    // Histogram of the drift of the sent frames, NULL stops recording
+    void set_drift_histogram(TSS463_LatencyHistogram* histogram);
+
+    // Reads the status of the channels in one SPI frame, completes the sent frames and arms the frames whose deadline passed, returns their number
+    uint8_t poll();
+
+    // false when every frame was sent (or dropped) or after stop
+    bool is_running();
+    uint8_t in_flight();
+    // How far the next frame is behind its deadline now, in microseconds (0 if it is not due yet)
+    uint32_t lag_us();
+    const ReplayStats* stats();
+    void clear_stats();
+};
+
+#endif
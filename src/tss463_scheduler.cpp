@@ -0,0 +1,299 @@
+#include "tss463_scheduler.h"
+#include <string.h>
+
+TSS463_Scheduler::TSS463_Scheduler(TSS463_VAN* van, TSS463_Clock clock)
+{
+    _van = van;
+    _clock = clock != NULL ? clock : tss463_micros;
+    memset(_frames, 0, sizeof(_frames));
+}
+
+uint8_t TSS463_Scheduler::add_frame(uint16_t identifier, uint32_t periodMs, uint8_t payload[], uint8_t length, uint8_t ack, uint8_t channelId)
+{
+    if (_running || _frameCount >= TSS463_SCHEDULER_MAX_FRAMES || periodMs == 0 || (payload == NULL && length > 0))
+    {
+        return TSS463_NO_FRAME;
+    }
+    if (channelId != TSS463_NO_CHANNEL && channelId >= CHANNELS)
+    {
+        return TSS463_NO_FRAME;
+    }
+
+    ScheduledFrame* frame = &_frames[_frameCount];
+    memset(frame, 0, sizeof(ScheduledFrame));
+    frame->Identifier = identifier;
+    frame->PeriodUs = periodMs * 1000;
+    frame->Payload = payload;
+    frame->Length = length;
+    frame->Ack = ack;
+    frame->Channel = channelId;
+    frame->FixedChannel = channelId != TSS463_NO_CHANNEL;
+
+    return _frameCount++;
+}
+
+bool TSS463_Scheduler::set_payload_source(uint8_t frame, TSS463_PayloadSource source)
+{
+    if (frame >= _frameCount)
+    {
+        return false;
+    }
+    _frames[frame].Source = source;
+    return true;
+}
+
+/*
+    Fills the order with the frame numbers sorted by period (stable, so equal periods keep the order of registration)
+*/
+uint8_t TSS463_Scheduler::sort_by_period(uint8_t order[])
+{
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        uint8_t j = i;
+        while (j > 0 && _frames[order[j - 1]].PeriodUs > _frames[i].PeriodUs)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    return _frameCount;
+}
+
+/*
+    The fixed channels have to be free, the other frames get the lowest free channels in the order of their periods
+*/
+bool TSS463_Scheduler::assign_channels(const uint8_t order[])
+{
+    uint16_t used = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_van->is_channel_occupied(i))
+        {
+            used |= 1 << i;
+        }
+    }
+
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        if (_frames[i].FixedChannel)
+        {
+            if (used & (1 << _frames[i].Channel))
+            {
+                return false;
+            }
+            used |= 1 << _frames[i].Channel;
+        }
+    }
+
+    uint8_t channelId = 0;
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        ScheduledFrame* frame = &_frames[order[i]];
+        if (frame->FixedChannel)
+        {
+            continue;
+        }
+        while (channelId < CHANNELS && (used & (1 << channelId)))
+        {
+            channelId++;
+        }
+        if (channelId >= CHANNELS)
+        {
+            return false;
+        }
+        frame->Channel = channelId;
+        used |= 1 << channelId;
+    }
+    return true;
+}
+
+bool TSS463_Scheduler::start()
+{
+    if (_running || _frameCount == 0)
+    {
+        return _running;
+    }
+
+    uint8_t order[TSS463_SCHEDULER_MAX_FRAMES];
+    sort_by_period(order);
+    if (!assign_channels(order))
+    {
+        return false;
+    }
+
+    // the first deadlines are evenly spaced over the shortest period
+    uint32_t now = _clock();
+    uint32_t shortestPeriod = _frames[order[0]].PeriodUs;
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        ScheduledFrame* frame = &_frames[order[i]];
+        frame->NextDeadline = now + (uint32_t)((uint64_t)shortestPeriod * i / _frameCount);
+        frame->IsSetUp = false;
+    }
+
+    _running = true;
+    return true;
+}
+
+void TSS463_Scheduler::stop()
+{
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        if (_frames[i].IsSetUp)
+        {
+            _van->disable_channel(_frames[i].Channel);
+            _frames[i].IsSetUp = false;
+        }
+        if (!_frames[i].FixedChannel)
+        {
+            _frames[i].Channel = TSS463_NO_CHANNEL;
+        }
+    }
+    _running = false;
+}
+
+/*
+    The channel is set up at the first deadline, later only the changed payload bytes are written and the channel is reactivated
+    Returns false if the frame could not be armed, the setup is tried again at the next deadline
+*/
+bool TSS463_Scheduler::release(ScheduledFrame* frame)
+{
+    if (frame->Source != NULL)
+    {
+        frame->Source(frame->Identifier, frame->Payload, frame->Length);
+    }
+
+    bool armed;
+    if (frame->IsSetUp)
+    {
+        armed = _van->update_channel_payload(frame->Channel, frame->Payload, frame->Length) && _van->reactivate_channel(frame->Channel);
+    }
+    else
+    {
+        armed = _van->set_channel_for_transmit_message(frame->Channel, frame->Identifier, frame->Payload, frame->Length, frame->Ack);
+        frame->IsSetUp = armed;
+    }
+
+    if (armed)
+    {
+        frame->Stats.Released++;
+    }
+    else
+    {
+        frame->Stats.SetupFailures++;
+    }
+    return armed;
+}
+
+uint8_t TSS463_Scheduler::poll()
+{
+    if (!_running)
+    {
+        return 0;
+    }
+
+    uint32_t now = _clock();
+    uint8_t released = 0;
+
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        ScheduledFrame* frame = &_frames[i];
+        int32_t lateness = (int32_t)(now - frame->NextDeadline);
+        if (lateness < 0)
+        {
+            continue;
+        }
+
+        bool pending = false;
+        if (frame->IsSetUp)
+        {
+            MessageLengthAndStatusRegister status = _van->message_available(frame->Channel);
+            if (status.data.CHER)
+            {
+                frame->Stats.Errors++;
+            }
+            else if (status.data.CHTx)
+            {
+                frame->Stats.Sent++;
+            }
+            else
+            {
+                // still waiting for the bus: it keeps its place, the payload is not changed under the TSS463C
+                frame->Stats.Missed++;
+                pending = true;
+            }
+        }
+
+        if (!pending)
+        {
+            if ((uint32_t)lateness > frame->Stats.MaxLatenessUs)
+            {
+                frame->Stats.MaxLatenessUs = lateness;
+            }
+            if (release(frame))
+            {
+                released++;
+            }
+        }
+
+        // deadlines which passed while poll was not called are counted as missed, the timing stays aligned to the period
+        frame->NextDeadline += frame->PeriodUs;
+        while ((int32_t)(now - frame->NextDeadline) >= 0)
+        {
+            frame->NextDeadline += frame->PeriodUs;
+            frame->Stats.Missed++;
+        }
+    }
+    return released;
+}
+
+uint32_t TSS463_Scheduler::time_to_next_deadline_us()
+{
+    if (!_running)
+    {
+        return 0xFFFFFFFF;
+    }
+
+    uint32_t now = _clock();
+    uint32_t result = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        int32_t remaining = (int32_t)(_frames[i].NextDeadline - now);
+        if (remaining <= 0)
+        {
+            return 0;
+        }
+        if ((uint32_t)remaining < result)
+        {
+            result = remaining;
+        }
+    }
+    return result;
+}
+
+uint8_t TSS463_Scheduler::frame_channel(uint8_t frame)
+{
+    if (frame >= _frameCount)
+    {
+        return TSS463_NO_CHANNEL;
+    }
+    return _frames[frame].Channel;
+}
+
+const ScheduledFrameStats* TSS463_Scheduler::frame_stats(uint8_t frame)
+{
+    if (frame >= _frameCount)
+    {
+        return NULL;
+    }
+    return &_frames[frame].Stats;
+}
+
+void TSS463_Scheduler::clear_stats()
+{
+    for (uint8_t i = 0; i < _frameCount; i++)
+    {
+        memset(&_frames[i].Stats, 0, sizeof(ScheduledFrameStats));
+    }
+}
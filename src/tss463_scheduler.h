@@ -0,0 +1,105 @@
+// tss463_scheduler.h
+#pragma once
+
+#ifndef _tss463_scheduler_h
+    #define _tss463_scheduler_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_van.h"
+
+// Number of periodic frames handled by a scheduler
+#ifndef TSS463_SCHEDULER_MAX_FRAMES
+    #define TSS463_SCHEDULER_MAX_FRAMES CHANNELS
+#endif
+
+#define TSS463_NO_FRAME 0xFF
+
+/*
+    Called right before a frame is armed, it can refresh the payload of the frame in place
+*/
+typedef void (*TSS463_PayloadSource)(uint16_t identifier, uint8_t payload[], uint8_t length);
+
+typedef struct
+{
+    // the frame was armed at its deadline
+    uint32_t Released;
+    // the frame could not be armed at its deadline: its channel could not be set up (no room in the Message DATA RAM) or updated
+    uint32_t SetupFailures;
+    // the previous frame was transmitted before the deadline
+    uint32_t Sent;
+    // the previous frame was still waiting for the bus at the deadline, or the deadline passed without a call to poll
+    uint32_t Missed;
+    // the retry count of the previous frame was exceeded (CHER)
+    uint32_t Errors;
+    // the largest delay between the deadline and the arming of the frame, in microseconds
+    uint32_t MaxLatenessUs;
+}ScheduledFrameStats;
+
+typedef struct
+{
+    uint16_t Identifier;
+    uint32_t PeriodUs;
+    uint8_t* Payload;
+    uint8_t Length;
+    uint8_t Ack;
+    TSS463_PayloadSource Source;
+    uint8_t Channel;
+    bool FixedChannel;
+    // the channel was set up, later deadlines only update the payload and reactivate it
+    bool IsSetUp;
+    uint32_t NextDeadline;
+    ScheduledFrameStats Stats;
+}ScheduledFrame;
+
+/*
+    Transmits frames periodically on channels of the TSS463C
+    The frames without a fixed channel get the free channels in the order of their periods: when several channels are ready
+    the TSS463C transmits the lowest channel first (Page 46), so the shortest period gets the lowest channel.
+    The first deadlines are spread over the shortest period, so the frames are not armed in one burst.
+    poll has to be called frequently from the loop, it arms every frame whose deadline passed (one status read and the changed payload bytes per frame).
+*/
+class TSS463_Scheduler
+{
+private:
+    TSS463_VAN* _van;
+    TSS463_Clock _clock;
+    ScheduledFrame _frames[TSS463_SCHEDULER_MAX_FRAMES];
+    uint8_t _frameCount = 0;
+    bool _running = false;
+
+    uint8_t sort_by_period(uint8_t order[]);
+    bool assign_channels(const uint8_t order[]);
+    bool release(ScheduledFrame* frame);
+
+public:
+    // clock: time source in microseconds, micros is used when it is NULL
+    TSS463_Scheduler(TSS463_VAN* van, TSS463_Clock clock = NULL);
+
+    // Registers a periodic frame (channelId: TSS463_NO_CHANNEL to let the scheduler choose), returns the frame number or TSS463_NO_FRAME
+    uint8_t add_frame(uint16_t identifier, uint32_t periodMs, uint8_t payload[], uint8_t length, uint8_t ack, uint8_t channelId = TSS463_NO_CHANNEL);
+    bool set_payload_source(uint8_t frame, TSS463_PayloadSource source);
+
+    // Assigns the channels and starts the timing, false if there are not enough free channels
+    bool start();
+    // Disables the channels of the frames
+    void stop();
+    // Arms the frames whose deadline passed, returns the number of frames armed
+    uint8_t poll();
+
+    // Time until the next deadline in microseconds (0 if a frame is due, 0xFFFFFFFF if the scheduler is stopped)
+    uint32_t time_to_next_deadline_us();
+    uint8_t frame_channel(uint8_t frame);
+    const ScheduledFrameStats* frame_stats(uint8_t frame);
+    void clear_stats();
+};
+
+#endif
@@ -0,0 +1,139 @@
+// tss463_timing.h
+#pragma once
+
+#ifndef _tss463_timing_h
+    #define _tss463_timing_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+/*
+    Frequency of the crystal (or clock) on the XTAL1 pin of the TSS463C. The minimum SPI interframe spacing is given in XTAL periods,
+    so every wait on the SPI interface is derived from this value. Define it before including the library if your board uses another crystal.
+*/
+#ifndef TSS463_XTAL_FREQUENCY
+    #define TSS463_XTAL_FREQUENCY 8000000UL
+#endif
+
+/*
+    SCLK used for the SPI transactions. Within an SPI byte the maximum speed allowed on the MOSI line is 4 Mbits/s (Page 10)
+*/
+#ifndef TSS463_SPI_CLOCK
+    #define TSS463_SPI_CLOCK 4000000
+#endif
+
+static_assert(TSS463_SPI_CLOCK <= 4000000, "TSS463_SPI_CLOCK above the 4 Mbits/s allowed on MOSI");
+
+/*
+    SPI Speed Considerations - Figure 7 (Page 10) and Table 12 (Page 55)
+    ..........................................................................
+    : Gap                                               : Min (XTAL periods) :
+    :...................................................:....................:
+    : SS low to address byte (tLEAD)                    :                  4 :
+    : Address byte to control byte                      :                  8 :
+    : Control byte to first data byte                   :                 15 :
+    : Data byte to data byte, last byte to SS high      :                 12 :
+    :...................................................:....................:
+*/
+#define TSS463_LEAD_XTAL_CLOCKS    4
+#define TSS463_ADDRESS_XTAL_CLOCKS 8
+#define TSS463_CONTROL_XTAL_CLOCKS 15
+#define TSS463_DATA_XTAL_CLOCKS    12
+
+constexpr uint32_t tss463_xtal_clocks_to_ns(uint32_t clocks, uint32_t xtalFrequency)
+{
+    return (uint32_t)(((uint64_t)clocks * 1000000000ULL + xtalFrequency - 1) / xtalFrequency);
+}
+
+constexpr uint32_t tss463_xtal_clocks_to_ns(uint32_t clocks)
+{
+    return tss463_xtal_clocks_to_ns(clocks, TSS463_XTAL_FREQUENCY);
+}
+
+constexpr uint32_t tss463_ns_to_cpu_cycles(uint32_t ns, uint32_t cpuFrequency)
+{
+    return (uint32_t)(((uint64_t)ns * cpuFrequency + 999999999ULL) / 1000000000ULL);
+}
+
+constexpr uint32_t tss463_ns_to_us(uint32_t ns)
+{
+    return (ns + 999) / 1000;
+}
+
+constexpr uint32_t TSS463_LEAD_GAP_NS    = tss463_xtal_clocks_to_ns(TSS463_LEAD_XTAL_CLOCKS);
+constexpr uint32_t TSS463_ADDRESS_GAP_NS = tss463_xtal_clocks_to_ns(TSS463_ADDRESS_XTAL_CLOCKS);
+constexpr uint32_t TSS463_CONTROL_GAP_NS = tss463_xtal_clocks_to_ns(TSS463_CONTROL_XTAL_CLOCKS);
+constexpr uint32_t TSS463_DATA_GAP_NS    = tss463_xtal_clocks_to_ns(TSS463_DATA_XTAL_CLOCKS);
+
+// The rounding must never shorten a gap below the datasheet minimum
+static_assert((uint64_t)TSS463_LEAD_GAP_NS    * TSS463_XTAL_FREQUENCY >= (uint64_t)TSS463_LEAD_XTAL_CLOCKS    * 1000000000ULL, "tLEAD below datasheet minimum");
+static_assert((uint64_t)TSS463_ADDRESS_GAP_NS * TSS463_XTAL_FREQUENCY >= (uint64_t)TSS463_ADDRESS_XTAL_CLOCKS * 1000000000ULL, "Address gap below datasheet minimum");
+static_assert((uint64_t)TSS463_CONTROL_GAP_NS * TSS463_XTAL_FREQUENCY >= (uint64_t)TSS463_CONTROL_XTAL_CLOCKS * 1000000000ULL, "Control gap below datasheet minimum");
+static_assert((uint64_t)TSS463_DATA_GAP_NS    * TSS463_XTAL_FREQUENCY >= (uint64_t)TSS463_DATA_XTAL_CLOCKS    * 1000000000ULL, "Data gap below datasheet minimum");
+
+// One byte on the SPI bus: 8 SCLK periods
+constexpr uint32_t TSS463_SPI_BYTE_NS = (uint32_t)((8ULL * 1000000000ULL + TSS463_SPI_CLOCK - 1) / TSS463_SPI_CLOCK);
+
+/*
+    Shortest time on the SPI bus of the given number of frames carrying the given number of bytes in total (address and control bytes included)
+    Every frame: tLEAD, the address and control bytes and their gaps, every data byte: 8 SCLK periods and the data gap (Page 10)
+*/
+constexpr uint64_t tss463_spi_time_ns(uint32_t frames, uint32_t bytes)
+{
+    return (uint64_t)bytes * TSS463_SPI_BYTE_NS
+        + (uint64_t)frames * (TSS463_LEAD_GAP_NS + TSS463_ADDRESS_GAP_NS + TSS463_CONTROL_GAP_NS)
+        + (uint64_t)(bytes - 2 * frames) * TSS463_DATA_GAP_NS;
+}
+
+/*
+    Busy-waits at least the given amount of nanoseconds
+    AVR: exact cycle count, resolved at compile time
+    ESP32: CPU cycle counter
+    Others: rounded up to the next microsecond
+    Host build: no wait, the transport is emulated
+*/
+#if defined(ARDUINO_ARCH_AVR) && defined(F_CPU)
+    #define TSS463_WAIT_NS(ns) __builtin_avr_delay_cycles(tss463_ns_to_cpu_cycles((ns), F_CPU))
+#elif defined(ARDUINO_ARCH_ESP32) && defined(F_CPU)
+    inline void tss463_wait_cycles(uint32_t cycles)
+    {
+        uint32_t start = ESP.getCycleCount();
+        while ((uint32_t)(ESP.getCycleCount() - start) < cycles) {}
+    }
+    #define TSS463_WAIT_NS(ns) tss463_wait_cycles(tss463_ns_to_cpu_cycles((ns), F_CPU))
+#elif defined(ARDUINO)
+    #define TSS463_WAIT_NS(ns) delayMicroseconds(tss463_ns_to_us(ns))
+#else
+    #define TSS463_WAIT_NS(ns) ((void)(ns))
+#endif
+
+/*
+    Time source in microseconds for the time based parts of the library, a fake clock can be given to run them without waiting
+*/
+typedef uint32_t (*TSS463_Clock)();
+
+// micros as a TSS463_Clock, the default time source (defined once in tss463_van.cpp, in IRAM on ESP32 as it is called from the ISR)
+uint32_t tss463_micros();
+
+#if !defined(ARDUINO)
+    #include <time.h>
+
+/*
+    Host build: micros from the monotonic clock of the system
+*/
+inline uint32_t micros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000ULL + now.tv_nsec / 1000);
+}
+#endif
+
+#endif
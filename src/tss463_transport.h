@@ -0,0 +1,80 @@
+// tss463_transport.h
+#pragma once
+
+#ifndef _tss463_transport_h
+    #define _tss463_transport_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+        #include <SPI.h>
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+/*
+    Byte level access to the serial interface of the TSS463C
+    A frame is: select(), address byte, control byte, data bytes, unselect(). The spacing between the bytes (Page 10) is kept by the library, not by the transport.
+*/
+class TSS463_Transport
+{
+public:
+    // Called once from the constructor of TSS463_VAN
+    virtual void begin() {}
+    // Asserts SS, starts an SPI frame
+    virtual void select() = 0;
+    // Sends a byte on MOSI and returns the byte received on MISO at the same time
+    virtual uint8_t transfer(uint8_t data) = 0;
+    // Releases SS, ends the SPI frame
+    virtual void unselect() = 0;
+};
+
+#if defined(ARDUINO)
+#include "tss463_timing.h"
+
+/*
+    Hardware SPI with a chip select pin, CPOL = CPHA = 1 (Page 7)
+    One SPI transaction covers the whole chip select period, so the bus is not given to another device inside a frame
+*/
+class TSS463_SpiTransport : public TSS463_Transport
+{
+private:
+    SPIClass* _spi;
+    SPISettings _spiSettings;
+    uint8_t _cs;
+
+public:
+    TSS463_SpiTransport(uint8_t cs, SPIClass* spi)
+        : _spi(spi), _spiSettings(TSS463_SPI_CLOCK, MSBFIRST, SPI_MODE3), _cs(cs)
+    {
+    }
+
+    void begin()
+    {
+        pinMode(_cs, OUTPUT);
+        digitalWrite(_cs, HIGH);
+    }
+
+    void select()
+    {
+        _spi->beginTransaction(_spiSettings);
+        digitalWrite(_cs, LOW);
+    }
+
+    uint8_t transfer(uint8_t data)
+    {
+        return _spi->transfer(data);
+    }
+
+    void unselect()
+    {
+        digitalWrite(_cs, HIGH);
+        _spi->endTransaction();
+    }
+};
+#endif
+
+#endif
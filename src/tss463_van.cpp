@@ -1,5 +1,7 @@
 #include "tss463_van.h"
-#include <SPI.h>
+#if defined(ARDUINO)
+    #include <SPI.h>
+#endif
 
 int ExtractBits(uint16_t value, uint16_t numberOfBits, uint16_t pos)
 {
@@ -12,12 +14,47 @@ void GetBytesFromIdentifier(uint16_t iden, uint8_t *byte1, uint8_t *byte2)
     *byte2 = (uint8_t) (iden & 0xF);
 }
 
-void TSS463_VAN::tss_init()
+static const ChannelPlan NO_CHANNELS = { NULL, 0 };
+
+uint32_t TSS463_ISR_ATTR tss463_micros()
+{
+    return micros();
+}
+
+BEGIN_STATUS TSS463_VAN::tss_init(const ChannelPlan& plan)
 {
-    motorolla_mode();
-    delayMicroseconds(3);//at 8MHZ max speed (12 clocks XTAL)
+    clear_spi_stats();
+
+    // the TSS463C answers the initialization sequence as soon as its oscillator runs, no need to wait for the worst case
+    uint32_t start = _clock();
+    while (!motorolla_mode())
+    {
+        if (_clock() - start >= TSS463_BEGIN_TIMEOUT_US)
+        {
+            return BEGIN_NO_ANSWER;
+        }
+    }
+    TSS463_WAIT_NS(TSS463_DATA_GAP_NS);//12 clocks XTAL
+
+    // the channel registers and the Message DATA RAM in one SPI frame, before the line is activated
+    bool result = configure(plan);
+    if (!result)
+    {
+        configure(NO_CHANNELS);
+    }
+
+    if (!start_line())
+    {
+        return BEGIN_LINE_INACTIVE;
+    }
+    return result ? BEGIN_OK : BEGIN_INVALID_PLAN;
+}
 
-    reset_channels();
+/*
+    Sets the line control, transmit control and interrupt enable registers, activates the line and waits until it is active
+*/
+bool TSS463_VAN::start_line()
+{
 
     #pragma region Line Control Register (0x00) documentation
     /*
@@ -61,11 +98,17 @@ void TSS463_VAN::tss_init()
     */
     #pragma endregion
 
-    register_set(TRANSMITCONTROL, B00000011); // MR: 0011 (Maximum Retries = 0x01) VER 001 fixed
+    register_set(TRANSMITCONTROL, 0b00000011); // MR: 0011 (Maximum Retries = 0x01) VER 001 fixed
+
+    // Diagnosis Control Register (0x02): 0x00 after reset, only written if set_diagnosis_control was used
+    if (_diagnosisControl.Value != 0)
+    {
+        register_set(DIAGNOSISCONTROL, _diagnosisControl.Value);
+    }
 
     // Enable TSS Interrupts
     uint8_t intEnable = 0x80; // Default value reset: 1xx0 0000
-    intEnable |= ( 1 << ROKE) | ( 1 << ROKE);
+    intEnable |= ( 1 << ROKE) | ( 1 << RNOKE);
     /*
     Interrupt Reset Register (0x0B) - Write only
     +------+---+---+-----+------+-----+------+-------+
@@ -150,178 +193,421 @@ void TSS463_VAN::tss_init()
     */
     #pragma endregion
 
-    register_set(COMMANDREGISTER, B10000);  // ACTI - activate line
+    register_set(COMMANDREGISTER, 0b10000);  // ACTI - activate line
     error = 0;
 
-    #pragma region Fill Message DATA RAM area with 0x00
-    uint8_t zeroarray[TSS463C_RAM_SIZE_IN_BYTES];
-    memset(zeroarray, 0, sizeof(zeroarray));
-    registers_set(GETMAIL(0), zeroarray, TSS463C_RAM_SIZE_IN_BYTES);
-    #pragma endregion
+    return wait_line_active();
 }
 
-uint8_t TSS463_VAN::spi_transfer(uint8_t data)
+/*
+    Reads the Line Status Register (0x04) until the SPG (sleeping) and IDG (idling) bits are cleared by the Activate command
+*/
+bool TSS463_VAN::wait_line_active()
 {
-    uint8_t res;
-
-    SPI->beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE3));
-    res = SPI->transfer(data);
-    SPI->endTransaction();
+    uint32_t start = _clock();
+    LineStatusRegister status;
+    while (true)
+    {
+        status.Value = register_get(LINESTATUS);
+        if (!status.data.SPG && !status.data.IDG)
+        {
+            return true;
+        }
+        if (_clock() - start >= TSS463_ACTIVATION_TIMEOUT_US)
+        {
+            return false;
+        }
+    }
+}
 
-    return res;
+uint8_t TSS463_VAN::spi_transfer(uint8_t data)
+{
+    return _transport->transfer(data);
 }
 
-void TSS463_VAN::register_set(uint8_t address, uint8_t value)
+/*
+    Opens an SPI frame: one SPI transaction for the whole chip-select period, followed by the address and control bytes
+*/
+void TSS463_VAN::frame_begin(uint8_t address, uint8_t control)
 {
-    uint8_t res = 0;
+    uint8_t res;
 
-    TSS463_SELECT();
+    _transport->select();
 
-    delayMicroseconds(1);//at 8MHZ max speed (4 clocks XTAL)
+    TSS463_WAIT_NS(TSS463_LEAD_GAP_NS);//4 clocks XTAL
 
     //At the beginning of a transmission over the serial interface, the first byte is the address of the TSS463C register to be accessed
+    bool answered = true;
     res = spi_transfer(address);
     if (res != ADDR_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ max speed (8 clocks XTAL)
+        answered = false;
+    TSS463_WAIT_NS(TSS463_ADDRESS_GAP_NS);//8 clocks XTAL
 
     //The next byte transmitted is the control byte that determines the direction of the communication
-    res = spi_transfer(WRITE);
+    res = spi_transfer(control);
     if (res != CMD_ANSW)
-        error++;
-    delayMicroseconds(4);//at 8MHZ max speed (15 clocks XTAL)
+        answered = false;
+    TSS463_WAIT_NS(TSS463_CONTROL_GAP_NS);//15 clocks XTAL
 
-    spi_transfer(value);
-    delayMicroseconds(3);//at 8MHZ max speed (12 clocks XTAL)
+    // a frame which is answered ends the run of failed handshakes
+    if (answered)
+    {
+        error = 0;
+    }
+    else
+    {
+        error++;
+        _spiStats.HandshakeErrors++;
+    }
 
-    TSS463_UNSELECT();
+    _frameControl = control;
+    if (control == WRITE)
+    {
+        _spiStats.FramesWritten++;
+    }
+    else
+    {
+        _spiStats.FramesRead++;
+    }
 }
 
-void TSS463_VAN::registers_set(uint8_t address, const uint8_t values[], uint8_t count)
+/*
+    Transfers a data byte inside an already opened SPI frame
+*/
+uint8_t TSS463_VAN::frame_transfer(uint8_t data)
 {
-    uint8_t i;
-    uint8_t res = 0;
+    uint8_t res = spi_transfer(data);
+    TSS463_WAIT_NS(TSS463_DATA_GAP_NS);//12 clocks XTAL
 
-    TSS463_SELECT();
+    if (_frameControl == WRITE)
+    {
+        _spiStats.BytesWritten++;
+    }
+    else
+    {
+        _spiStats.BytesRead++;
+    }
+    return res;
+}
 
-    delayMicroseconds(1);//at 8MHZ max speed (4 clocks XTAL)
+/*
+    Closes the SPI frame opened by frame_begin
+    After too many frames in a row without the 0xAA, 0x55 answer a resync is requested, it is not run here as the frame may be one of
+    several frames of an operation (a read and the reactivation of a channel, a poll and its reads...)
+*/
+void TSS463_VAN::frame_end()
+{
+    _transport->unselect();
 
-    //At the beginning of a transmission over the serial interface, the first byte is the address of the TSS463C register to be accessed
-    res = spi_transfer(address);
-    if (res != ADDR_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ max speed (8 clocks XTAL)
+    if (_resyncThreshold != 0 && error >= _resyncThreshold)
+    {
+        _resyncPending = true;
+    }
+}
 
-    //The next byte transmitted is the control byte that determines the direction of the communication
-    res = spi_transfer(WRITE);
-    if (res != CMD_ANSW)
-    error++;
-    delayMicroseconds(4);//at 8MHZ max speed (15 clocks XTAL)
+/*
+    Runs the resync requested by frame_end. Called first by the entry points which start a new operation (process, receive,
+    service_interrupt, poll_all_channels, message_available), a failed resync stays requested and is retried by the next one:
+    the circuit may answer again after a brown-out but with its registers reset
+*/
+void TSS463_VAN::resync_if_pending()
+{
+    if (_resyncPending)
+    {
+        resync();
+    }
+}
+
+/*
+    Writes the values into consecutive registers in a single SPI frame
+*/
+void TSS463_VAN::write_frame(uint8_t address, const uint8_t values[], uint8_t count)
+{
+    frame_begin(address, WRITE);
 
-    for (i = 0; i < count; i++)
+    for (uint8_t i = 0; i < count; i++)
     {
-        spi_transfer(values[i]);
-        delayMicroseconds(3);//at 8MHZ max speed (12 clocks XTAL)
+        frame_transfer(values[i]);
     }
 
-    TSS463_UNSELECT();
+    frame_end();
 }
 
-uint8_t TSS463_VAN::register_get(uint8_t address)
+void TSS463_VAN::register_set(uint8_t address, uint8_t value)
 {
-    uint8_t value;
+    registers_set(address, &value, 1);
+}
 
-    TSS463_SELECT();
+/*
+    Writes the values into consecutive registers
+    With the shadow copy (TSS463_SHADOW_REGISTERS, or TSS463_SHADOW_MAILBOX for the Message DATA RAM only) only the changed bytes are written,
+    close runs of changed bytes are merged into one SPI frame
+*/
+void TSS463_VAN::registers_set(uint8_t address, const uint8_t values[], uint8_t count)
+{
+#if TSS463_SHADOW_ENABLED
+    uint8_t i = 0;
+    while (i < count)
+    {
+        while (i < count && !is_dirty(address + i, values[i]))
+        {
+            i++;
+        }
+        if (i == count)
+        {
+            break;
+        }
+
+        uint8_t start = i;
+        uint8_t end = i + 1;
+        uint8_t unchanged = 0;
+        for (i = i + 1; i < count; i++)
+        {
+            if (is_dirty(address + i, values[i]))
+            {
+                end = i + 1;
+                unchanged = 0;
+            }
+            else if (++unchanged > _shadowGapMerge)
+            {
+                break;
+            }
+        }
+
+        write_frame(address + start, &values[start], end - start);
+        shadow_update(address + start, &values[start], end - start);
+        i = end;
+    }
+#else
+    write_frame(address, values, count);
+#endif
+}
 
-    delayMicroseconds(1);//at 8MHZ max speed (4 clocks XTAL)
+/*
+    Writes the values into consecutive registers in a single SPI frame, without skipping the bytes the shadow registers know
+    Used for the large writes where one frame is cheaper than several frames for the changed bytes only
+*/
+void TSS463_VAN::registers_burst(uint8_t address, const uint8_t values[], uint8_t count)
+{
+    write_frame(address, values, count);
+#if TSS463_SHADOW_ENABLED
+    shadow_update(address, values, count);
+#endif
+}
 
-    //At the beginning of a transmission over the serial interface, the first byte is the address of the TSS463C register to be accessed
-    value = spi_transfer(address);
-    if (value != ADDR_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ max speed (8 clocks XTAL)
+/*
+    Writes the values inside the SPI frame opened by frame_begin(..., WRITE), address is the register the first value goes to
+    Lets a burst be streamed piece by piece without building the whole image in RAM
+*/
+void TSS463_VAN::burst_transfer(uint8_t address, const uint8_t values[], uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        frame_transfer(values[i]);
+    }
+#if TSS463_SHADOW_ENABLED
+    shadow_update(address, values, count);
+#else
+    (void)address;
+#endif
+}
 
-    //The next byte transmitted is the control byte that determines the direction of the communication
-    value = spi_transfer(READ);
-    if (value != CMD_ANSW)
-        error++;
-    delayMicroseconds(4);//at 8MHZ max speed (15 clocks XTAL)
+uint8_t TSS463_VAN::register_get(uint8_t address)
+{
+    uint8_t value;
 
-    //When the master (CPU) conducts a read, it sends an address byte, a control byte and dummy characters (0xFF for instance) on its MOSI line
-    value = spi_transfer(0xff);
-    delayMicroseconds(3);//at 8MHZ max speed (12 clocks XTAL)
+    frame_begin(address, READ);
 
+    //When the master (CPU) conducts a read, it sends an address byte, a control byte and dummy characters (0xFF for instance) on its MOSI line
+    value = frame_transfer(0xff);
 
-    TSS463_UNSELECT();
+    frame_end();
 
     return value;
 }
 
 uint8_t TSS463_VAN::registers_get(uint8_t address, volatile uint8_t values[], uint8_t count)
 {
-    uint8_t value;
-
-    TSS463_SELECT();
-
-    delayMicroseconds(1);//at 8MHZ max speed (4 clocks XTAL)
-
-    //At the beginning of a transmission over the serial interface, the first byte is the address of the TSS463C register to be accessed
-    value = spi_transfer(address);
-    if (value != ADDR_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ max speed (8 clocks XTAL)
-
-    //The next byte transmitted is the control byte that determines the direction of the communication
-    value = spi_transfer(READ);
-    if (value != CMD_ANSW)
-        error++;
-    delayMicroseconds(4);//at 8MHZ max speed (15 clocks XTAL)
+    frame_begin(address, READ);
 
     //When the master (CPU) conducts a read, it sends an address byte, a control byte and dummy characters (0xFF for instance) on its MOSI line
 
     // TSS463 has auto-increment of address-pointer
     for (uint8_t i = 0; i < count; i++)
     {
-        values[i] = spi_transfer(0xff);
-        delayMicroseconds(3);//at 8MHZ max speed (12 clocks XTAL)
+        values[i] = frame_transfer(0xff);
     }
 
-    TSS463_UNSELECT();
+#if TSS463_SHADOW_ENABLED
+    // values read without the 0xAA, 0x55 answer are not kept
+    bool answered = error == 0;
+#endif
 
-    return value;
+    frame_end();
+
+#if TSS463_SHADOW_ENABLED
+    if (answered)
+    {
+        shadow_update(address, values, count);
+    }
+#endif
+
+    return count;
 }
 
-void TSS463_VAN::motorolla_mode()
+/*
+    Sends the initialization sequence (0x00, 0x00), returns true if the TSS463C answered it with 0xAA, 0x55
+*/
+bool TSS463_VAN::motorolla_mode()
 {
     uint8_t value;
+    bool answered = true;
 
-    TSS463_SELECT();
+    _transport->select();
 
-    delayMicroseconds(1);//at 8MHZ SCLK speed (4 clocks XTAL)
+    TSS463_WAIT_NS(TSS463_LEAD_GAP_NS);//4 clocks XTAL
     value = spi_transfer(MOTOROLA_MODE);
     if (value != ADDR_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ SCLK speed (8 clocks SCLK)
+        answered = false;
+    TSS463_WAIT_NS(TSS463_ADDRESS_GAP_NS);//8 clocks XTAL
     value = spi_transfer(MOTOROLA_MODE);
     if (value != CMD_ANSW)
-        error++;
-    delayMicroseconds(2);//at 8MHZ max speed (8 clocks SCLK)
+        answered = false;
+    TSS463_WAIT_NS(TSS463_ADDRESS_GAP_NS);//8 clocks XTAL
+
+    frame_end();
+
+#if TSS463_SHADOW_ENABLED
+    // the initialization sequence resets the TSS463C, the shadow copy is kept while it does not answer so resync can restore the data
+    if (answered)
+    {
+        shadow_invalidate(TSS463_SHADOW_START, TSS463_SHADOW_SIZE - 1);
+        shadow_invalidate(0xFF, 1);
+    }
+#endif
+
+    return answered;
+}
+
+#if TSS463_SHADOW_ENABLED
+/*
+    Checks whether an address can be changed by the TSS463C itself, these are never taken from the shadow copy:
+    - the control and status registers
+    - the Message Length and Status Register of the channels (CHER, CHTx, CHRx)
+    - the ID_TAG registers of the receiving channels which accept more than one identifier (the received identifier is written there)
+    - the message status byte of the buffers and the whole buffer of the receiving channels
+*/
+bool TSS463_VAN::is_volatile_address(uint8_t address)
+{
+    if (address < TSS463_SHADOW_START)
+    {
+        return true;
+    }
+
+    if (address < GETMAIL(0))
+    {
+        uint8_t channelId = (address - CHANNEL_ADDR(0)) / 8;
+        uint8_t offset = (address - CHANNEL_ADDR(0)) % 8;
+
+        if (offset == 3)
+        {
+            return true;
+        }
+        if (offset <= 1)
+        {
+            return !channels[channelId].IsOccupied || (channels[channelId].IdentifierMask != 0xFFF && is_receiving_channel(channelId));
+        }
+        return false;
+    }
+
+    uint8_t location = address - GETMAIL(0);
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (channels[i].IsOccupied && location >= channels[i].MemoryLocation && location < channels[i].MemoryLocation + channels[i].MemorySize)
+        {
+            return location == channels[i].MemoryLocation || is_receiving_channel(i);
+        }
+    }
+    return false;
+}
+
+/*
+    Checks whether a value has to be written into the TSS463C
+*/
+bool TSS463_VAN::is_dirty(uint8_t address, uint8_t value)
+{
+    if (is_volatile_address(address))
+    {
+        return true;
+    }
+
+    uint8_t index = address - TSS463_SHADOW_START;
+    return !(_shadowValid[index / 8] & (1 << (index % 8))) || _shadow[index] != value;
+}
+
+/*
+    Stores the values which were written into or read from the TSS463C
+*/
+void TSS463_VAN::shadow_update(uint8_t address, const volatile uint8_t values[], uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t current = address + i;
+        if (current < TSS463_SHADOW_START)
+        {
+            continue;
+        }
+
+        uint8_t index = current - TSS463_SHADOW_START;
+        if (is_volatile_address(current))
+        {
+            _shadowValid[index / 8] &= ~(1 << (index % 8));
+        }
+        else
+        {
+            _shadow[index] = values[i];
+            _shadowValid[index / 8] |= (1 << (index % 8));
+        }
+    }
+}
 
-    TSS463_UNSELECT();
+/*
+    Forgets the shadow copy of an address range, the next write will be sent to the TSS463C
+*/
+void TSS463_VAN::shadow_invalidate(uint8_t address, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t index = address + i - TSS463_SHADOW_START;
+        _shadowValid[index / 8] &= ~(1 << (index % 8));
+    }
 }
+#endif
+
+/*
+    Register values of a disabled channel
+    ID_TAG = 0, ID_TAG / CMD = 0, MESS_PTR = 0 (0x80 + 0), M_L [4:0] = 1, CHER = 1, CHTx = 1, CHRx = 1 (inactive), ID_MASK = 0
+*/
+static const uint8_t DISABLED_CHANNEL[8] = { 0x00, 0x00, 0x00, 0x0F, 0x00, 0x00, 0x00, 0x00 };
 
+/*
+    Disables a channel and releases its memory in the Message DATA RAM, so it can be set up again for any identifier
+*/
 void TSS463_VAN::disable_channel(uint8_t channelId)
 {
-    register_set(CHANNEL_ADDR(channelId) + 0, 0x00);  //  ID_TAG 9C4 - Radio Control
-    register_set(CHANNEL_ADDR(channelId) + 1, 0x00);  //  ID_TAG, RNW = 0, RTR = 1
-    register_set(CHANNEL_ADDR(channelId) + 2, 0x00);  //  MESS_PTR 0 ( 0x80 + 0) - MAILBOX ADDRESS
-    register_set(CHANNEL_ADDR(channelId) + 3, 0x0F);  //  M_L [4:0] = 0x1F Frame with 30 DATA bytes , CHER = 0, CHTx = 0, CHRx = 0
-    register_set(CHANNEL_ADDR(channelId) + 6, 0x00);  //  ID_MASK 9C4
-    register_set(CHANNEL_ADDR(channelId) + 7, 0x00);  //  ID_MASK
+    if (channelId >= CHANNELS)
+    {
+        return;
+    }
+
+    // all the registers of the channel in one SPI frame (offset 0x04 and 0x05 are not registers, writing them has no effect)
+    registers_set(CHANNEL_ADDR(channelId), DISABLED_CHANNEL, 8);
     channels[channelId].IsOccupied = false;
+    _awaitingAck &= ~(1 << channelId);
+    _heldByRing &= ~(1 << channelId);
 }
 
-void TSS463_VAN::setup_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus)
+void TSS463_VAN::setup_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus, uint16_t identifierMask)
 {
     /*
     :...............:........:.......:.......:.......:.......:.......:.......:.......:.......:
@@ -344,36 +630,202 @@ void TSS463_VAN::setup_channel(uint8_t channelId, uint16_t identifier, uint8_t i
     :ID_TAG         :  0x00  :                         ID_T [11:4]                           :
     :...............:........:...............................................................:
     */
-    uint8_t data[] = { id1, id2AndCommand, messagePointer, lengthAndStatus, 0, 0, id1, id2 };
+    uint8_t data[8];
+
+#if TSS463_SHADOW_ENABLED
+    // the TSS463C may have written into the buffer of a receiving channel
+    if (channels[channelId].IsOccupied && is_receiving_channel(channelId))
+    {
+        shadow_invalidate(GETMAIL(channels[channelId].MemoryLocation), channels[channelId].MemorySize);
+    }
+#endif
 
+    prepare_channel(channelId, identifier, id1, id2AndCommand, messagePointer, lengthAndStatus, identifierMask, data);
     registers_set(CHANNEL_ADDR(channelId), data, 8);
+}
+
+/*
+    Stores the setup of a channel and fills the values of its 8 registers
+    The channel setup has to be known before writing, it tells which registers are changed by the TSS463C
+*/
+void TSS463_VAN::prepare_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus, uint16_t identifierMask, uint8_t data[])
+{
+    if (identifierMask == TSS463_MASK_FROM_IDENTIFIER)
+    {
+        // the bits of ID_T[11:4] which are set in the identifier are compared, so identifier 0x000 accepts every frame
+        identifierMask = identifier & 0xFF0;
+    }
 
     channels[channelId].MessageLengthAndStatusRegisterValue = lengthAndStatus;
+    channels[channelId].Id2AndCommandRegisterValue = id2AndCommand;
+    channels[channelId].MessagePointerRegisterValue = messagePointer;
     channels[channelId].IsOccupied = true;
     channels[channelId].Identifier = identifier;
+    channels[channelId].IdentifierMask = identifierMask;
+    _awaitingAck &= ~(1 << channelId);
+    _heldByRing &= ~(1 << channelId);
+    mark_armed(channelId);
+
+    data[0] = id1;
+    data[1] = id2AndCommand;
+    data[2] = messagePointer;
+    data[3] = lengthAndStatus;
+    data[4] = 0;
+    data[5] = 0;
+    data[6] = identifierMask >> 4;
+    data[7] = (identifierMask & 0x0F) << 4;
 }
 
 /*
-    Gets the next memory address which is available
+    Gets the memory address of the buffer of a channel in the Message DATA RAM
+    An occupied channel keeps its buffer if the message fits in it, otherwise a new area is allocated
+    A message longer than 30 bytes does not fit the M_L[4:0] field of the channel (31 with the message status), it gets no buffer
 */
 uint8_t TSS463_VAN::get_memory_address_to_use(uint8_t channelId, uint8_t messageLength)
 {
-    if (channels[channelId].IsOccupied)
+    if (messageLength > TSS463_MAX_DATA_LENGTH)
+    {
+        return NOT_ENOUGH_MEMORY_FOR_DATA;
+    }
+
+    // the first byte of the buffer is the message status (Page 42), the data follows it
+    uint8_t size = messageLength + 1;
+
+    if (channels[channelId].IsOccupied && channels[channelId].MemorySize >= size)
     {
         return channels[channelId].MemoryLocation;
     }
 
-    uint8_t result = next_free_memory_address;
-    if (next_free_memory_address + messageLength <= TSS463C_RAM_SIZE_IN_BYTES - 1)
+    // a released channel gets its previous buffer back if nobody took it, so its message pointer does not change
+    if (!channels[channelId].IsOccupied && channels[channelId].MemorySize >= size &&
+        is_memory_free(channelId, channels[channelId].MemoryLocation, channels[channelId].MemorySize))
     {
-        channels[channelId].MemoryLocation = next_free_memory_address;
-        next_free_memory_address = next_free_memory_address + messageLength;
+#if TSS463_SHADOW_ENABLED
+        if (is_receiving_channel(channelId))
+        {
+            shadow_invalidate(GETMAIL(channels[channelId].MemoryLocation), channels[channelId].MemorySize);
+        }
+#endif
+        return channels[channelId].MemoryLocation;
+    }
 
-        return result;
+    uint8_t result = find_free_memory(channelId, size);
+    if (result != NOT_ENOUGH_MEMORY_FOR_DATA)
+    {
+        channels[channelId].MemoryLocation = result;
+        channels[channelId].MemorySize = size;
+#if TSS463_SHADOW_ENABLED
+        // the area may contain data received by the previous owner
+        shadow_invalidate(GETMAIL(result), size);
+#endif
+    }
+    return result;
+}
+
+/*
+    Finds the first free area with the given size in the Message DATA RAM, the buffers of the occupied channels (except the given one) are considered as used
+*/
+uint8_t TSS463_VAN::find_free_memory(uint8_t channelId, uint8_t size)
+{
+    uint16_t candidate = 0;
+
+    while (candidate + size <= TSS463C_RAM_SIZE_IN_BYTES)
+    {
+        uint16_t next = candidate;
+
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (i == channelId || !channels[i].IsOccupied)
+            {
+                continue;
+            }
+
+            uint16_t start = channels[i].MemoryLocation;
+            uint16_t end = start + channels[i].MemorySize;
+            if (candidate < end && start < candidate + size && end > next)
+            {
+                next = end;
+            }
+        }
+
+        if (next == candidate)
+        {
+            return candidate;
+        }
+        candidate = next;
     }
+
     return NOT_ENOUGH_MEMORY_FOR_DATA;
 }
 
+/*
+    Checks whether an area of the Message DATA RAM is not used by the buffers of the occupied channels (except the given one)
+*/
+bool TSS463_VAN::is_memory_free(uint8_t channelId, uint8_t location, uint8_t size)
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (i == channelId || !channels[i].IsOccupied)
+        {
+            continue;
+        }
+
+        if (location < channels[i].MemoryLocation + channels[i].MemorySize && channels[i].MemoryLocation < location + size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Moves the buffers of the occupied channels to the beginning of the Message DATA RAM to merge the free areas and rewrites their message pointers
+    The content of the buffers is kept. It should be called when there is no transmission or reception in progress on the channels (Page 31)
+    Returns the size of the free area at the end of the Message DATA RAM
+*/
+uint8_t TSS463_VAN::compact_memory()
+{
+    uint8_t cursor = 0;
+
+    while (true)
+    {
+        uint8_t channelId = TSS463_NO_CHANNEL;
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (channels[i].IsOccupied && channels[i].MemoryLocation >= cursor &&
+                (channelId == TSS463_NO_CHANNEL || channels[i].MemoryLocation < channels[channelId].MemoryLocation))
+            {
+                channelId = i;
+            }
+        }
+
+        if (channelId == TSS463_NO_CHANNEL)
+        {
+            break;
+        }
+
+        if (channels[channelId].MemoryLocation != cursor)
+        {
+            uint8_t buffer[TSS463_MAX_DATA_LENGTH + 1];
+            registers_get(GETMAIL(channels[channelId].MemoryLocation), buffer, channels[channelId].MemorySize);
+            registers_set(GETMAIL(cursor), buffer, channels[channelId].MemorySize);
+
+            //Page38
+            MessagePointerRegister messagePointer;
+            messagePointer.Value = channels[channelId].MessagePointerRegisterValue;
+            messagePointer.data.M_P = cursor;
+            register_set(CHANNEL_ADDR(channelId) + 2, messagePointer.Value);
+
+            channels[channelId].MessagePointerRegisterValue = messagePointer.Value;
+            channels[channelId].MemoryLocation = cursor;
+        }
+
+        cursor += channels[channelId].MemorySize;
+    }
+
+    return TSS463C_RAM_SIZE_IN_BYTES - cursor;
+}
+
 /*
     Checks whether a channel exists and available
 */
@@ -394,32 +846,210 @@ bool TSS463_VAN::is_valid_channel(uint8_t channelId, uint16_t identifier)
 }
 
 /*
-    Resets all channels to their initial states
+    Releases a channel without writing the TSS463C, so it can be set up again for any identifier (its buffer is kept if it is still free then)
+    The channel should be inactive: the transmission or the reception is completed (CHTx or CHRx set)
 */
-void TSS463_VAN::reset_channels()
+void TSS463_VAN::release_channel(uint8_t channelId)
 {
-    for (uint8_t i = 0; i < CHANNELS; i++) {
-        disable_channel(i);
+    if (channelId < CHANNELS)
+    {
+        channels[channelId].IsOccupied = false;
+        _awaitingAck &= ~(1 << channelId);
     }
-    next_free_memory_address = 0;
 }
 
 /*
-    Activates a channel which was previously set by one of the set_channel_ prefixed methods
+    Sets up a channel from a descriptor (see VanMessage), the register values were computed at compile time so they are written as they are
+    The data is written for the message types which send data (transmit, immediate and deferred reply), otherwise values is not used
 */
-bool TSS463_VAN::reactivate_channel(uint8_t channelId)
+bool TSS463_VAN::set_channel(uint8_t channelId, const VanMessageDescriptor& message, const uint8_t values[])
 {
-    if (channels[channelId].IsOccupied)
+    if (!is_valid_channel(channelId, message.Identifier) || (message.HasData && values == NULL && message.Length > 0))
     {
-        register_set(CHANNEL_ADDR(channelId) + 3, channels[channelId].MessageLengthAndStatusRegisterValue);
-        return true;
+        return false;
     }
-    return false;
+
+    uint8_t memory_address = get_memory_address_to_use(channelId, message.Length);
+    if (memory_address == NOT_ENOUGH_MEMORY_FOR_DATA)
+    {
+        return false;
+    }
+
+    if (message.HasData)
+    {
+        registers_set(GETMAIL(memory_address + 1), values, message.Length);
+    }
+    setup_channel(channelId, message.Identifier, message.Id1, message.Id2AndCommand, message.MessagePointer | memory_address, message.LengthAndStatus, message.IdentifierMask);
+
+    return true;
 }
 
 /*
-        Transmit Message structure: (Page 44)
-......................................................
+    Sets which bits of the identifier are compared when a channel receives a frame (bit = 1: compared, ID_MASK Page 37)
+    0xFFF accepts only the identifier of the channel, 0x000 accepts every identifier. The identifier of a frame received on
+    a channel with a partial mask is read back from the channel registers by read_message
+*/
+bool TSS463_VAN::set_channel_mask(uint8_t channelId, uint16_t identifierMask)
+{
+    if (channelId >= CHANNELS || !channels[channelId].IsOccupied)
+    {
+        return false;
+    }
+    if (identifierMask == TSS463_MASK_FROM_IDENTIFIER)
+    {
+        identifierMask = channels[channelId].Identifier & 0xFF0;
+    }
+
+    uint8_t data[] = { (uint8_t)(identifierMask >> 4), (uint8_t)((identifierMask & 0x0F) << 4) };
+    channels[channelId].IdentifierMask = identifierMask;
+    registers_set(CHANNEL_ADDR(channelId) + 6, data, 2);
+    return true;
+}
+
+/*
+    Checks whether a channel was set up by one of the set_channel_ prefixed methods (and not disabled since)
+*/
+bool TSS463_VAN::is_channel_occupied(uint8_t channelId)
+{
+    return channelId < CHANNELS && channels[channelId].IsOccupied;
+}
+
+/*
+    Resets all channels to their initial states, their memory in the Message DATA RAM is released
+*/
+void TSS463_VAN::reset_channels()
+{
+    uint8_t data[CHANNELS * 8];
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+        memcpy(&data[i * 8], DISABLED_CHANNEL, 8);
+        channels[i].IsOccupied = false;
+    }
+    _awaitingAck = 0;
+    _heldByRing = 0;
+    _pendingChannels = 0;
+    // the registers of all the channels in one SPI frame
+    registers_burst(CHANNEL_ADDR(0), data, sizeof(data));
+}
+
+/*
+    Sets up every channel and the Message DATA RAM from the plan in one SPI frame (0x10 - 0xFF using the address auto-increment)
+    The channels which are not in the plan are disabled, the buffers are placed one after the other and the rest of the RAM is zeroed.
+    Returns false without writing anything if a channel is invalid or used twice, a message has no data or the buffers do not fit in the RAM
+*/
+bool TSS463_VAN::configure(const ChannelPlan& plan)
+{
+    uint16_t used = 0;
+    uint16_t size = 0;
+    for (uint8_t i = 0; i < plan.Count; i++)
+    {
+        const ChannelPlanEntry* entry = &plan.Entries[i];
+        if (entry->Channel >= CHANNELS || (used & (1 << entry->Channel)) || entry->Message == NULL ||
+            entry->Message->Length > TSS463_MAX_DATA_LENGTH || (entry->Message->HasData && entry->Message->Length > 0 && entry->Values == NULL))
+        {
+            return false;
+        }
+        used |= 1 << entry->Channel;
+        size += entry->Message->Length + 1;
+    }
+    if (size > TSS463C_RAM_SIZE_IN_BYTES)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        channels[i].IsOccupied = false;
+        channels[i].MemorySize = 0;
+    }
+    _awaitingAck = 0;
+    _heldByRing = 0;
+    // the channels found by an earlier interrupt are set up again, their messages are gone
+    _pendingChannels = 0;
+
+    // the buffers one after the other in the order of the plan
+    uint8_t cursor = 0;
+    for (uint8_t i = 0; i < plan.Count; i++)
+    {
+        const ChannelPlanEntry* entry = &plan.Entries[i];
+        channels[entry->Channel].MemoryLocation = cursor;
+        channels[entry->Channel].MemorySize = entry->Message->Length + 1;
+        channels[entry->Channel].RearmPolicy = entry->RearmPolicy;
+        cursor += entry->Message->Length + 1;
+    }
+
+    // streamed in the order of the addresses, one channel or buffer at a time
+    frame_begin(CHANNEL_ADDR(0), WRITE);
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        uint8_t data[8];
+        memcpy(data, DISABLED_CHANNEL, 8);
+        for (uint8_t i = 0; i < plan.Count; i++)
+        {
+            const ChannelPlanEntry* entry = &plan.Entries[i];
+            const VanMessageDescriptor* message = entry->Message;
+            if (entry->Channel == channelId)
+            {
+                prepare_channel(channelId, message->Identifier, message->Id1, message->Id2AndCommand,
+                    message->MessagePointer | channels[channelId].MemoryLocation, message->LengthAndStatus, message->IdentifierMask, data);
+            }
+        }
+        burst_transfer(CHANNEL_ADDR(channelId), data, 8);
+    }
+
+    const uint8_t zero = 0;
+    for (uint8_t i = 0; i < plan.Count; i++)
+    {
+        const ChannelPlanEntry* entry = &plan.Entries[i];
+        const VanMessageDescriptor* message = entry->Message;
+        uint8_t location = channels[entry->Channel].MemoryLocation;
+
+        // message status
+        burst_transfer(GETMAIL(location), &zero, 1);
+        for (uint8_t j = 0; j < message->Length; j++)
+        {
+            burst_transfer(GETMAIL(location + 1 + j), message->HasData ? &entry->Values[j] : &zero, 1);
+        }
+    }
+    // the rest of the RAM is zeroed
+    for (uint8_t i = cursor; i < TSS463C_RAM_SIZE_IN_BYTES; i++)
+    {
+        burst_transfer(GETMAIL(i), &zero, 1);
+    }
+    frame_end();
+    return true;
+}
+
+/*
+    Activates a channel which was previously set by one of the set_channel_ prefixed methods
+*/
+bool TSS463_VAN::reactivate_channel(uint8_t channelId)
+{
+    if (channels[channelId].IsOccupied)
+    {
+        register_set(CHANNEL_ADDR(channelId) + 3, channels[channelId].MessageLengthAndStatusRegisterValue);
+        _awaitingAck &= ~(1 << channelId);
+        mark_armed(channelId);
+        return true;
+    }
+    return false;
+}
+
+/*
+    Sets what happens with a channel after its message was read by read_message, service_interrupt or receive (default: REARM_AFTER_ACK)
+*/
+bool TSS463_VAN::set_rearm_policy(uint8_t channelId, REARM_POLICY policy)
+{
+    if (channelId >= CHANNELS)
+    {
+        return false;
+    }
+    channels[channelId].RearmPolicy = policy;
+    return true;
+}
+
+/*
+        Transmit Message structure: (Page 44)
+......................................................
 :                    : RNW : RTR : CHTx :    CHRx    :
 :....................:.....:.....:......:............:
 : Initial setup      :   0 :   0 :    0 : Don't care :
@@ -466,7 +1096,7 @@ bool TSS463_VAN::set_channel_for_transmit_message(uint8_t channelId, uint16_t id
         uint8_t addressOfDataToSendOnVAN = GETMAIL(messagePointer.data.M_P + 1);
         registers_set(addressOfDataToSendOnVAN, values, messageLength);
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
 
         return true;
     }
@@ -483,7 +1113,7 @@ bool TSS463_VAN::set_channel_for_transmit_message(uint8_t channelId, uint16_t id
 : After transmission :   0 :   1 : Unchanged  :    1 :
 :....................:.....:.....:......:............:
 */
-bool TSS463_VAN::set_channel_for_receive_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint8_t setAck)
+bool TSS463_VAN::set_channel_for_receive_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint8_t setAck, uint16_t identifierMask)
 {
     if (!is_valid_channel(channelId, identifier))
     {
@@ -520,7 +1150,7 @@ bool TSS463_VAN::set_channel_for_receive_message(uint8_t channelId, uint16_t ide
         lengthAndStatus.data.CHTx = 0;
         lengthAndStatus.data.M_L = messageLength + 1;
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value, identifierMask);
 
         return true;
     }
@@ -537,7 +1167,7 @@ bool TSS463_VAN::set_channel_for_receive_message(uint8_t channelId, uint16_t ide
 : After transmission :   1 :   1 : Unchanged  :    1 :
 :....................:.....:.....:......:............:
 */
-bool TSS463_VAN::set_channel_for_reply_request_message_without_transmission(uint8_t channelId, uint16_t identifier, uint8_t messageLength)
+bool TSS463_VAN::set_channel_for_reply_request_message_without_transmission(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint16_t identifierMask)
 {
     if (!is_valid_channel(channelId, identifier))
     {
@@ -574,7 +1204,7 @@ bool TSS463_VAN::set_channel_for_reply_request_message_without_transmission(uint
         lengthAndStatus.data.CHTx = 0;
         lengthAndStatus.data.M_L = messageLength + 1;
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value, identifierMask);
 
         return true;
     }
@@ -629,7 +1259,7 @@ bool TSS463_VAN::set_channel_for_reply_request_message(uint8_t channelId, uint16
         lengthAndStatus.data.CHTx = 0;
         lengthAndStatus.data.M_L = messageLength + 1;
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
 
         return true;
     }
@@ -686,7 +1316,7 @@ bool TSS463_VAN::set_channel_for_immediate_reply_message(uint8_t channelId, uint
         uint8_t addressOfDataToSendOnVAN = GETMAIL(messagePointer.data.M_P + 1);
         registers_set(addressOfDataToSendOnVAN, values, messageLength);
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
 
         return true;
     }
@@ -743,7 +1373,7 @@ bool TSS463_VAN::set_channel_for_deferred_reply_message(uint8_t channelId, uint1
         uint8_t addressOfDataToSendOnVAN = GETMAIL(messagePointer.data.M_P + 1);
         registers_set(addressOfDataToSendOnVAN, values, messageLength);
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
 
         return true;
     }
@@ -760,7 +1390,7 @@ bool TSS463_VAN::set_channel_for_deferred_reply_message(uint8_t channelId, uint1
 : After transmission                  :   1 :   0 : 1          :    1 :
 :.....................................:.....:.....:......:............:
 */
-bool TSS463_VAN::set_channel_for_reply_request_detection_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength)
+bool TSS463_VAN::set_channel_for_reply_request_detection_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint16_t identifierMask)
 {
     if (!is_valid_channel(channelId, identifier))
     {
@@ -797,7 +1427,7 @@ bool TSS463_VAN::set_channel_for_reply_request_detection_message(uint8_t channel
         lengthAndStatus.data.CHTx = 1;
         lengthAndStatus.data.M_L = messageLength + 1;
 
-        setup_channel(channelId, identifier, id1, id2, id2Command.Value, messagePointer.Value, lengthAndStatus.Value);
+        setup_channel(channelId, identifier, id1, id2Command.Value, messagePointer.Value, lengthAndStatus.Value, identifierMask);
 
         return true;
     }
@@ -806,61 +1436,330 @@ bool TSS463_VAN::set_channel_for_reply_request_detection_message(uint8_t channel
 }
 
 /*
-    Checks if a message is available in a channel
+    Checks if a message is available in a channel, nothing is reported when the TSS463C did not answer the frame
 */
 MessageLengthAndStatusRegister TSS463_VAN::message_available(uint8_t channelId)
 {
+    resync_if_pending();
+
     MessageLengthAndStatusRegister lengthAndStatus;
     memset(&lengthAndStatus, 0, sizeof(lengthAndStatus));
     lengthAndStatus.Value = register_get(CHANNEL_ADDR(channelId) + 3);
+    // without the 0xAA, 0x55 answer the byte read is not the register (0xFF during a brown-out would look like a completion)
+    if (error != 0)
+    {
+        lengthAndStatus.Value = 0;
+    }
+    else if (channelId < CHANNELS)
+    {
+        observe(channelId, lengthAndStatus, _clock());
+    }
 
     return lengthAndStatus;
 }
 
+// SPI bus time of a frame reading one status register, of the start of a burst and of every byte of the burst
+static const uint32_t STATUS_FRAME_NS = tss463_spi_time_ns(1, 3);
+static const uint32_t BURST_START_NS = tss463_spi_time_ns(1, 2);
+static const uint32_t BURST_BYTE_NS = TSS463_SPI_BYTE_NS + TSS463_DATA_GAP_NS;
+
 /*
-    Reads a message from a channel
+    Reads the status register of every occupied channel, in a single SPI frame using the address auto-increment over the channel registers,
+    or in one short frame per occupied channel when that takes less time (SPI bus time plus the frame overhead, see set_frame_overhead)
+    Returns a bitmap of the channels where a message was received or transmitted (CHRx or CHTx set), bit n belongs to channel n,
+    none when the TSS463C did not answer a frame of the poll. A resync requested by frame_end runs first
+*/
+uint16_t TSS463_VAN::poll_all_channels(MessageLengthAndStatusRegister statuses[])
+{
+    resync_if_pending();
+    return poll_channels(statuses);
+}
+
+/*
+    The poll of poll_all_channels, also used inside the operations which must not be cut by a resync
 */
-void TSS463_VAN::read_message(uint8_t channelId, uint8_t*length, uint8_t buffer[])
+uint16_t TSS463_VAN::poll_channels(MessageLengthAndStatusRegister statuses[])
 {
-    uint8_t id1 = register_get(CHANNEL_ADDR(channelId) + 0);
-    uint8_t id2 = register_get(CHANNEL_ADDR(channelId) + 1);
-    uint8_t messageStatusLocationInMemory = ExtractBits(register_get(CHANNEL_ADDR(channelId) + 2), 7, 1); //exclude DRAK bit
+    uint8_t firstChannel = CHANNELS;
+    uint8_t lastChannel = 0;
+    uint8_t occupied = 0;
+    uint16_t result = 0;
+
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (statuses != NULL)
+        {
+            statuses[i].Value = 0;
+        }
+        if (channels[i].IsOccupied)
+        {
+            if (firstChannel == CHANNELS)
+            {
+                firstChannel = i;
+            }
+            lastChannel = i;
+            occupied++;
+        }
+    }
+
+    if (firstChannel == CHANNELS)
+    {
+        return result;
+    }
+
+    uint8_t count = (lastChannel - firstChannel) * 8 + 1;
+    uint8_t values[CHANNELS];
+    uint32_t handshakeErrors = _spiStats.HandshakeErrors;
+
+    // the burst also reads the 7 other registers of every channel in between
+    if (occupied * (STATUS_FRAME_NS + _frameOverheadNs) < BURST_START_NS + _frameOverheadNs + count * BURST_BYTE_NS)
+    {
+        for (uint8_t channelId = firstChannel; channelId <= lastChannel; channelId++)
+        {
+            if (channels[channelId].IsOccupied)
+            {
+                values[channelId] = register_get(CHANNEL_ADDR(channelId) + 3);
+            }
+        }
+    }
+    else
+    {
+        frame_begin(CHANNEL_ADDR(firstChannel) + 3, READ);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            uint8_t value = frame_transfer(0xff);
+
+            // only the Message Length and Status Register (offset 0x03) of each channel is needed
+            if (i % 8 == 0)
+            {
+                values[firstChannel + i / 8] = value;
+            }
+        }
+        frame_end();
+    }
+
+    // a frame without the 0xAA, 0x55 answer did not read the registers, no channel is reported
+    if (_spiStats.HandshakeErrors != handshakeErrors)
+    {
+        return result;
+    }
+
+    // one timestamp for every channel completed at the time of the read
+    uint32_t now = _clock();
+
+    for (uint8_t channelId = firstChannel; channelId <= lastChannel; channelId++)
+    {
+        if (!channels[channelId].IsOccupied)
+        {
+            continue;
+        }
+
+        MessageLengthAndStatusRegister lengthAndStatus;
+        lengthAndStatus.Value = values[channelId];
+        if (statuses != NULL)
+        {
+            statuses[channelId] = lengthAndStatus;
+        }
+        if (lengthAndStatus.data.CHRx || lengthAndStatus.data.CHTx)
+        {
+            result |= (1 << channelId);
+            observe(channelId, lengthAndStatus, now);
+        }
+    }
+
+    return result;
+}
+
+/*
+    Sets the time the microcontroller needs to open and close an SPI frame (see TSS463_FRAME_OVERHEAD_NS)
+    With 0 only the SPI bus time counts, and one short frame per channel is always shorter than a burst over two channels or more.
+    With the default of AVR (20 us) the burst is shorter when there is no free channel between the occupied ones (like the channels 0 - 3 of the monitor example)
+*/
+void TSS463_VAN::set_frame_overhead(uint32_t ns)
+{
+    _frameOverheadNs = ns;
+}
+
+/*
+    Reads the identifier bytes, the message status and the data of a channel
+    The identifier comes from the cached channel setup when the channel accepts only one identifier, the message status and the data
+    are read in a single SPI frame straight into the data array
+*/
+MessageStatusRegister TSS463_VAN::read_channel(uint8_t channelId, uint8_t idBytes[], uint8_t data[], uint8_t maxLength, uint8_t* dataLength)
+{
+    MessageStatusRegister messageStatus;
+    messageStatus.Value = 0;
+    *dataLength = 0;
+
+    if (channelId >= CHANNELS || !channels[channelId].IsOccupied)
+    {
+        return messageStatus;
+    }
+
+    if (channels[channelId].IdentifierMask == 0xFFF)
+    {
+        uint8_t id2;
+        GetBytesFromIdentifier(channels[channelId].Identifier, &idBytes[0], &id2);
+        idBytes[1] = channels[channelId].Id2AndCommandRegisterValue;
+    }
+    else
+    {
+        // the channel accepts more than one identifier, only the TSS463C knows which one was received
+        registers_get(CHANNEL_ADDR(channelId) + 0, idBytes, 2);
+    }
+
+    MessageLengthAndStatusRegister lengthAndStatus;
+    lengthAndStatus.Value = channels[channelId].MessageLengthAndStatusRegisterValue;
+    uint8_t reservedLength = lengthAndStatus.data.M_L - 1;
+    if (reservedLength > maxLength)
+    {
+        reservedLength = maxLength;
+    }
 
     /*
         Message Status(Pointed by : Message Pointer Register)
         ..............................................................
         : RRAK : RRNW : RRTR : RM_L4 : RM_L3 : RM_L2 : RM_L1 : RM_L0 :
         :......:......:......:.......:.......:.......:.......:.......:
-        RRAK: Received RAK Bit:  This bit is the RAK bit coming from the COM field of the received frame.
-        RRNW: Received RNW Bit:  This bit is the RNW bit coming from the COM field of the received frame.
-        RRTR: Received RTR Bit:  This bit is the RTR bit coming from the COM field of the received frame.
-        RM_L[4:0]: Message Length of the Received Frame
-                   If the DATA field of the received frame included DATA0 to DATAn, RM_L[4:0] = n+1, even if the reserved length (Message Length and Status Register) is larger.
+        In the case of a VAN messages RAM read the first data byte sent back by the TSS463C is the data length
+        so the master knows how many dummy characters it must send to read the VAN frame properly (Page 8)
     */
+    frame_begin(GETMAIL(channels[channelId].MemoryLocation), READ);
 
-    uint8_t messageStatusByte = register_get(GETMAIL(messageStatusLocationInMemory));
-    uint8_t messageLength = ExtractBits(messageStatusByte, 5, 1);
-    //messageLength += 2; // + 2 to include CRC in array
-    uint8_t command = ExtractBits(messageStatusByte, 3, 6);
+    messageStatus.Value = frame_transfer(0xff);
+    uint8_t messageLength = messageStatus.data.RM_L;
+    if (messageLength > reservedLength)
+    {
+        messageLength = reservedLength;
+    }
 
-    uint8_t currentData[messageLength];
-    uint8_t memory_address = get_memory_address_to_use(channelId, messageLength);
-    uint8_t addr = GETMAIL(memory_address + 1);
+    for (uint8_t i = 0; i < messageLength; i++)
+    {
+        data[i] = frame_transfer(0xff);
+    }
 
-    uint8_t d = registers_get(addr, currentData, messageLength);
+    frame_end();
 
-    buffer[0] = id1;
-    buffer[1] = id2;
-    //buffer[2] = messageStatusByte; //include message status byte in array
+    *dataLength = messageLength;
 
-    for (uint8_t i = 0; i < messageLength; i++)
+    return messageStatus;
+}
+
+/*
+    Reads a message from a channel
+    The first two bytes of the buffer are the identifier bytes (ID_TAG, ID_TAG/CMD) followed by the data
+*/
+MessageStatusRegister TSS463_VAN::read_message(uint8_t channelId, uint8_t*length, uint8_t buffer[])
+{
+    uint8_t dataLength;
+    MessageStatusRegister messageStatus = read_channel(channelId, &buffer[0], &buffer[2], 30, &dataLength);
+
+    *length = 0;
+    if (channelId < CHANNELS && channels[channelId].IsOccupied)
+    {
+        *length = dataLength + 2;
+        rearm_after_read(channelId);
+    }
+
+    return messageStatus;
+}
+
+/*
+    Checks whether a channel gets data from the bus (see the channel modes on Page 44-45)
+    Transmit, immediate and deferred reply channels only send their own data
+*/
+bool TSS463_VAN::is_receiving_channel(uint8_t channelId)
+{
+    Id2AndCommandRegister id2Command;
+    id2Command.Value = channels[channelId].Id2AndCommandRegisterValue;
+
+    MessageLengthAndStatusRegister lengthAndStatus;
+    lengthAndStatus.Value = channels[channelId].MessageLengthAndStatusRegisterValue;
+
+    // receive, reply request and reply request without transmission
+    if (id2Command.data.RTR == 1)
+    {
+        return true;
+    }
+
+    // reply request detection
+    return id2Command.data.RNW == 1 && lengthAndStatus.data.CHTx == 1 && lengthAndStatus.data.CHRx == 0;
+}
+
+/*
+    Applies the rearm policy of the channel after its message was read
+    The message is in the Message DATA RAM, the status register is in the channel registers, so the reactivation is the next SPI frame after the read
+    A REARM_AFTER_ACK channel keeps CHRx set until reactivate_channel, it is skipped by the polls until then so its message is delivered once
+*/
+void TSS463_VAN::rearm_after_read(uint8_t channelId)
+{
+    switch (channels[channelId].RearmPolicy)
     {
-        buffer[i + 2] = currentData[i];
-        //buffer[i+3] = currentData[i]; //include message status byte in array
+        case REARM_IMMEDIATE:
+            reactivate_channel(channelId);
+            break;
+        case REARM_ONE_SHOT:
+            channels[channelId].IsOccupied = false;
+            _awaitingAck &= ~(1 << channelId);
+            break;
+        case REARM_AFTER_ACK:
+        default:
+            _awaitingAck |= 1 << channelId;
+            break;
     }
+}
 
-    //*length = messageLength + 3; //include message status byte in array
-    *length = messageLength + 2;
+/*
+    The message which was read is not delivered (dropped by the receive filter or without a handler), nobody will acknowledge it:
+    a channel waiting for reactivate_channel is reactivated
+*/
+void TSS463_VAN::skip_ack(uint8_t channelId)
+{
+    if (_awaitingAck & (1 << channelId))
+    {
+        reactivate_channel(channelId);
+    }
+}
+
+/*
+    Reads a channel into the next free slot of the frame ring and applies the rearm policy of the channel
+    When the ring is full the channel is left untouched, its message is read by a later call
+*/
+bool TSS463_VAN::receive_frame(uint8_t channelId)
+{
+    VanFrame* frame = _frameRing->reserve();
+    if (frame != NULL)
+    {
+        _heldByRing &= ~(1 << channelId);
+        uint8_t idBytes[2];
+        frame->Timestamp = _completedAt[channelId];
+        frame->Status = read_channel(channelId, idBytes, frame->Data, TSS463_FRAME_DATA_SIZE, &frame->Length);
+        frame->Identifier = tss463_identifier(idBytes);
+        frame->Channel = channelId;
+
+        rearm_after_read(channelId);
+        if (_receiveFilter != NULL && channels[channelId].IdentifierMask != 0xFFF && !_receiveFilter->contains(frame->Identifier))
+        {
+            // caught by a wildcard channel, but nobody is interested in it: the slot is not published
+            skip_ack(channelId);
+            return false;
+        }
+        _frameRing->commit();
+        return true;
+    }
+
+    // when the ring is full the channel is not reactivated: the message stays in its mailbox and a later receive stores it
+    if (!(_heldByRing & (1 << channelId)))
+    {
+        _heldByRing |= 1 << channelId;
+        _frameRing->count_blocked();
+    }
+    if (_itPin != TSS463_NO_PIN)
+    {
+        // no new interrupt comes for it, the flags were reset
+        _pendingChannels |= 1 << channelId;
+    }
+    return false;
 }
 
 /*
@@ -868,46 +1767,686 @@ void TSS463_VAN::read_message(uint8_t channelId, uint8_t*length, uint8_t buffer[
 */
 uint8_t TSS463_VAN::get_last_channel() {
     uint8_t lms = register_get(LASTMESSAGESTATUS);
-    uint8_t channelId = ExtractBits(lms, 3, 1);
+    uint8_t channelId = ExtractBits(lms, 4, 1); // IDTR[3:0] (Page 32)
+    return channelId;
+}
+
+/*
+    Remembers when a channel was armed (set up or reactivated), the start of its latency
+*/
+void TSS463_VAN::mark_armed(uint8_t channelId)
+{
+    _armedAt[channelId] = _clock();
+    _armed |= 1 << channelId;
+}
+
+/*
+    Takes the time of the first completion seen after the channel was armed: a status bit (CHRx, CHTx) which was not set in the setup
+    The latency goes into a histogram when one is set:
+    - replies: reply request channels, from the setup or reactivation (the request) until the reply is received (CHRx)
+    - transmissions: transmit, immediate and deferred reply channels, until the message is transmitted (CHTx without CHER)
+*/
+void TSS463_VAN::observe(uint8_t channelId, MessageLengthAndStatusRegister status, uint32_t now)
+{
+    if (!(_armed & (1 << channelId)))
+    {
+        return;
+    }
+
+    Id2AndCommandRegister command;
+    command.Value = channels[channelId].Id2AndCommandRegisterValue;
+    MessageLengthAndStatusRegister initial;
+    initial.Value = channels[channelId].MessageLengthAndStatusRegisterValue;
+
+    bool isReplyRequest = command.data.RNW && command.data.RTR && !initial.data.CHTx;
+    bool isTransmission = !command.data.RTR && !initial.data.CHTx;
+    bool completed = isReplyRequest ? status.data.CHRx : ((status.data.CHRx && !initial.data.CHRx) || (status.data.CHTx && !initial.data.CHTx));
+    if (!completed)
+    {
+        return;
+    }
+
+    _armed &= ~(1 << channelId);
+    _completedAt[channelId] = now;
+
+    uint32_t latency = now - _armedAt[channelId];
+    if (isReplyRequest && _replyLatency != NULL)
+    {
+        _replyLatency->add(latency);
+    }
+    else if (isTransmission && !status.data.CHER && _transmitLatency != NULL)
+    {
+        _transmitLatency->add(latency);
+    }
+}
+
+/*
+    Sets the time source of the timestamps and of the begin timeouts in microseconds, micros is used when it is NULL
+    It is called from the interrupt handler when attach_interrupt is used
+*/
+void TSS463_VAN::set_clock(TSS463_Clock clock)
+{
+    _clock = clock != NULL ? clock : tss463_micros;
+}
+
+/*
+    Returns the time when the last completion of the channel (message received or transmitted) was seen:
+    when the INT pin fell with attach_interrupt, otherwise when the status of the channel was read (poll_all_channels, message_available, receive, process)
+*/
+uint32_t TSS463_VAN::completion_time(uint8_t channelId)
+{
+    return channelId < CHANNELS ? _completedAt[channelId] : 0;
+}
+
+/*
+    Sets the histograms of the reply latency (reply request to received reply) and of the transmit latency (arming to CHTx), NULL stops recording
+*/
+void TSS463_VAN::set_latency_histograms(TSS463_LatencyHistogram* replies, TSS463_LatencyHistogram* transmissions)
+{
+    _replyLatency = replies;
+    _transmitLatency = transmissions;
+}
+
+/*
+    Reads the Line Status, Transmission Status, Last Message Status and Last Error Status registers (0x04 - 0x07) in one SPI frame
+*/
+BusStatus TSS463_VAN::read_bus_status()
+{
+    volatile uint8_t values[4];
+    registers_get(LINESTATUS, values, 4);
+
+    BusStatus status;
+    status.Line.Value = values[0];
+    status.Transmission.Value = values[1];
+    status.LastMessage.Value = values[2];
+    status.LastError.Value = values[3];
+    return status;
+}
+
+/*
+    Sets the Diagnosis Control Register (0x02), the value is written again by begin and resync
+*/
+void TSS463_VAN::set_diagnosis_control(DiagnosisControlRegister control)
+{
+    _diagnosisControl = control;
+    register_set(DIAGNOSISCONTROL, control.Value);
+}
+
+TSS463_VAN* TSS463_VAN::_interruptInstance = NULL;
+
+void TSS463_ISR_ATTR TSS463_VAN::isr()
+{
+    if (_interruptInstance != NULL)
+    {
+        _interruptInstance->on_interrupt();
+    }
+}
+
+/*
+    Uses the INT pin of the TSS463C (active low, open drain) to get notified about received messages instead of polling the channels
+    Only one TSS463_VAN instance can be attached at a time
+    Host build: only the pin is kept, the INT line of the emulator is followed by calling on_interrupt when it falls
+*/
+void TSS463_VAN::attach_interrupt(uint8_t itPin)
+{
+    _itPin = itPin;
+    _interruptInstance = this;
+
+#if defined(ARDUINO)
+    pinMode(itPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(itPin), TSS463_VAN::isr, FALLING);
+#endif
+}
+
+/*
+    Marks that the TSS463C raised an interrupt. Safe to be called from an ISR
+*/
+void TSS463_ISR_ATTR TSS463_VAN::on_interrupt()
+{
+    _interruptTime = _clock();
+    _interruptPending = true;
+}
+
+/*
+    Returns true if an interrupt was raised which was not serviced yet, or a channel it found was not read yet by service_interrupt
+*/
+bool TSS463_VAN::interrupt_pending()
+{
+    return _interruptPending || _pendingChannels != 0;
+}
+
+// flags of the Interrupt Status Register, bit 5 and 6 of the Interrupt Reset Register must be written as zero
+static const uint8_t INTERRUPT_FLAGS = (1 << RSTR) | (1 << TEE) | (1 << TOKE) | (1 << REE) | (1 << ROKE) | (1 << RNOKE);
+
+/*
+    Reads the interrupt flags and the last message status, then resets the flags
+    The channel of the last message (IDTR) is the one which raised the interrupt. The reception flags are shared by all the channels:
+    a channel which received a message before the reset but is not the last message raises no interrupt of its own, so the status of
+    all the channels is read once (poll_all_channels) when a second reception may have completed before the reset, that is when the
+    flags are reset later than the shortest frame after the interrupt, or when the time of the interrupt is unknown
+    Returns the receiving channels with a message to read (bit n: channel n)
+*/
+uint16_t TSS463_VAN::take_interrupt()
+{
+    // LASTMESSAGESTATUS (0x06), LASTERRORSTATUS (0x07), reserved (0x08), INTERRUPTSTATUS (0x09)
+    uint8_t statusRegisters[4];
+    registers_get(LASTMESSAGESTATUS, statusRegisters, 4);
+    uint8_t interruptStatus = statusRegisters[3] & INTERRUPT_FLAGS;
+    _unreportedFlags |= interruptStatus;
+    bool isReception = (interruptStatus | _unservicedFlags) & ((1 << ROKE) | (1 << RNOKE));
+    // a reception whose flags were reset by take_interrupt_flags, its time is unknown
+    bool isLate = _unservicedFlags & ((1 << ROKE) | (1 << RNOKE));
+    _unservicedFlags = 0;
+
+    // the 32 bit time written by on_interrupt is read in several instructions on AVR
+#if defined(ARDUINO)
+    noInterrupts();
+#endif
+    uint32_t interruptTime = _interruptTime;
+#if defined(ARDUINO)
+    interrupts();
+#endif
+
+    uint16_t pending = 0;
+    if (isReception)
+    {
+        uint8_t channelId = ExtractBits(statusRegisters[0], 4, 1);
+        if (channelId < CHANNELS && channels[channelId].IsOccupied)
+        {
+            // the message arrived when the INT pin fell
+            MessageLengthAndStatusRegister received;
+            received.Value = 1;
+            observe(channelId, received, interruptTime);
+            if (!(_awaitingAck & (1 << channelId)) && is_receiving_channel(channelId))
+            {
+                pending = 1 << channelId;
+            }
+        }
+    }
+
+    register_set(INTERRUPTRESET, interruptStatus);
+
+    if (isReception && (pending == 0 || isLate || (uint32_t)(_clock() - interruptTime) >= _shortestReceptionUs))
+    {
+        pending |= poll_received();
+    }
+
+#if defined(ARDUINO)
+    // the INT pin is level sensitive, it stays low while another interrupt is pending
+    if (_itPin != TSS463_NO_PIN && digitalRead(_itPin) == LOW)
+    {
+        _interruptTime = _clock();
+        _interruptPending = true;
+    }
+#endif
+
+    return pending;
+}
+
+/*
+    Returns the interrupt flags (bit n: as the Interrupt Status Register) set since the previous call and resets them. The flags are set
+    whatever the Interrupt Enable Register, so a transmission, a reception or an error is seen even without attach_interrupt.
+    The flags reset meanwhile by the interrupt service are included, and a reception taken here is still serviced after attach_interrupt.
+    A flag is a bit: two events of the same kind between two calls are seen once
+*/
+uint8_t TSS463_VAN::take_interrupt_flags()
+{
+    return reset_interrupt_flags(register_get(INTERRUPTSTATUS) & INTERRUPT_FLAGS);
+}
+
+/*
+    Reads the status registers 0x04 - 0x07 like read_bus_status and takes the interrupt flags like take_interrupt_flags, in one SPI
+    frame (0x04 - 0x09). The flags are reset by a second frame, only when one is set
+*/
+BusStatus TSS463_VAN::take_bus_status(uint8_t* flags)
+{
+    // LINESTATUS (0x04) to LASTERRORSTATUS (0x07), reserved (0x08), INTERRUPTSTATUS (0x09)
+    volatile uint8_t values[6];
+    registers_get(LINESTATUS, values, 6);
+
+    BusStatus status;
+    status.Line.Value = values[0];
+    status.Transmission.Value = values[1];
+    status.LastMessage.Value = values[2];
+    status.LastError.Value = values[3];
+    *flags = reset_interrupt_flags(values[5] & INTERRUPT_FLAGS);
+    return status;
+}
+
+/*
+    Resets the interrupt flags which were read set, returns them with the flags reset meanwhile by the interrupt service
+*/
+uint8_t TSS463_VAN::reset_interrupt_flags(uint8_t flags)
+{
+    if (flags != 0)
+    {
+        register_set(INTERRUPTRESET, flags);
+        if (_itPin != TSS463_NO_PIN)
+        {
+            // resetting the flags released the INT pin, the reception is serviced by the next process, receive or service_interrupt
+            _unservicedFlags |= flags;
+            if (flags & ((1 << ROKE) | (1 << RNOKE)))
+            {
+                _interruptPending = true;
+            }
+        }
+    }
+
+    flags |= _unreportedFlags;
+    _unreportedFlags = 0;
+    return flags;
+}
+
+/*
+    Reads the status of all the channels (poll_all_channels), returns the receiving channels with a message to read (bit n: channel n)
+    The channels whose message was delivered and which wait for reactivate_channel still have CHRx set, they are left out
+*/
+uint16_t TSS463_VAN::poll_received()
+{
+    MessageLengthAndStatusRegister statuses[CHANNELS];
+    uint16_t pending = 0;
+
+    poll_channels(statuses);
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        if (statuses[channelId].data.CHRx && !(_awaitingAck & (1 << channelId)) && channels[channelId].IsOccupied && is_receiving_channel(channelId))
+        {
+            pending |= 1 << channelId;
+        }
+    }
+    return pending;
+}
+
+/*
+    Takes the receiving channels to read: the ones found by an earlier interrupt and not read yet (unless they were set up again since),
+    and the ones of the pending interrupt
+*/
+uint16_t TSS463_VAN::take_pending_channels()
+{
+    uint16_t pending = 0;
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        if ((_pendingChannels & (1 << channelId)) && !(_awaitingAck & (1 << channelId)) && channels[channelId].IsOccupied &&
+            is_receiving_channel(channelId))
+        {
+            pending |= 1 << channelId;
+        }
+    }
+    _pendingChannels = 0;
+
+    if (_interruptPending)
+    {
+        _interruptPending = false;
+        pending |= take_interrupt();
+    }
+    return pending;
+}
+
+/*
+    Services a pending interrupt: reads a channel which received a message into the buffer and resets the interrupt flags.
+    The channel is reactivated according to its rearm policy. When several channels received a message one is read at each call,
+    interrupt_pending stays true until all of them were read
+    Returns the channel which was read or TSS463_NO_CHANNEL if there was nothing to read
+*/
+uint8_t TSS463_VAN::service_interrupt(uint8_t* length, uint8_t buffer[])
+{
+    *length = 0;
+    resync_if_pending();
+
+    uint16_t pending = take_pending_channels();
+    if (pending == 0)
+    {
+        return TSS463_NO_CHANNEL;
+    }
+
+    uint8_t channelId = 0;
+    while (!(pending & (1 << channelId)))
+    {
+        channelId++;
+    }
+    _pendingChannels = pending & ~(1 << channelId);
+
+    read_message(channelId, length, buffer);
     return channelId;
 }
 
+/*
+    Sets the ring where the receive() method stores the received frames
+*/
+void TSS463_VAN::set_frame_ring(TSS463_FrameRing* ring)
+{
+    _frameRing = ring;
+    _heldByRing = 0;
+}
+
+/*
+    The frames of the wildcard channels (identifier mask other than 0xFFF, see set_channel_mask) are stored by receive() only if
+    their identifier is known by the filter, NULL stores every frame
+*/
+void TSS463_VAN::set_receive_filter(const TSS463_IdentifierDemux* filter)
+{
+    _receiveFilter = filter;
+}
+
+/*
+    Sets the handlers called by process()
+*/
+void TSS463_VAN::set_handlers(TSS463_Handlers* handlers)
+{
+    _handlers = handlers;
+}
+
+/*
+    Reads a channel straight into a buffer on the stack, applies the rearm policy of the channel and calls the handler of the message
+*/
+bool TSS463_VAN::dispatch_channel(uint8_t channelId)
+{
+    uint8_t idBytes[2];
+    uint8_t data[TSS463_MAX_DATA_LENGTH];
+    VanMessageView message;
+
+    message.Status = read_channel(channelId, idBytes, data, TSS463_MAX_DATA_LENGTH, &message.Length);
+    message.Identifier = tss463_identifier(idBytes);
+    message.Channel = channelId;
+    message.Data = data;
+    message.Timestamp = _completedAt[channelId];
+
+    // the message is already out of the TSS463C, the channel can receive the next one while the handler runs
+    rearm_after_read(channelId);
+    if (!_handlers->dispatch(message))
+    {
+        skip_ack(channelId);
+        return false;
+    }
+    return true;
+}
+
+/*
+    Calls the handlers of the received messages, the channels are reactivated according to their rearm policy
+    With attach_interrupt only the channels found by the pending interrupt are read, otherwise all the channels are polled
+    Returns the number of messages which had a handler
+*/
+uint8_t TSS463_VAN::process()
+{
+    uint8_t dispatched = 0;
+
+    if (_handlers == NULL)
+    {
+        return dispatched;
+    }
+    resync_if_pending();
+
+    uint16_t pending = _itPin != TSS463_NO_PIN ? take_pending_channels() : poll_received();
+
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        if ((pending & (1 << channelId)) && dispatch_channel(channelId))
+        {
+            dispatched++;
+        }
+    }
+
+    return dispatched;
+}
+
+/*
+    Moves the received messages into the frame ring, the channels are reactivated according to their rearm policy
+    With attach_interrupt only the channels found by the pending interrupt are read, otherwise all the channels are polled
+    Returns the number of frames stored
+*/
+uint8_t TSS463_VAN::receive()
+{
+    uint8_t stored = 0;
+
+    if (_frameRing == NULL)
+    {
+        return stored;
+    }
+    resync_if_pending();
+
+    uint16_t pending = _itPin != TSS463_NO_PIN ? take_pending_channels() : poll_received();
+
+    for (uint8_t channelId = 0; channelId < CHANNELS; channelId++)
+    {
+        if ((pending & (1 << channelId)) && receive_frame(channelId))
+        {
+            stored++;
+        }
+    }
+
+    return stored;
+}
+
 /*
     Sets an individual byte in an already defined channel
 */
 void TSS463_VAN::set_value_in_channel(uint8_t channelId, uint8_t index0, uint8_t value)
 {
-    uint8_t memory_address = get_memory_address_to_use(channelId, 1);
-    uint8_t addressOfDataToSendOnVAN = GETMAIL(memory_address+1+index0);
-    uint8_t packet[] = { value };
-    registers_set(addressOfDataToSendOnVAN, packet, 1);
+    update_channel_payload(channelId, index0, &value, 1);
+}
+
+/*
+    Updates the data of an already defined channel without setting up the channel again (the channel is not reactivated)
+    Only the bytes which differ from the last written data are sent (with TSS463_SHADOW_REGISTERS or TSS463_SHADOW_MAILBOX), unchanged gaps
+    shorter than the gap merge threshold are sent again to save SPI frames, without any shadow copy the whole data is written in a single frame
+    Returns false if the channel is not set up or the data does not fit into its buffer
+*/
+bool TSS463_VAN::update_channel_payload(uint8_t channelId, const uint8_t newValues[], uint8_t len)
+{
+    return update_channel_payload(channelId, 0, newValues, len);
+}
+
+bool TSS463_VAN::update_channel_payload(uint8_t channelId, uint8_t index0, const uint8_t newValues[], uint8_t len)
+{
+    if (channelId >= CHANNELS || !channels[channelId].IsOccupied)
+    {
+        return false;
+    }
+
+    // the first byte of the buffer is the message status
+    if (index0 + len > channels[channelId].MemorySize - 1)
+    {
+        return false;
+    }
+
+    uint8_t addressOfDataToSendOnVAN = GETMAIL(channels[channelId].MemoryLocation + 1 + index0);
+    registers_set(addressOfDataToSendOnVAN, newValues, len);
+
+    return true;
+}
+
+/*
+    Sends the initialization sequence again (it resets the TSS463C) and restores the setup of the channels, for example after a brown-out
+    The channel registers are rewritten from their setup, the line control registers are set and the line is activated.
+    The channels which were armed are armed again, and so are the receiving channels whose message was not read yet (it is lost with the reset).
+    The channels whose completion was seen stay completed: a transmitted message is not sent again, a channel waiting for reactivate_channel keeps waiting.
+    The data of the transmit channels is restored from the shadow copy of the Message DATA RAM, without TSS463_SHADOW_REGISTERS
+    and TSS463_SHADOW_MAILBOX it is zeroed and has to be written again. Returns false if the TSS463C does not answer or the line does not become active,
+    resync is then still requested and the next entry point tries again.
+*/
+bool TSS463_VAN::resync()
+{
+    // the receiving channels whose message was seen but not read: it is lost with the reset
+    uint16_t lost = (_heldByRing | _pendingChannels) & ~_armed;
+    uint16_t rearmed = _armed | lost;
+
+#if TSS463_SHADOW_ENABLED
+    // the shadow copy is forgotten by motorolla_mode, so which data bytes it held is taken first (the bytes themselves are kept)
+    uint8_t mailboxValid[TSS463C_RAM_SIZE_IN_BYTES / 8];
+    memcpy(mailboxValid, &_shadowValid[(GETMAIL(0) - TSS463_SHADOW_START) / 8], sizeof(mailboxValid));
+#endif
+
+    bool result = motorolla_mode();
+    if (result)
+    {
+        error = 0;
+        TSS463_WAIT_NS(TSS463_DATA_GAP_NS);//12 clocks XTAL
+
+        // the channel registers then the Message DATA RAM in one SPI frame, streamed one channel or byte at a time
+        frame_begin(CHANNEL_ADDR(0), WRITE);
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            uint8_t data[8];
+            memcpy(data, DISABLED_CHANNEL, 8);
+            if (channels[i].IsOccupied)
+            {
+                MessageLengthAndStatusRegister status;
+                status.Value = channels[i].MessageLengthAndStatusRegisterValue;
+                if (!(rearmed & (1 << i)))
+                {
+                    // the status bits the TSS463C sets at the completion (Page 44-45)
+                    status.data.CHTx = 1;
+                    status.data.CHRx = status.data.CHRx || is_receiving_channel(i);
+                }
+                data[0] = channels[i].Identifier >> 4;
+                data[1] = channels[i].Id2AndCommandRegisterValue;
+                data[2] = channels[i].MessagePointerRegisterValue;
+                data[3] = status.Value;
+                data[6] = channels[i].IdentifierMask >> 4;
+                data[7] = (channels[i].IdentifierMask & 0x0F) << 4;
+            }
+            burst_transfer(CHANNEL_ADDR(i), data, 8);
+        }
+        for (uint8_t i = 0; i < TSS463C_RAM_SIZE_IN_BYTES; i++)
+        {
+            uint8_t value = 0;
+#if TSS463_SHADOW_ENABLED
+            if (mailboxValid[i / 8] & (1 << (i % 8)))
+            {
+                value = _shadow[GETMAIL(i) - TSS463_SHADOW_START];
+            }
+#endif
+            burst_transfer(GETMAIL(i), &value, 1);
+        }
+        frame_end();
+
+        result = start_line();
+    }
+
+    if (result)
+    {
+        _resyncPending = false;
+        _pendingChannels = 0;
+        _heldByRing = 0;
+        for (uint8_t i = 0; i < CHANNELS; i++)
+        {
+            if (channels[i].IsOccupied && (lost & (1 << i)))
+            {
+                mark_armed(i);
+            }
+        }
+        _spiStats.Resyncs++;
+    }
+    return result;
+}
+
+/*
+    Sets after how many SPI frames in a row without the 0xAA, 0x55 answer a resync is requested, 0 turns the automatic resync off
+*/
+void TSS463_VAN::set_resync_threshold(uint8_t frames)
+{
+    _resyncThreshold = frames;
+    if (frames == 0)
+    {
+        _resyncPending = false;
+    }
+}
+
+/*
+    Counters of the SPI traffic and of the handshake errors since begin or clear_spi_stats
+*/
+SpiStats TSS463_VAN::spi_stats()
+{
+    return _spiStats;
+}
+
+void TSS463_VAN::clear_spi_stats()
+{
+    memset(&_spiStats, 0, sizeof(_spiStats));
+}
+
+/*
+    Sets how many unchanged bytes between two changed ones are sent again instead of starting a new SPI frame
+    An SPI frame costs the address and control bytes plus 27 XTAL periods of spacing, a data byte costs 12 XTAL periods (Page 10)
+*/
+void TSS463_VAN::set_gap_merge(uint8_t unchangedBytes)
+{
+#if TSS463_SHADOW_ENABLED
+    _shadowGapMerge = unchangedBytes;
+#else
+    (void)unchangedBytes;
+#endif
 }
 
 /*
     Starts the library
+    Returns as soon as the TSS463C answered and the line is active, or the reason why it is not ready
 */
-void TSS463_VAN::begin()
+BEGIN_STATUS TSS463_VAN::begin()
 {
-    delayMicroseconds(10 * 1000);
-    tss_init();
+    return tss_init(NO_CHANNELS);
 }
 
-TSS463_VAN::TSS463_VAN(uint8_t _CS, SPIClass* _SPI, VAN_SPEED vanSpeed) {
-    SPI = _SPI;
-    SPICS = _CS;
+/*
+    Initializes the TSS463C with the channels of the plan already set up when the line is activated (see configure)
+    If the plan is invalid every channel is disabled and BEGIN_INVALID_PLAN is returned
+*/
+BEGIN_STATUS TSS463_VAN::begin(const ChannelPlan& plan)
+{
+    return tss_init(plan);
+}
 
+#if defined(ARDUINO)
+TSS463_VAN::TSS463_VAN(uint8_t _CS, SPIClass* _SPI, VAN_SPEED vanSpeed)
+    : _spiTransport(_CS, _SPI)
+{
+    _transport = &_spiTransport;
+    init(vanSpeed);
+}
+#endif
+
+/*
+    Uses the given transport instead of the hardware SPI, for example the TSS463_Emulator
+*/
+TSS463_VAN::TSS463_VAN(TSS463_Transport* transport, VAN_SPEED vanSpeed)
+#if defined(ARDUINO)
+    : _spiTransport(TSS463_NO_PIN, NULL)
+#endif
+{
+    _transport = transport;
+    init(vanSpeed);
+}
+
+void TSS463_VAN::init(VAN_SPEED vanSpeed)
+{
     switch (vanSpeed)
     {
         case VAN_62K5BPS:
             _lineControl = TSS_8MHz_62k5BPS;
+            _shortestReceptionUs = VAN_SHORTEST_RECEPTION_TIMESLOTS * 16;
             break;
         case VAN_125KBPS:
             _lineControl = TSS_8MHz_125kBPS;
+            _shortestReceptionUs = VAN_SHORTEST_RECEPTION_TIMESLOTS * 8;
             break;
     }
 
-    pinMode(SPICS, OUTPUT);
-    TSS463_UNSELECT();
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        channels[i].IsOccupied = false;
+        channels[i].MemorySize = 0;
+        channels[i].RearmPolicy = REARM_AFTER_ACK;
+        _armedAt[i] = 0;
+        _completedAt[i] = 0;
+    }
+    _clock = tss463_micros;
+    _diagnosisControl.Value = 0;
+
+#if TSS463_SHADOW_ENABLED
+    memset(_shadowValid, 0, sizeof(_shadowValid));
+#endif
+
+    _transport->begin();
 }
 
 extern TSS463_VAN VAN;
@@ -3,64 +3,172 @@
 #ifndef _TSS463_VAN_h
 #define _TSS463_VAN_h
 
+#include "tss463_registers.h"
 #include "tss463_channel_registers_struct.h"
+#include "tss463_transport.h"
+#include "tss463_timing.h"
+#include "tss463_frame_ring.h"
+#include "tss463_identifier_demux.h"
+#include "tss463_handlers.h"
+#include "tss463_message_descriptor.h"
+#include "tss463_latency_histogram.h"
 
 #if defined(ARDUINO) && ARDUINO >= 100
     #include <Arduino.h>
     #include <inttypes.h>
     #include <SPI.h>
-#else
+#elif defined(ARDUINO)
     #include "WProgram.h"
+#else
+    // host build (tools): the driver runs on a transport like the TSS463_Emulator
+    #include <stddef.h>
+    #include <stdint.h>
+    #include <string.h>
+#endif
+
+#define TSS463_NO_CHANNEL 0xFF
+#define TSS463_NO_PIN     0xFF
+
+#if defined(ARDUINO_ARCH_ESP32)
+    #define TSS463_ISR_ATTR IRAM_ATTR
+#else
+    #define TSS463_ISR_ATTR
+#endif
+
+/*
+    Keeps a copy of the channel registers and the Message DATA RAM so unchanged bytes are not written again (uses 270 bytes of RAM, off by default on AVR)
+*/
+#ifndef TSS463_SHADOW_REGISTERS
+    #if defined(ARDUINO_ARCH_AVR)
+        #define TSS463_SHADOW_REGISTERS 0
+    #else
+        #define TSS463_SHADOW_REGISTERS 1
+    #endif
+#endif
+/*
+    Without TSS463_SHADOW_REGISTERS keeps a copy of the Message DATA RAM only (144 bytes of RAM), so update_channel_payload and the setup of
+    a channel still write only the changed data bytes. The channel registers are always written
+*/
+#ifndef TSS463_SHADOW_MAILBOX
+    #define TSS463_SHADOW_MAILBOX 1
+#endif
+#if TSS463_SHADOW_REGISTERS || TSS463_SHADOW_MAILBOX
+    #define TSS463_SHADOW_ENABLED 1
+#else
+    #define TSS463_SHADOW_ENABLED 0
+#endif
+// Unchanged bytes between two changed ones are written again instead of starting a new SPI frame if there are at most this many of them
+#ifndef TSS463_SHADOW_GAP_MERGE
+    #define TSS463_SHADOW_GAP_MERGE 2
+#endif
+/*
+    Time the microcontroller needs to open and close an SPI frame (transaction and chip select), added to the SPI bus time of every frame when poll_all_channels chooses how to read
+    AVR at 16 MHz: two digitalWrite of the chip select take about 4 us each, beginTransaction and endTransaction and the calls around the frame the rest.
+    The host build (emulator, tests) models the AVR boards of the examples
+*/
+#ifndef TSS463_FRAME_OVERHEAD_NS
+    #if defined(ARDUINO_ARCH_ESP32)
+        #define TSS463_FRAME_OVERHEAD_NS 5000
+    #elif defined(ARDUINO_ARCH_AVR) || !defined(ARDUINO)
+        #define TSS463_FRAME_OVERHEAD_NS 20000
+    #else
+        #define TSS463_FRAME_OVERHEAD_NS 10000
+    #endif
+#endif
+/*
+    begin waits at most this long for the TSS463C to answer the initialization sequence after power up or reset (its oscillator must be running)
+*/
+#ifndef TSS463_BEGIN_TIMEOUT_US
+    #define TSS463_BEGIN_TIMEOUT_US 10000
+#endif
+// The Activate command is performed within 6 timeslots and the line is active 8 timeslots later (Page 31 and Figure 35), 288 us at 62.5 kbps
+#ifndef TSS463_ACTIVATION_TIMEOUT_US
+    #define TSS463_ACTIVATION_TIMEOUT_US 1000
+#endif
+// After this many SPI frames in a row without the 0xAA, 0x55 answer the TSS463C is initialized again and the channels are restored (0: never)
+#ifndef TSS463_RESYNC_THRESHOLD
+    #define TSS463_RESYNC_THRESHOLD 4
+#endif
+#if TSS463_SHADOW_REGISTERS
+    #define TSS463_SHADOW_START CHANNEL_ADDR(0)
+#else
+    #define TSS463_SHADOW_START GETMAIL(0)
 #endif
+#define TSS463_SHADOW_SIZE  (0x100 - TSS463_SHADOW_START)
 
-#define TSS463_SELECT()   digitalWrite(SPICS, LOW)
-#define TSS463_UNSELECT() digitalWrite(SPICS, HIGH)
-
-#define MOTOROLA_MODE 0x00
-#define WRITE         0xE0
-#define READ          0x60
-#define ADDR_ANSW     0xAA
-#define CMD_ANSW      0x55
-
-#define ROKE  (1)
-#define RNOKE (0)
-
-#pragma region TSS463C internal register adresses - Figure 22
-                                 // R/W?  - Default value on init
-                                 //------------------------------
-#define LINECONTROL       0x00   // r/w   - 0x00
-#define TRANSMITCONTROL   0x01   // r/w   - 0x02
-#define DIAGNOSISCONTROL  0x02   // r/w   - 0x00
-#define COMMANDREGISTER   0x03   // w     - 0x00
-#define LINESTATUS        0x04   // r     - 0bx01xxx00
-#define TRANSMITSTATUS    0x05   // r     - 0x00
-#define LASTMESSAGESTATUS 0x06   // r     - 0x00
-#define LASTERRORSTATUS   0x07   // r     - 0x00
-#define INTERRUPTSTATUS   0x09   // r     - 0x80
-#define INTERRUPTENABLE   0x0A   // r/w   - 0x80
-#define INTERRUPTRESET    0x0B   // w
-#pragma endregion
-
-#define TSS_8MHz_62k5BPS 0x30
-#define TSS_8MHz_125kBPS 0x20
-
-// Channels
-#define CHANNEL_ADDR(x) (0x10 + (0x08 * x))
-#define CHANNELS 14
-// Mailbox - data register
-#define GETMAIL(x) (0x80 + x)
+enum REARM_POLICY {
+    // the channel is reactivated by the user with reactivate_channel after the message was read
+    REARM_AFTER_ACK,
+    // the channel is reactivated by the library right after the message was read
+    REARM_IMMEDIATE,
+    // the channel is released after the message was read, it can be set up again for any identifier
+    REARM_ONE_SHOT,
+};
+
+enum BEGIN_STATUS {
+    BEGIN_OK,
+    // the TSS463C did not answer the initialization sequence (0xAA, 0x55) within TSS463_BEGIN_TIMEOUT_US
+    BEGIN_NO_ANSWER,
+    // the Line Status Register still reports the sleep or idle mode TSS463_ACTIVATION_TIMEOUT_US after the Activate command
+    BEGIN_LINE_INACTIVE,
+    // the channel plan was rejected, every channel is disabled but the line is active
+    BEGIN_INVALID_PLAN,
+};
 
 typedef struct ChannelSetup {
     uint8_t MessageLengthAndStatusRegisterValue;
     uint8_t MemoryLocation;
+    uint8_t MemorySize;
+    uint8_t MessagePointerRegisterValue;
     uint16_t Identifier;
+    uint16_t IdentifierMask;
+    uint8_t Id2AndCommandRegisterValue;
     bool IsOccupied;
+    REARM_POLICY RearmPolicy;
 };
 
-enum VAN_SPEED {
-    VAN_62K5BPS,
-    VAN_125KBPS,
-};
+/*
+    Setup of a channel for configure() or begin(plan), the message is usually a VanMessage descriptor built at compile time
+*/
+typedef struct
+{
+    uint8_t Channel;
+    const VanMessageDescriptor* Message;
+    // the data of the message for the types which send data, otherwise NULL
+    const uint8_t* Values;
+    REARM_POLICY RearmPolicy;
+}ChannelPlanEntry;
+
+typedef struct
+{
+    const ChannelPlanEntry* Entries;
+    uint8_t Count;
+}ChannelPlan;
+
+/*
+    SPI counters of TSS463_VAN, the bytes are the data bytes of the frames (without the address and control bytes)
+*/
+typedef struct
+{
+    // frames whose address or control byte was not answered with 0xAA, 0x55
+    uint32_t HandshakeErrors;
+    uint32_t Resyncs;
+    uint32_t FramesWritten;
+    uint32_t FramesRead;
+    uint32_t BytesWritten;
+    uint32_t BytesRead;
+}SpiStats;
+
+/*
+    The status registers 0x04 - 0x07 read in one SPI frame by read_bus_status
+*/
+typedef struct
+{
+    LineStatusRegister Line;
+    TransmissionStatusRegister Transmission;
+    TransmissionStatusRegister LastMessage;
+    LastErrorStatusRegister LastError;
+}BusStatus;
 
 class TSS463_VAN
 {
@@ -69,40 +177,145 @@ class TSS463_VAN
     const uint8_t TSS463C_RAM_SIZE_IN_BYTES = 128;
 
     ChannelSetup channels[14];
-    uint8_t next_free_memory_address;
 
-    volatile int error = 0; // TSS463C out of sync error
-    SPIClass *SPI;
-    uint8_t SPICS;
+    volatile int error = 0; // TSS463C out of sync error: SPI frames in a row without the 0xAA, 0x55 answer
+    uint8_t _resyncThreshold = TSS463_RESYNC_THRESHOLD;
+    // set by frame_end, the resync runs at the next entry point (see resync_if_pending)
+    bool _resyncPending = false;
+    uint8_t _frameControl = 0;
+    uint32_t _frameOverheadNs = TSS463_FRAME_OVERHEAD_NS;
+    SpiStats _spiStats = { 0, 0, 0, 0, 0, 0 };
+    volatile bool _interruptPending = false;
+    volatile uint32_t _interruptTime = 0;
+    // no two receptions complete closer than this on the bus (VAN_SHORTEST_RECEPTION_TIMESLOTS at the speed of the bus)
+    uint16_t _shortestReceptionUs;
+    // receiving channels found by the last interrupt which were not read yet by service_interrupt
+    uint16_t _pendingChannels = 0;
+    // bit n: the message of channel n was delivered and the channel waits for reactivate_channel (REARM_AFTER_ACK)
+    uint16_t _awaitingAck = 0;
+    // interrupt flags reset by take_interrupt which take_interrupt_flags did not return yet, and the other way round
+    uint8_t _unreportedFlags = 0;
+    uint8_t _unservicedFlags = 0;
+    TSS463_Clock _clock;
+    // bit n: channel n was armed and its completion (CHRx or CHTx) was not seen yet
+    uint16_t _armed = 0;
+    uint32_t _armedAt[CHANNELS];
+    uint32_t _completedAt[CHANNELS];
+    TSS463_LatencyHistogram* _replyLatency = NULL;
+    TSS463_LatencyHistogram* _transmitLatency = NULL;
+    uint8_t _itPin = TSS463_NO_PIN;
+    static TSS463_VAN* _interruptInstance;
+    static void isr();
+    TSS463_FrameRing* _frameRing = NULL;
+    // bit n: the message of channel n is left in its mailbox by a full frame ring, it was counted by count_blocked
+    uint16_t _heldByRing = 0;
+    const TSS463_IdentifierDemux* _receiveFilter = NULL;
+    TSS463_Handlers* _handlers = NULL;
+#if TSS463_SHADOW_ENABLED
+    uint8_t _shadow[TSS463_SHADOW_SIZE];
+    uint8_t _shadowValid[TSS463_SHADOW_SIZE / 8];
+    uint8_t _shadowGapMerge = TSS463_SHADOW_GAP_MERGE;
+    bool is_volatile_address(uint8_t address);
+    bool is_dirty(uint8_t address, uint8_t value);
+    void shadow_update(uint8_t address, const volatile uint8_t values[], uint8_t count);
+    void shadow_invalidate(uint8_t address, uint8_t count);
+#endif
+#if defined(ARDUINO)
+    TSS463_SpiTransport _spiTransport;
+#endif
+    TSS463_Transport* _transport;
     uint8_t _lineControl;
-    void tss_init();
-    void motorolla_mode();
-    uint8_t spi_transfer(volatile uint8_t data);
+    DiagnosisControlRegister _diagnosisControl;
+    void init(VAN_SPEED vanSpeed);
+    BEGIN_STATUS tss_init(const ChannelPlan& plan);
+    bool motorolla_mode();
+    bool start_line();
+    bool wait_line_active();
+    uint8_t spi_transfer(uint8_t data);
+    void frame_begin(uint8_t address, uint8_t control);
+    uint8_t frame_transfer(uint8_t data);
+    void frame_end();
+    void resync_if_pending();
+    void write_frame(uint8_t address, const uint8_t values[], uint8_t count);
     void register_set(uint8_t address, uint8_t value);
     uint8_t register_get(uint8_t address);
     uint8_t registers_get(uint8_t address, volatile uint8_t values[], uint8_t count);
     void registers_set(uint8_t address, const uint8_t values[], uint8_t n);
-    void setup_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus);
-    void disable_channel(uint8_t channelId);
+    void registers_burst(uint8_t address, const uint8_t values[], uint8_t count);
+    void burst_transfer(uint8_t address, const uint8_t values[], uint8_t count);
+    void setup_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus, uint16_t identifierMask = TSS463_MASK_FROM_IDENTIFIER);
+    void prepare_channel(uint8_t channelId, uint16_t identifier, uint8_t id1, uint8_t id2AndCommand, uint8_t messagePointer, uint8_t lengthAndStatus, uint16_t identifierMask, uint8_t data[]);
     uint8_t get_memory_address_to_use(uint8_t channelId, uint8_t messageLength);
+    uint8_t find_free_memory(uint8_t channelId, uint8_t size);
+    bool is_memory_free(uint8_t channelId, uint8_t location, uint8_t size);
     bool is_valid_channel(uint8_t channelId, uint16_t identifier);
+    MessageStatusRegister read_channel(uint8_t channelId, uint8_t idBytes[], uint8_t data[], uint8_t maxLength, uint8_t* dataLength);
+    uint16_t take_interrupt();
+    uint8_t reset_interrupt_flags(uint8_t flags);
+    uint16_t take_pending_channels();
+    uint16_t poll_channels(MessageLengthAndStatusRegister statuses[]);
+    uint16_t poll_received();
+    bool receive_frame(uint8_t channelId);
+    bool dispatch_channel(uint8_t channelId);
+    void rearm_after_read(uint8_t channelId);
+    void skip_ack(uint8_t channelId);
+    void mark_armed(uint8_t channelId);
+    void observe(uint8_t channelId, MessageLengthAndStatusRegister status, uint32_t now);
 public:
 
+#if defined(ARDUINO)
     TSS463_VAN(uint8_t _CS, SPIClass *_SPI, VAN_SPEED vanSpeed);
+#endif
+    TSS463_VAN(TSS463_Transport* transport, VAN_SPEED vanSpeed);
     bool set_channel_for_transmit_message(uint8_t channelId, uint16_t identifier, const uint8_t values[], uint8_t messageLength, uint8_t ack);
-    bool set_channel_for_receive_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint8_t setAck);
-    bool set_channel_for_reply_request_message_without_transmission(uint8_t channelId, uint16_t identifier, uint8_t messageLength);
+    bool set_channel_for_receive_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint8_t setAck, uint16_t identifierMask = TSS463_MASK_FROM_IDENTIFIER);
+    bool set_channel_for_reply_request_message_without_transmission(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint16_t identifierMask = TSS463_MASK_FROM_IDENTIFIER);
     bool set_channel_for_reply_request_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint8_t requireAck);
     bool set_channel_for_immediate_reply_message(uint8_t channelId, uint16_t identifier, const uint8_t values[], uint8_t messageLength);
     bool set_channel_for_deferred_reply_message(uint8_t channelId, uint16_t identifier, const uint8_t values[], uint8_t messageLength, uint8_t setAck);
-    bool set_channel_for_reply_request_detection_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength);
+    bool set_channel_for_reply_request_detection_message(uint8_t channelId, uint16_t identifier, uint8_t messageLength, uint16_t identifierMask = TSS463_MASK_FROM_IDENTIFIER);
+    bool set_channel_mask(uint8_t channelId, uint16_t identifierMask);
+    bool set_channel(uint8_t channelId, const VanMessageDescriptor& message, const uint8_t values[] = NULL);
     bool reactivate_channel(uint8_t channelId);
+    bool set_rearm_policy(uint8_t channelId, REARM_POLICY policy);
     void reset_channels();
+    bool configure(const ChannelPlan& plan);
+    void disable_channel(uint8_t channelId);
+    void release_channel(uint8_t channelId);
+    bool is_channel_occupied(uint8_t channelId);
+    bool is_receiving_channel(uint8_t channelId);
+    uint8_t compact_memory();
     MessageLengthAndStatusRegister message_available(uint8_t channelId);
-    void read_message(uint8_t channelId, uint8_t*length, uint8_t buffer[]);
+    uint16_t poll_all_channels(MessageLengthAndStatusRegister statuses[] = NULL);
+    void set_frame_overhead(uint32_t ns);
+    MessageStatusRegister read_message(uint8_t channelId, uint8_t*length, uint8_t buffer[]);
     uint8_t get_last_channel();
+    void set_clock(TSS463_Clock clock);
+    uint32_t completion_time(uint8_t channelId);
+    void set_latency_histograms(TSS463_LatencyHistogram* replies, TSS463_LatencyHistogram* transmissions);
+    BusStatus read_bus_status();
+    void set_diagnosis_control(DiagnosisControlRegister control);
+    void attach_interrupt(uint8_t itPin);
+    void on_interrupt();
+    bool interrupt_pending();
+    uint8_t take_interrupt_flags();
+    BusStatus take_bus_status(uint8_t* flags);
+    uint8_t service_interrupt(uint8_t* length, uint8_t buffer[]);
+    void set_frame_ring(TSS463_FrameRing* ring);
+    void set_receive_filter(const TSS463_IdentifierDemux* filter);
+    uint8_t receive();
+    void set_handlers(TSS463_Handlers* handlers);
+    uint8_t process();
     void set_value_in_channel(uint8_t channelId, uint8_t index0, uint8_t value);
-    void begin();
+    bool update_channel_payload(uint8_t channelId, const uint8_t newValues[], uint8_t len);
+    bool update_channel_payload(uint8_t channelId, uint8_t index0, const uint8_t newValues[], uint8_t len);
+    void set_gap_merge(uint8_t unchangedBytes);
+    bool resync();
+    void set_resync_threshold(uint8_t frames);
+    SpiStats spi_stats();
+    void clear_spi_stats();
+    BEGIN_STATUS begin();
+    BEGIN_STATUS begin(const ChannelPlan& plan);
 };
 
 extern TSS463_VAN VAN;
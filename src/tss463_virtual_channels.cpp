@@ -0,0 +1,368 @@
+#include "tss463_virtual_channels.h"
+#include <string.h>
+
+TSS463_VirtualChannels::TSS463_VirtualChannels(TSS463_VAN* van, TSS463_Clock clock)
+{
+    _van = van;
+    _clock = clock != NULL ? clock : tss463_micros;
+    memset(_owner, TSS463_NO_STREAM, sizeof(_owner));
+    memset(_streams, 0, sizeof(_streams));
+}
+
+uint8_t TSS463_VirtualChannels::add_stream(uint16_t identifier, uint8_t data[], uint8_t length, uint8_t ack, bool isTransmit, bool isPinned)
+{
+    if (_pool != 0 || _streamCount >= TSS463_VC_MAX_STREAMS || data == NULL || length > TSS463_MAX_DATA_LENGTH)
+    {
+        return TSS463_NO_STREAM;
+    }
+
+    VirtualStream* stream = &_streams[_streamCount];
+    stream->Identifier = identifier;
+    stream->Data = data;
+    stream->Length = length;
+    stream->Ack = ack;
+    stream->IsTransmit = isTransmit;
+    stream->IsPinned = isPinned;
+    stream->Channel = TSS463_NO_CHANNEL;
+
+    return _streamCount++;
+}
+
+uint8_t TSS463_VirtualChannels::add_transmit(uint16_t identifier, uint8_t data[], uint8_t length, uint8_t ack)
+{
+    return add_stream(identifier, data, length, ack, true, false);
+}
+
+uint8_t TSS463_VirtualChannels::add_receive(uint16_t identifier, uint8_t buffer[], uint8_t length, uint8_t ack, bool pinned)
+{
+    return add_stream(identifier, buffer, length, ack, false, pinned);
+}
+
+bool TSS463_VirtualChannels::begin(uint16_t channelMask)
+{
+    channelMask &= (1 << CHANNELS) - 1;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((channelMask & (1 << i)) && _van->is_channel_occupied(i))
+        {
+            return false;
+        }
+    }
+    _pool = channelMask;
+
+    // the pinned receive streams take the highest channels for good
+    for (uint8_t i = 0; i < _streamCount; i++)
+    {
+        if (_streams[i].IsPinned)
+        {
+            uint8_t channelId = free_channel(false);
+            if (channelId == TSS463_NO_CHANNEL || !map(i, channelId))
+            {
+                return false;
+            }
+        }
+    }
+
+    clear_stats();
+    return true;
+}
+
+bool TSS463_VirtualChannels::send(uint8_t stream)
+{
+    if (stream >= _streamCount || !_streams[stream].IsTransmit || _streams[stream].IsPending)
+    {
+        return false;
+    }
+    _streams[stream].IsPending = true;
+    return true;
+}
+
+uint8_t TSS463_VirtualChannels::take_received(uint8_t stream)
+{
+    if (stream >= _streamCount || _streams[stream].IsTransmit || !_streams[stream].IsPending)
+    {
+        return 0;
+    }
+    _streams[stream].IsPending = false;
+    return _streams[stream].ReceivedLength;
+}
+
+/*
+    Sets up the channel for the stream, the previous stream of the channel must be completed or unmapped
+*/
+bool TSS463_VirtualChannels::map(uint8_t stream, uint8_t channelId)
+{
+    VirtualStream* virtualStream = &_streams[stream];
+
+    if (_listening & (1 << channelId))
+    {
+        // the window of the previous receive stream expired, its channel is still armed: it is stopped before it is set up again
+        _van->disable_channel(channelId);
+        _listening &= ~(1 << channelId);
+    }
+    _van->release_channel(channelId);
+    bool result;
+    if (virtualStream->IsTransmit)
+    {
+        result = _van->set_channel_for_transmit_message(channelId, virtualStream->Identifier, virtualStream->Data, virtualStream->Length, virtualStream->Ack);
+    }
+    else
+    {
+        // every bit of the identifier is compared, the channel receives only the frames of the stream
+        result = _van->set_channel_for_receive_message(channelId, virtualStream->Identifier, virtualStream->Length, virtualStream->Ack, 0xFFF);
+        if (result)
+        {
+            _listening |= 1 << channelId;
+        }
+    }
+
+    if (result)
+    {
+        virtualStream->Channel = channelId;
+        virtualStream->MappedAt = _clock();
+        _owner[channelId] = stream;
+        _swaps++;
+    }
+    return result;
+}
+
+void TSS463_VirtualChannels::unmap(uint8_t channelId)
+{
+    _streams[_owner[channelId]].Channel = TSS463_NO_CHANNEL;
+    _owner[channelId] = TSS463_NO_STREAM;
+}
+
+void TSS463_VirtualChannels::complete(uint8_t channelId, MessageLengthAndStatusRegister status)
+{
+    VirtualStream* stream = &_streams[_owner[channelId]];
+
+    if (stream->IsTransmit)
+    {
+        if (!status.data.CHTx)
+        {
+            return;
+        }
+        if (status.data.CHER)
+        {
+            stream->Errors++;
+        }
+        else
+        {
+            stream->Frames++;
+        }
+        stream->IsPending = false;
+        unmap(channelId);
+        return;
+    }
+
+    if (!status.data.CHRx)
+    {
+        return;
+    }
+
+    // the identifier bytes come first
+    uint8_t buffer[2 + TSS463_MAX_DATA_LENGTH];
+    uint8_t length;
+    _van->read_message(channelId, &length, buffer);
+    _listening &= ~(1 << channelId);
+
+    // a frame of another identifier is not given to the stream
+    if (tss463_identifier(buffer) == stream->Identifier)
+    {
+        length = length > 2 ? length - 2 : 0;
+        if (length > stream->Length)
+        {
+            length = stream->Length;
+        }
+        memcpy(stream->Data, &buffer[2], length);
+        stream->ReceivedLength = length;
+        stream->IsPending = true;
+        stream->Frames++;
+    }
+
+    if (stream->IsPinned)
+    {
+        _van->reactivate_channel(channelId);
+        _listening |= 1 << channelId;
+    }
+    else
+    {
+        unmap(channelId);
+    }
+}
+
+/*
+    Returns the lowest (or highest) channel of the pool without a stream
+*/
+uint8_t TSS463_VirtualChannels::free_channel(bool lowest)
+{
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        uint8_t channelId = lowest ? i : CHANNELS - 1 - i;
+        if ((_pool & (1 << channelId)) && _owner[channelId] == TSS463_NO_STREAM)
+        {
+            return channelId;
+        }
+    }
+    return TSS463_NO_CHANNEL;
+}
+
+/*
+    Returns the receive channel (not pinned) which has been listening for the longest time if its window expired
+*/
+uint8_t TSS463_VirtualChannels::expired_receive_channel(uint32_t now)
+{
+    uint8_t result = TSS463_NO_CHANNEL;
+    uint32_t oldest = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_owner[i] == TSS463_NO_STREAM)
+        {
+            continue;
+        }
+        VirtualStream* stream = &_streams[_owner[i]];
+        uint32_t listening = now - stream->MappedAt;
+        if (!stream->IsTransmit && !stream->IsPinned && listening >= TSS463_VC_RECEIVE_WINDOW_MS * 1000UL && listening >= oldest)
+        {
+            result = i;
+            oldest = listening;
+        }
+    }
+    return result;
+}
+
+/*
+    Returns the next stream waiting for a channel (round robin, so every stream gets its turn)
+*/
+uint8_t TSS463_VirtualChannels::next_waiting(bool isTransmit)
+{
+    uint8_t* next = isTransmit ? &_nextTransmit : &_nextReceive;
+    for (uint8_t i = 0; i < _streamCount; i++)
+    {
+        uint8_t stream = (*next + i) % _streamCount;
+        VirtualStream* virtualStream = &_streams[stream];
+        if (virtualStream->IsTransmit != isTransmit || virtualStream->Channel != TSS463_NO_CHANNEL || (isTransmit && !virtualStream->IsPending))
+        {
+            continue;
+        }
+        *next = (stream + 1) % _streamCount;
+        return stream;
+    }
+    return TSS463_NO_STREAM;
+}
+
+void TSS463_VirtualChannels::poll()
+{
+    if (_pool == 0)
+    {
+        return;
+    }
+
+    MessageLengthAndStatusRegister statuses[CHANNELS];
+    uint16_t completed = _van->poll_all_channels(statuses);
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if ((completed & (1 << i)) && _owner[i] != TSS463_NO_STREAM)
+        {
+            complete(i, statuses[i]);
+        }
+    }
+
+    // transmissions first, on the lowest channels
+    uint8_t channelId;
+    while ((channelId = free_channel(true)) != TSS463_NO_CHANNEL)
+    {
+        uint8_t stream = next_waiting(true);
+        if (stream == TSS463_NO_STREAM || !map(stream, channelId))
+        {
+            break;
+        }
+    }
+
+    // the receive streams share what is left, each waiting stream gets a channel at most once per poll
+    uint32_t now = _clock();
+    for (uint8_t i = 0; i < _streamCount; i++)
+    {
+        uint8_t stream = next_waiting(false);
+        if (stream == TSS463_NO_STREAM)
+        {
+            break;
+        }
+
+        channelId = free_channel(false);
+        if (channelId == TSS463_NO_CHANNEL)
+        {
+            channelId = expired_receive_channel(now);
+            if (channelId == TSS463_NO_CHANNEL)
+            {
+                break;
+            }
+            unmap(channelId);
+        }
+        if (!map(stream, channelId))
+        {
+            break;
+        }
+    }
+}
+
+uint8_t TSS463_VirtualChannels::occupancy()
+{
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_owner[i] != TSS463_NO_STREAM)
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+uint8_t TSS463_VirtualChannels::pool_size()
+{
+    uint8_t result = 0;
+    for (uint8_t i = 0; i < CHANNELS; i++)
+    {
+        if (_pool & (1 << i))
+        {
+            result++;
+        }
+    }
+    return result;
+}
+
+uint32_t TSS463_VirtualChannels::swaps()
+{
+    return _swaps;
+}
+
+float TSS463_VirtualChannels::swap_rate()
+{
+    uint32_t elapsed = _clock() - _statsSince;
+    if (elapsed == 0)
+    {
+        return 0;
+    }
+    return _swaps * 1000000.0f / elapsed;
+}
+
+const VirtualStream* TSS463_VirtualChannels::stream(uint8_t stream)
+{
+    if (stream >= _streamCount)
+    {
+        return NULL;
+    }
+    return &_streams[stream];
+}
+
+void TSS463_VirtualChannels::clear_stats()
+{
+    _swaps = 0;
+    _statsSince = _clock();
+    for (uint8_t i = 0; i < _streamCount; i++)
+    {
+        _streams[i].Frames = 0;
+        _streams[i].Errors = 0;
+    }
+}
@@ -0,0 +1,122 @@
+// tss463_virtual_channels.h
+#pragma once
+
+#ifndef _tss463_virtual_channels_h
+    #define _tss463_virtual_channels_h
+
+    #if defined(ARDUINO) && ARDUINO >= 100
+        #include "Arduino.h"
+    #elif defined(ARDUINO)
+        #include "WProgram.h"
+    #else
+        // host build (emulator, tools)
+        #include <stddef.h>
+        #include <stdint.h>
+    #endif
+
+#include "tss463_van.h"
+
+/*
+    Number of logical streams handled by the multiplexer, every stream takes a VirtualStream of RAM (23 bytes on AVR, so 16 streams
+    take 368 bytes of the 2 KB of an Uno)
+*/
+#ifndef TSS463_VC_MAX_STREAMS
+    #if defined(ARDUINO_ARCH_AVR)
+        #define TSS463_VC_MAX_STREAMS 16
+    #else
+        #define TSS463_VC_MAX_STREAMS 48
+    #endif
+#endif
+// A receive stream which is not pinned listens at least this long before its channel is given to another waiting receive stream
+#ifndef TSS463_VC_RECEIVE_WINDOW_MS
+    #define TSS463_VC_RECEIVE_WINDOW_MS 100
+#endif
+// with no window a channel would be taken back from the stream it was just given to
+static_assert(TSS463_VC_RECEIVE_WINDOW_MS > 0, "TSS463_VC_RECEIVE_WINDOW_MS must be at least 1 ms");
+
+#define TSS463_NO_STREAM 0xFF
+
+typedef struct
+{
+    uint16_t Identifier;
+    uint8_t* Data;
+    uint8_t Length;
+    uint8_t Ack;
+    bool IsTransmit;
+    // a pinned receive stream keeps its channel
+    bool IsPinned;
+    // transmit: waiting for a channel or for the bus, receive: a new message is in Data
+    bool IsPending;
+    uint8_t ReceivedLength;
+    uint8_t Channel;
+    uint32_t MappedAt;
+    // frames transmitted or received
+    uint32_t Frames;
+    // transmit frames whose retry count was exceeded
+    uint32_t Errors;
+}VirtualStream;
+
+/*
+    Time-multiplexes more transmit and receive streams than the 14 channels of the TSS463C over a set of physical channels
+    A transmit stream gets a channel when it is sent and gives it back when the transmission is completed (CHTx or CHER).
+    A receive stream gets a channel for a listening window and gives it back after a message was received (CHRx) or when
+    the window expired and another receive stream is waiting. Pinned receive streams keep their channel (use it for the
+    frequent or important identifiers, a message which comes while its stream has no channel is not seen).
+    Transmit streams use the lowest free channels of the pool (the TSS463C transmits the lowest channel first, Page 46),
+    receive streams the highest ones. The channels keep their buffer in the Message DATA RAM, so a swap rewrites only the
+    changed channel registers and payload bytes when the shadow registers are enabled.
+*/
+class TSS463_VirtualChannels
+{
+private:
+    TSS463_VAN* _van;
+    TSS463_Clock _clock;
+    uint16_t _pool = 0;
+    uint8_t _owner[CHANNELS];
+    // bit n: channel n is armed for a receive stream, no message was received yet
+    uint16_t _listening = 0;
+    VirtualStream _streams[TSS463_VC_MAX_STREAMS];
+    uint8_t _streamCount = 0;
+    uint8_t _nextTransmit = 0;
+    uint8_t _nextReceive = 0;
+    uint32_t _swaps = 0;
+    uint32_t _statsSince = 0;
+
+    uint8_t add_stream(uint16_t identifier, uint8_t data[], uint8_t length, uint8_t ack, bool isTransmit, bool isPinned);
+    bool map(uint8_t stream, uint8_t channelId);
+    void unmap(uint8_t channelId);
+    void complete(uint8_t channelId, MessageLengthAndStatusRegister status);
+    uint8_t free_channel(bool lowest);
+    uint8_t expired_receive_channel(uint32_t now);
+    uint8_t next_waiting(bool isTransmit);
+
+public:
+    // clock: time source in microseconds, micros is used when it is NULL
+    TSS463_VirtualChannels(TSS463_VAN* van, TSS463_Clock clock = NULL);
+
+    // Registers a stream before begin, returns its number or TSS463_NO_STREAM
+    uint8_t add_transmit(uint16_t identifier, uint8_t data[], uint8_t length, uint8_t ack);
+    uint8_t add_receive(uint16_t identifier, uint8_t buffer[], uint8_t length, uint8_t ack, bool pinned = false);
+
+    // Takes the given channels (bit n: channel n, they must be free), maps the pinned receive streams, false if they do not fit
+    bool begin(uint16_t channelMask);
+
+    // Queues a transmission of the data of the stream, false if the previous one is still pending
+    bool send(uint8_t stream);
+    // Returns the length of the message received by the stream since the last call (0: none), the data is in the buffer of the stream
+    uint8_t take_received(uint8_t stream);
+
+    // Reads the status of the channels (poll_all_channels), completes the finished streams and gives the free channels to the waiting ones
+    void poll();
+
+    // Number of channels of the pool which are mapped to a stream
+    uint8_t occupancy();
+    uint8_t pool_size();
+    // Number of times a channel was set up for a stream, and the same per second since clear_stats
+    uint32_t swaps();
+    float swap_rate();
+    const VirtualStream* stream(uint8_t stream);
+    void clear_stats();
+};
+
+#endif